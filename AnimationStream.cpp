@@ -0,0 +1,517 @@
+#include "AnimationStream.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr int rotation_shift = 30;
+// so the fixed point products of the rotating prediction stay far from overflowing
+constexpr double max_quantized = 1 << 29;
+
+std::string system_error_message(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+bool write_all(int file, const void *data, std::size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = ::write(file, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// residuals are packed in blocks of this many, each with as many bits per residual as its
+// largest one needs, so a block the prediction got right costs a single byte
+constexpr unsigned int residual_block_length = 32;
+// zigzagged residuals of coordinates within +-2^29 steps need at most 33 bits
+constexpr unsigned int max_residual_bits = 56;
+
+std::uint64_t zigzag(std::int64_t residual) {
+    // small negative residuals get as few bits as small positive ones
+    return (static_cast<std::uint64_t>(residual) << 1) ^ (residual >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void pack_residuals(std::vector<unsigned char> &packed, const std::uint64_t *values,
+                    unsigned int count) {
+    for (unsigned int begin = 0; begin < count; begin += residual_block_length) {
+        unsigned int end = std::min(count, begin + residual_block_length);
+        std::uint64_t combined = 0;
+        for (unsigned int i = begin; i < end; i++) {
+            combined |= values[i];
+        }
+        unsigned int bits = std::bit_width(combined);
+        packed.push_back(bits);
+        // whole bytes leave the buffer as soon as they are full, so it never holds more than
+        // 7 + max_residual_bits bits
+        std::uint64_t buffer = 0;
+        unsigned int buffered_bits = 0;
+        for (unsigned int i = begin; i < end && bits > 0; i++) {
+            buffer |= values[i] << buffered_bits;
+            buffered_bits += bits;
+            while (buffered_bits >= 8) {
+                packed.push_back(static_cast<unsigned char>(buffer));
+                buffer >>= 8;
+                buffered_bits -= 8;
+            }
+        }
+        if (buffered_bits > 0) {
+            packed.push_back(static_cast<unsigned char>(buffer));
+        }
+    }
+}
+
+// advances data past the blocks
+void unpack_residuals(const unsigned char *&data, const unsigned char *end,
+                      std::uint64_t *values, unsigned int count) {
+    for (unsigned int begin = 0; begin < count; begin += residual_block_length) {
+        unsigned int block_end = std::min(count, begin + residual_block_length);
+        if (data == end) {
+            throw std::runtime_error("animation frame ends early");
+        }
+        unsigned int bits = *data++;
+        if (bits > max_residual_bits
+            || end - data < static_cast<std::ptrdiff_t>(((block_end - begin) * bits + 7) / 8)) {
+            throw std::runtime_error("animation frame is damaged");
+        }
+        std::uint64_t mask = bits == 0 ? 0 : ~std::uint64_t(0) >> (64 - bits);
+        std::uint64_t buffer = 0;
+        unsigned int buffered_bits = 0;
+        for (unsigned int i = begin; i < block_end; i++) {
+            while (buffered_bits < bits) {
+                buffer |= static_cast<std::uint64_t>(*data++) << buffered_bits;
+                buffered_bits += 8;
+            }
+            values[i] = buffer & mask;
+            buffer = bits == 0 ? buffer : buffer >> bits;
+            buffered_bits -= bits;
+        }
+    }
+}
+
+// a keyframe vertex from the ones before it in the same plane: from its left and upper
+// neighbours and the one between them where it has all three
+std::int64_t predict_from_grid(const std::int32_t *plane, unsigned int row_length,
+                               unsigned int vertex) {
+    unsigned int x = vertex % row_length;
+    if (vertex < row_length) {
+        return x == 0 ? 0 : plane[vertex - 1];
+    }
+    if (x == 0) {
+        return plane[vertex - row_length];
+    }
+    return static_cast<std::int64_t>(plane[vertex - 1]) + plane[vertex - row_length]
+           - plane[vertex - row_length - 1];
+}
+
+// the prediction of a frame between keyframes, planes of x, y and z after each other; the
+// first frame after a keyframe has only the previous one to go by
+void predict_frame(const AnimationHeader &header, const std::int32_t *previous,
+                   const std::int32_t *before_previous, std::int64_t *prediction) {
+    unsigned int vertex_count = header.row_length * header.column_length;
+    if (header.predictor == predict_previous) {
+        std::copy(previous, previous + 3 * vertex_count, prediction);
+        return;
+    }
+    for (unsigned int k = 0; k < 3; k++) {
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            unsigned int index = k * vertex_count + i;
+            prediction[index] =
+                before_previous ? 2 * static_cast<std::int64_t>(previous[index])
+                                      - before_previous[index]
+                                : previous[index];
+        }
+    }
+    if (header.predictor != predict_rotating) {
+        return;
+    }
+
+    // in the frame turning with the top row: the previous frame turned on by one frame, plus
+    // the step from the frame before it turned on by two, rounded once
+    constexpr std::int64_t half = std::int64_t(1) << (rotation_shift - 1);
+    std::int64_t cos_1 = header.rotation_cos;
+    std::int64_t sin_1 = header.rotation_sin;
+    std::int64_t cos_2 = (cos_1 * cos_1 - sin_1 * sin_1 + half) >> rotation_shift;
+    std::int64_t sin_2 = (2 * cos_1 * sin_1 + half) >> rotation_shift;
+    const std::int32_t *previous_x = previous;
+    const std::int32_t *previous_z = previous + 2 * vertex_count;
+    std::int64_t *x = prediction;
+    std::int64_t *z = prediction + 2 * vertex_count;
+    for (unsigned int i = 0; i < vertex_count; i++) {
+        std::int64_t turned_x;
+        std::int64_t turned_z;
+        if (before_previous) {
+            std::int64_t older_x = before_previous[i];
+            std::int64_t older_z = before_previous[2 * vertex_count + i];
+            turned_x = 2 * (cos_1 * previous_x[i] + sin_1 * previous_z[i])
+                       - (cos_2 * older_x + sin_2 * older_z);
+            turned_z = 2 * (-sin_1 * previous_x[i] + cos_1 * previous_z[i])
+                       - (-sin_2 * older_x + cos_2 * older_z);
+        } else {
+            turned_x = cos_1 * previous_x[i] + sin_1 * previous_z[i];
+            turned_z = -sin_1 * previous_x[i] + cos_1 * previous_z[i];
+        }
+        x[i] = (turned_x + half) >> rotation_shift;
+        z[i] = (turned_z + half) >> rotation_shift;
+    }
+}
+} // namespace
+
+AnimationHeader make_animation_header(unsigned int row_length, unsigned int column_length,
+                                      float delta_time, float spinning_speed, float precision,
+                                      unsigned int keyframe_interval,
+                                      animation_predictor predictor) {
+    AnimationHeader header = {};
+    std::memcpy(header.magic, animation_magic, sizeof(header.magic));
+    header.version = animation_version;
+    header.row_length = row_length;
+    header.column_length = column_length;
+    header.keyframe_interval = std::max(1u, keyframe_interval);
+    header.delta_time = delta_time;
+    header.precision = precision;
+    header.predictor = predictor;
+    // as update_top_row turns the top row
+    double angle = static_cast<double>(delta_time) * spinning_speed;
+    header.rotation_cos = std::lround(std::cos(angle) * (1 << rotation_shift));
+    header.rotation_sin = std::lround(std::sin(angle) * (1 << rotation_shift));
+    return header;
+}
+
+AnimationWriter::AnimationWriter(const std::string &path, const AnimationHeader &header,
+                                 std::size_t chunk_bytes)
+    : header(header), vertex_count(header.row_length * header.column_length) {
+    if (!(header.precision > 0) || header.predictor >= num_animation_predictors) {
+        throw std::runtime_error("an animation needs a positive precision and a known predictor");
+    }
+    std::size_t frame_bytes = std::size_t(vertex_count) * 3 * sizeof(float);
+    frames_per_chunk = std::max<std::size_t>(1, chunk_bytes / frame_bytes);
+    for (std::vector<float> &chunk : chunks) {
+        chunk.resize(std::size_t(frames_per_chunk) * vertex_count * 3);
+    }
+    for (std::vector<std::int32_t> &frame : history) {
+        frame.resize(3 * vertex_count);
+    }
+    prediction.resize(3 * vertex_count);
+    residuals.resize(3 * vertex_count);
+
+    file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        throw std::runtime_error(system_error_message("could not create", path));
+    }
+    if (!write_all(file, &header, sizeof(header))) {
+        std::string message = system_error_message("could not write", path);
+        ::close(file);
+        throw std::runtime_error(message);
+    }
+    file_offset = sizeof(header);
+    thread = std::thread(&AnimationWriter::write_loop, this);
+}
+
+AnimationWriter::~AnimationWriter() {
+    try {
+        close();
+    } catch (const std::exception &) {
+        // errors can only be reported by an explicit close
+    }
+}
+
+bool AnimationWriter::encode_frame(const float *frame) {
+    unsigned int key_position = frames_encoded % header.keyframe_interval;
+    bool keyframe = key_position == 0;
+    if (!keyframe) {
+        predict_frame(header, history[0].data(), key_position > 1 ? history[1].data() : nullptr,
+                      prediction.data());
+    }
+
+    // the frame before the previous one is no longer needed, so it takes the new one
+    std::vector<std::int32_t> &quantized = history[1];
+    for (unsigned int i = 0; i < 3 * vertex_count; i++) {
+        double steps = std::nearbyint(static_cast<double>(frame[i]) / header.precision);
+        if (!(std::abs(steps) < max_quantized)) {
+            errno = ERANGE;
+            return false;
+        }
+        quantized[i] = static_cast<std::int32_t>(steps);
+    }
+
+    packed.clear();
+    for (unsigned int k = 0; k < 3; k++) {
+        const std::int32_t *plane = quantized.data() + k * vertex_count;
+        std::uint64_t *plane_residuals = residuals.data() + k * vertex_count;
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            std::int64_t predicted = keyframe ? predict_from_grid(plane, header.row_length, i)
+                                              : prediction[k * vertex_count + i];
+            plane_residuals[i] = zigzag(plane[i] - predicted);
+        }
+        pack_residuals(packed, plane_residuals, vertex_count);
+    }
+    std::swap(history[0], history[1]);
+
+    if (keyframe) {
+        keyframe_offsets.push_back(file_offset);
+    }
+    animation_frame_header frame_header = {static_cast<std::uint32_t>(packed.size()),
+                                           keyframe};
+    if (!write_all(file, &frame_header, sizeof(frame_header))
+        || !write_all(file, packed.data(), packed.size())) {
+        return false;
+    }
+    file_offset += sizeof(frame_header) + packed.size();
+    frames_encoded++;
+    return true;
+}
+
+void AnimationWriter::write_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        chunk_ready.wait(lock, [&] { return pending_frames > 0 || stopping; });
+        if (pending_frames == 0) {
+            return;
+        }
+        const std::vector<float> &chunk = chunks[filling_chunk ^ 1];
+        unsigned int frame_count = pending_frames;
+        lock.unlock();
+        auto start_time_point = std::chrono::steady_clock::now();
+        bool success = true;
+        // after a failed frame the ones after it cannot be predicted, so they are dropped
+        for (unsigned int i = 0; i < frame_count && success && error.empty(); i++) {
+            success = encode_frame(chunk.data() + std::size_t(i) * vertex_count * 3);
+        }
+        encode_seconds +=
+            std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+                .count();
+        lock.lock();
+        if (!success && error.empty()) {
+            error = errno == ERANGE
+                        ? std::string("a coordinate is out of range for the animation precision")
+                        : std::string("could not write animation: ") + std::strerror(errno);
+        }
+        pending_frames = 0;
+        chunk_written.notify_all();
+    }
+}
+
+void AnimationWriter::submit_chunk() {
+    auto start_time_point = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    chunk_written.wait(lock, [&] { return pending_frames == 0; });
+    waiting_seconds +=
+        std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+            .count();
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    pending_frames = filled_frames;
+    filling_chunk ^= 1;
+    filled_frames = 0;
+    chunk_ready.notify_one();
+}
+
+void AnimationWriter::write_frame(const float *x, const float *y, const float *z) {
+    if (file < 0) {
+        throw std::runtime_error("animation is already closed");
+    }
+    float *frame = chunks[filling_chunk].data() + std::size_t(filled_frames) * vertex_count * 3;
+    std::copy(x, x + vertex_count, frame);
+    std::copy(y, y + vertex_count, frame + vertex_count);
+    std::copy(z, z + vertex_count, frame + 2 * vertex_count);
+    frames_written++;
+    if (++filled_frames == frames_per_chunk) {
+        submit_chunk();
+    }
+}
+
+void AnimationWriter::close() {
+    if (file < 0) {
+        return;
+    }
+    if (filled_frames > 0) {
+        submit_chunk();
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_written.wait(lock, [&] { return pending_frames == 0; });
+        stopping = true;
+    }
+    chunk_ready.notify_one();
+    thread.join();
+
+    // without the index, e.g. after an error, the reader still finds the frames by walking them
+    bool indexed = error.empty();
+    if (indexed) {
+        animation_index_trailer trailer = {};
+        std::memcpy(trailer.magic, animation_index_magic, sizeof(trailer.magic));
+        trailer.frame_count = frames_encoded;
+        trailer.keyframe_count = keyframe_offsets.size();
+        trailer.index_offset = file_offset;
+        indexed = write_all(file, keyframe_offsets.data(),
+                            keyframe_offsets.size() * sizeof(std::uint64_t))
+                  && write_all(file, &trailer, sizeof(trailer));
+        file_offset += keyframe_offsets.size() * sizeof(std::uint64_t) + sizeof(trailer);
+    }
+    if (!indexed && error.empty()) {
+        error = std::string("could not write animation index: ") + std::strerror(errno);
+    }
+    bool closed = ::close(file) == 0;
+    file = -1;
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    if (!closed) {
+        throw std::runtime_error(std::string("could not close animation: ")
+                                 + std::strerror(errno));
+    }
+}
+
+AnimationReader::AnimationReader(const std::string &path) {
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error(system_error_message("could not open", path));
+    }
+    struct stat status;
+    if (::fstat(file, &status) != 0 || std::size_t(status.st_size) < sizeof(AnimationHeader)) {
+        ::close(file);
+        throw std::runtime_error(path + " is not an animation");
+    }
+    mapping_size = status.st_size;
+    void *address = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (address == MAP_FAILED) {
+        std::string message = system_error_message("could not map", path);
+        ::close(file);
+        throw std::runtime_error(message);
+    }
+    mapping = static_cast<const unsigned char *>(address);
+
+    std::memcpy(&header, mapping, sizeof(header));
+    if (std::memcmp(header.magic, animation_magic, sizeof(header.magic)) != 0
+        || header.version != animation_version || header.keyframe_interval == 0
+        || !(header.precision > 0) || header.predictor >= num_animation_predictors) {
+        ::munmap(address, mapping_size);
+        ::close(file);
+        throw std::runtime_error(path + " is not an animation of version "
+                                 + std::to_string(animation_version));
+    }
+
+    animation_index_trailer trailer = {};
+    if (mapping_size >= sizeof(header) + sizeof(trailer)) {
+        std::memcpy(&trailer, mapping + mapping_size - sizeof(trailer), sizeof(trailer));
+    }
+    std::uint64_t index_end =
+        trailer.index_offset + trailer.keyframe_count * sizeof(std::uint64_t);
+    if (std::memcmp(trailer.magic, animation_index_magic, sizeof(trailer.magic)) == 0
+        && trailer.index_offset >= sizeof(header) && index_end + sizeof(trailer) == mapping_size
+        && trailer.keyframe_count
+               == (trailer.frame_count + header.keyframe_interval - 1) / header.keyframe_interval) {
+        keyframe_offsets.resize(trailer.keyframe_count);
+        std::memcpy(keyframe_offsets.data(), mapping + trailer.index_offset,
+                    keyframe_offsets.size() * sizeof(std::uint64_t));
+        frame_count = trailer.frame_count;
+    } else {
+        // an export that was cut off: every whole frame up to where it ends
+        std::uint64_t offset = sizeof(header);
+        animation_frame_header frame_header;
+        while (offset + sizeof(frame_header) <= mapping_size) {
+            std::memcpy(&frame_header, mapping + offset, sizeof(frame_header));
+            if (offset + sizeof(frame_header) + frame_header.size > mapping_size) {
+                break;
+            }
+            if (frame_count % header.keyframe_interval == 0) {
+                keyframe_offsets.push_back(offset);
+            }
+            offset += sizeof(frame_header) + frame_header.size;
+            frame_count++;
+        }
+    }
+
+    for (std::vector<std::int32_t> &frame : history) {
+        frame.resize(3 * get_vertex_count());
+    }
+    prediction.resize(3 * get_vertex_count());
+    residuals.resize(3 * get_vertex_count());
+}
+
+AnimationReader::~AnimationReader() {
+    ::munmap(const_cast<unsigned char *>(mapping), mapping_size);
+    ::close(file);
+}
+
+void AnimationReader::decode_frame(unsigned int frame) {
+    unsigned int vertex_count = get_vertex_count();
+    animation_frame_header frame_header;
+    if (next_offset + sizeof(frame_header) > mapping_size) {
+        throw std::runtime_error("animation ends early");
+    }
+    std::memcpy(&frame_header, mapping + next_offset, sizeof(frame_header));
+    const unsigned char *data = mapping + next_offset + sizeof(frame_header);
+    const unsigned char *end = data + frame_header.size;
+    unsigned int key_position = frame % header.keyframe_interval;
+    bool keyframe = key_position == 0;
+    if (end > mapping + mapping_size || frame_header.keyframe != keyframe) {
+        throw std::runtime_error("animation frame " + std::to_string(frame) + " is damaged");
+    }
+    if (!keyframe) {
+        predict_frame(header, history[0].data(), key_position > 1 ? history[1].data() : nullptr,
+                      prediction.data());
+    }
+
+    std::vector<std::int32_t> &quantized = history[1];
+    for (unsigned int k = 0; k < 3; k++) {
+        std::int32_t *plane = quantized.data() + k * vertex_count;
+        std::uint64_t *plane_residuals = residuals.data() + k * vertex_count;
+        unpack_residuals(data, end, plane_residuals, vertex_count);
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            std::int64_t predicted = keyframe ? predict_from_grid(plane, header.row_length, i)
+                                              : prediction[k * vertex_count + i];
+            plane[i] = static_cast<std::int32_t>(predicted + unzigzag(plane_residuals[i]));
+        }
+    }
+    std::swap(history[0], history[1]);
+    decoded_frame = frame;
+    next_offset = end - mapping;
+}
+
+void AnimationReader::read_frame(unsigned int frame, float *x, float *y, float *z) {
+    if (frame >= frame_count) {
+        throw std::runtime_error("animation has no frame " + std::to_string(frame));
+    }
+    unsigned int keyframe = frame / header.keyframe_interval;
+    // going on from the frame decoded last is only possible up to the next keyframe
+    if (decoded_frame < 0 || frame < decoded_frame
+        || decoded_frame / header.keyframe_interval != keyframe) {
+        next_offset = keyframe_offsets[keyframe];
+        decode_frame(keyframe * header.keyframe_interval);
+    }
+    while (decoded_frame < frame) {
+        decode_frame(decoded_frame + 1);
+    }
+
+    unsigned int vertex_count = get_vertex_count();
+    float *coordinates[3] = {x, y, z};
+    for (unsigned int k = 0; k < 3; k++) {
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            coordinates[k][i] = history[0][k * vertex_count + i]
+                                * static_cast<double>(header.precision);
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a compressed alternative to trajectory files for handing a run to another renderer: every
+// coordinate is quantized to a multiple of the precision, and each frame stores the difference
+// of those integers to a prediction, one plane of x, y and z after the other, bit packed in
+// blocks of 32 with the width of the largest difference in the block
+//
+// file layout: an AnimationHeader, then per frame an animation_frame_header and its packed
+// residuals, then after a complete export the offsets of all keyframes and an
+// animation_index_trailer; keyframes predict every vertex from its neighbours on the grid, so
+// they decode on their own, while the frames in between predict from the frames before them
+//
+// predictions are computed on the quantized integers, the rotation with a fixed point cosine
+// and sine stored in the header, so the reader reproduces them exactly on any machine
+enum animation_predictor : std::uint32_t {
+    // the previous frame
+    predict_previous,
+    // moving on as from the frame before the previous one to the previous one
+    predict_linear,
+    // the same, but in the frame turning with the top row by the spinning speed, so a spinning
+    // cloth at rest costs as little as a still one
+    predict_rotating,
+    num_animation_predictors
+};
+
+struct AnimationHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t row_length;
+        std::uint32_t column_length;
+        // every this many frames, starting with the first
+        std::uint32_t keyframe_interval;
+        // between two frames
+        float delta_time;
+        // quantization step in units; a decoded coordinate is within half of it
+        float precision;
+        std::uint32_t predictor;
+        // turn of the top row between two frames, times 2^30
+        std::int32_t rotation_cos;
+        std::int32_t rotation_sin;
+        std::uint8_t padding[20];
+};
+
+static_assert(sizeof(AnimationHeader) == 64);
+
+struct animation_frame_header {
+    public:
+        // bytes of packed residuals that follow
+        std::uint32_t size;
+        std::uint32_t keyframe;
+};
+
+struct animation_index_trailer {
+    public:
+        char magic[8];
+        std::uint64_t frame_count;
+        std::uint64_t keyframe_count;
+        // of the keyframe offsets, which run up to this trailer
+        std::uint64_t index_offset;
+};
+
+constexpr char animation_magic[8] = {'C', 'L', 'O', 'T', 'H', 'A', 'N', 'M'};
+constexpr char animation_index_magic[8] = {'C', 'L', 'O', 'T', 'H', 'I', 'D', 'X'};
+constexpr std::uint32_t animation_version = 1;
+
+// the precision limits coordinates to +-2^29 steps; the default keeps 0.1 mm on a 1 m cloth
+constexpr float default_animation_precision = 1.0f / 8192;
+constexpr unsigned int default_keyframe_interval = 100;
+
+// fills in everything but the padding; the rotation is the one of the top row over delta_time
+AnimationHeader make_animation_header(unsigned int row_length, unsigned int column_length,
+                                      float delta_time, float spinning_speed,
+                                      float precision = default_animation_precision,
+                                      unsigned int keyframe_interval = default_keyframe_interval,
+                                      animation_predictor predictor = predict_rotating);
+
+// appends frames from the simulation thread while a background thread quantizes, encodes and
+// writes them; as in TrajectoryWriter, frames are copied into one of two chunks, and the
+// simulation only waits when both are in use
+class AnimationWriter {
+    private:
+        int file = -1;
+        AnimationHeader header;
+        unsigned int vertex_count;
+        unsigned int frames_per_chunk;
+
+        // x, y and z planes of every frame
+        std::vector<float> chunks[2];
+        unsigned int filling_chunk = 0;
+        unsigned int filled_frames = 0;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable chunk_ready;
+        std::condition_variable chunk_written;
+        unsigned int pending_frames = 0;
+        bool stopping = false;
+        std::string error;
+
+        // owned by the writer thread: the quantized last two frames, the prediction, residuals
+        // and packed residuals of the next one and the offsets of the keyframes
+        std::vector<std::int32_t> history[2];
+        std::vector<std::int64_t> prediction;
+        std::vector<std::uint64_t> residuals;
+        std::vector<unsigned char> packed;
+        std::vector<std::uint64_t> keyframe_offsets;
+        std::uint64_t file_offset = 0;
+        unsigned long long frames_encoded = 0;
+        double encode_seconds = 0;
+
+        unsigned long long frames_written = 0;
+        double waiting_seconds = 0;
+
+        void write_loop();
+        void submit_chunk();
+        // false with errno set if a write failed
+        bool encode_frame(const float *frame);
+
+    public:
+        // chunk_bytes is the size of each of the two chunks of raw frames, rounded to whole
+        // frames; throws if the file cannot be created
+        AnimationWriter(const std::string &path, const AnimationHeader &header,
+                        std::size_t chunk_bytes = 16 << 20);
+        ~AnimationWriter();
+
+        AnimationWriter(const AnimationWriter &) = delete;
+        AnimationWriter &operator=(const AnimationWriter &) = delete;
+
+        // throws if the writer thread failed, e.g. on a full disk or a coordinate outside the
+        // range of the precision
+        void write_frame(const float *x, const float *y, const float *z);
+
+        // encodes the remaining frames, writes the keyframe index and closes the file
+        void close();
+
+        unsigned long long get_frames_written() const {
+            return frames_written;
+        }
+
+        // the file size, complete only after close
+        unsigned long long get_encoded_bytes() const {
+            return file_offset;
+        }
+
+        // the same frames as x, y, z, 1 floats, as a trajectory stores them
+        unsigned long long get_raw_bytes() const {
+            return frames_written * vertex_count * 4 * sizeof(float);
+        }
+
+        // wall seconds the writer thread spent quantizing and packing, complete only after close
+        double get_encode_seconds() const {
+            return encode_seconds;
+        }
+
+        // wall seconds write_frame spent waiting for the writer thread
+        double get_waiting_seconds() const {
+            return waiting_seconds;
+        }
+};
+
+// maps an animation read-only and decodes frames in any order; reading them in order decodes
+// each from the one before, any other frame decodes forward from the keyframe before it
+class AnimationReader {
+    private:
+        int file = -1;
+        const unsigned char *mapping = nullptr;
+        std::size_t mapping_size = 0;
+        AnimationHeader header;
+
+        // from the index if the export was closed and otherwise found by walking the frames,
+        // without those cut off
+        std::vector<std::uint64_t> keyframe_offsets;
+        unsigned int frame_count = 0;
+
+        // the quantized frame decoded last and the one before, as in the writer
+        std::vector<std::int32_t> history[2];
+        std::vector<std::int64_t> prediction;
+        std::vector<std::uint64_t> residuals;
+        // frame in history[0], or -1, and the offset of the frame after it
+        long long decoded_frame = -1;
+        std::uint64_t next_offset = 0;
+
+        // decodes the frame at next_offset into history[0]
+        void decode_frame(unsigned int frame);
+
+    public:
+        explicit AnimationReader(const std::string &path);
+        ~AnimationReader();
+
+        AnimationReader(const AnimationReader &) = delete;
+        AnimationReader &operator=(const AnimationReader &) = delete;
+
+        const AnimationHeader &get_header() const {
+            return header;
+        }
+
+        unsigned int get_frame_count() const {
+            return frame_count;
+        }
+
+        unsigned int get_vertex_count() const {
+            return header.row_length * header.column_length;
+        }
+
+        // writes the positions of the frame, get_vertex_count() per coordinate
+        void read_frame(unsigned int frame, float *x, float *y, float *z);
+};
@@ -0,0 +1,112 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+double BenchmarkResult::percentile(double fraction) const {
+    if (samples.empty()) {
+        return 0;
+    }
+    std::size_t rank = std::ceil(fraction * samples.size());
+    return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+}
+
+const BenchmarkResult &BenchmarkSuite::run(const std::string &name, double items_per_run,
+                                           const std::string &item_unit,
+                                           const std::function<void()> &run) {
+    for (unsigned int i = 0; i < settings.warmup_count; i++) {
+        run();
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.items_per_run = items_per_run;
+    result.item_unit = item_unit;
+    double total_seconds = 0;
+    // at least one sample, so the percentiles and the throughput stay defined
+    while (result.samples.size() < std::max(settings.sample_count, 1u)) {
+        if (result.samples.size() >= settings.min_sample_count
+            && total_seconds >= settings.max_seconds) {
+            break;
+        }
+        auto start_time_point = std::chrono::steady_clock::now();
+        run();
+        double seconds =
+            std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+                .count();
+        result.samples.push_back(seconds);
+        total_seconds += seconds;
+    }
+    std::sort(result.samples.begin(), result.samples.end());
+
+    results.push_back(std::move(result));
+    print(std::cout, results.back());
+    return results.back();
+}
+
+void BenchmarkSuite::print(std::ostream &output, const BenchmarkResult &result) {
+    std::ios::fmtflags flags = output.flags();
+    std::streamsize precision = output.precision();
+    output << std::left << std::setw(40) << result.name << std::right << std::fixed
+           << std::setprecision(1) << " median " << std::setw(10) << result.median() * 1e6
+           << " us, p95 " << std::setw(10) << result.percentile(0.95) * 1e6 << " us, p99 "
+           << std::setw(10) << result.percentile(0.99) * 1e6 << " us, " << std::setprecision(2)
+           << result.items_per_second() / 1e6 << " M" << result.item_unit << "/s ("
+           << result.samples.size() << " samples)" << std::endl;
+    output.flags(flags);
+    output.precision(precision);
+}
+
+void BenchmarkSuite::write_json(std::ostream &output) const {
+    output << std::setprecision(9);
+    output << "{\n  \"settings\": {\"warmup_count\": " << settings.warmup_count
+           << ", \"sample_count\": " << settings.sample_count
+           << ", \"max_seconds\": " << settings.max_seconds
+           << ", \"min_sample_count\": " << settings.min_sample_count << "},\n"
+           << "  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &result = results[i];
+        // names and units are chosen by the benchmarks and never need escaping
+        output << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+               << "\", \"item_unit\": \"" << result.item_unit
+               << "\", \"items_per_run\": " << result.items_per_run
+               << ", \"median_seconds\": " << result.median()
+               << ", \"p95_seconds\": " << result.percentile(0.95)
+               << ", \"p99_seconds\": " << result.percentile(0.99)
+               << ", \"min_seconds\": " << result.samples.front()
+               << ", \"max_seconds\": " << result.samples.back()
+               << ", \"items_per_second\": " << result.items_per_second() << ", \"samples\": [";
+        for (std::size_t sample = 0; sample < result.samples.size(); sample++) {
+            output << (sample == 0 ? "" : ", ") << result.samples[sample];
+        }
+        output << "]}";
+    }
+    output << "\n  ]\n}\n";
+}
+
+bool parse_benchmark_arguments(int argc, char **argv, BenchmarkSettings &settings,
+                               std::string &json_path) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (argument == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (argument == "--samples" && i + 1 < argc) {
+            settings.sample_count = std::stoul(argv[++i]);
+            if (settings.sample_count < 1) {
+                return false;
+            }
+            settings.min_sample_count = std::min(settings.min_sample_count, settings.sample_count);
+        } else if (argument == "--warmup" && i + 1 < argc) {
+            settings.warmup_count = std::stoul(argv[++i]);
+        } else if (argument == "--max-seconds" && i + 1 < argc) {
+            settings.max_seconds = std::stod(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkSettings {
+        // untimed runs before the samples, to settle caches, clocks and lazily allocated state
+        unsigned int warmup_count = 10;
+        unsigned int sample_count = 200;
+        // a benchmark stops sampling after this many wall seconds, keeping at least
+        // min_sample_count samples, so large grids do not take minutes
+        double max_seconds = 3;
+        unsigned int min_sample_count = 10;
+};
+
+struct BenchmarkResult {
+        std::string name;
+        // work done by one run, e.g. vertices or bytes, in item_unit
+        double items_per_run = 0;
+        std::string item_unit;
+        // wall seconds of every timed run, sorted
+        std::vector<double> samples;
+
+        // nearest rank percentile of the samples, fraction between 0 and 1
+        double percentile(double fraction) const;
+
+        double median() const {
+            return percentile(0.5);
+        }
+
+        // at the median
+        double items_per_second() const {
+            return items_per_run / median();
+        }
+};
+
+// times every run of a benchmark separately, so the report can give percentiles instead of a
+// mean that hides stalls
+class BenchmarkSuite {
+    private:
+        BenchmarkSettings settings;
+        std::vector<BenchmarkResult> results;
+
+    public:
+        explicit BenchmarkSuite(const BenchmarkSettings &settings = {}) : settings(settings) {}
+
+        // calls run for the warmup and then until enough samples are taken; prints the result
+        // as soon as it is done
+        const BenchmarkResult &run(const std::string &name, double items_per_run,
+                                   const std::string &item_unit, const std::function<void()> &run);
+
+        const std::vector<BenchmarkResult> &get_results() const {
+            return results;
+        }
+
+        // one line per benchmark with median, p95, p99 and the median throughput
+        static void print(std::ostream &output, const BenchmarkResult &result);
+
+        // {"benchmarks": [...]} with the settings, the percentiles and the raw samples
+        void write_json(std::ostream &output) const;
+};
+
+// parses --json <path>, --samples <count>, --warmup <count> and --max-seconds <seconds>,
+// returning false on anything else and on fewer than 1 sample
+bool parse_benchmark_arguments(int argc, char **argv, BenchmarkSettings &settings,
+                               std::string &json_path);
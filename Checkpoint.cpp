@@ -0,0 +1,116 @@
+#include "Checkpoint.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr char checkpoint_magic[8] = {'C', 'L', 'O', 'T', 'H', 'C', 'K', 'P'};
+constexpr std::uint32_t checkpoint_version = 1;
+
+struct checkpoint_header {
+    public:
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t row_length;
+        std::uint32_t column_length;
+        std::uint32_t current_buffer;
+        double simulated_time;
+        float spinning_speed;
+        float spring_strength;
+        float gravity_strength;
+        float upper_radius;
+        float lower_radius;
+        std::uint8_t padding[12];
+};
+
+static_assert(sizeof(checkpoint_header) == 64);
+} // namespace
+
+void save_checkpoint(const std::string &path, const Checkpoint &checkpoint) {
+    if (checkpoint.get_vertex_count() > max_vertex_count) {
+        throw std::runtime_error("a " + std::to_string(checkpoint.row_length) + "x"
+                                 + std::to_string(checkpoint.column_length)
+                                 + " grid is too large for a checkpoint");
+    }
+    std::size_t buffer_size = checkpoint.get_vertex_count() * 3;
+    for (const std::vector<float> &buffer : checkpoint.buffers) {
+        if (buffer.size() != buffer_size) {
+            throw std::runtime_error("checkpoint buffers do not match its grid size");
+        }
+    }
+
+    checkpoint_header header = {};
+    std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.version = checkpoint_version;
+    header.row_length = checkpoint.row_length;
+    header.column_length = checkpoint.column_length;
+    header.current_buffer = checkpoint.current_buffer;
+    header.simulated_time = checkpoint.simulated_time;
+    header.spinning_speed = checkpoint.parameters.spinning_speed;
+    header.spring_strength = checkpoint.parameters.spring_strength;
+    header.gravity_strength = checkpoint.parameters.gravity_strength;
+    header.upper_radius = checkpoint.parameters.upper_radius;
+    header.lower_radius = checkpoint.parameters.lower_radius;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const std::vector<float> &buffer : checkpoint.buffers) {
+        file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(float));
+    }
+    file.close();
+    if (!file) {
+        throw std::runtime_error("could not write checkpoint " + path);
+    }
+}
+
+Checkpoint load_checkpoint(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("could not open checkpoint " + path);
+    }
+    std::size_t file_size = file.tellg();
+    file.seekg(0);
+
+    checkpoint_header header;
+    if (file_size < sizeof(header)
+        || !file.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a checkpoint");
+    }
+    if (header.version != checkpoint_version) {
+        throw std::runtime_error(path + " is a checkpoint of version "
+                                 + std::to_string(header.version) + ", expected "
+                                 + std::to_string(checkpoint_version));
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.row_length = header.row_length;
+    checkpoint.column_length = header.column_length;
+    checkpoint.current_buffer = header.current_buffer;
+    checkpoint.simulated_time = header.simulated_time;
+    checkpoint.parameters.spinning_speed = header.spinning_speed;
+    checkpoint.parameters.spring_strength = header.spring_strength;
+    checkpoint.parameters.gravity_strength = header.gravity_strength;
+    checkpoint.parameters.upper_radius = header.upper_radius;
+    checkpoint.parameters.lower_radius = header.lower_radius;
+
+    // the size check also rejects grids too small for the constraint table, and is only made
+    // once the vertex count is known to fit
+    std::uint64_t buffer_size = checkpoint.get_vertex_count() * 3;
+    if (header.row_length < min_row_length || header.column_length < min_column_length
+        || checkpoint.get_vertex_count() > max_vertex_count || header.current_buffer > 1
+        || file_size != sizeof(header) + Checkpoint::num * buffer_size * sizeof(float)) {
+        throw std::runtime_error(path + " does not hold a valid "
+                                 + std::to_string(header.row_length) + "x"
+                                 + std::to_string(header.column_length) + " grid");
+    }
+    for (std::vector<float> &buffer : checkpoint.buffers) {
+        buffer.resize(buffer_size);
+        if (!file.read(reinterpret_cast<char *>(buffer.data()), buffer_size * sizeof(float))) {
+            throw std::runtime_error("could not read checkpoint " + path);
+        }
+    }
+    return checkpoint;
+}
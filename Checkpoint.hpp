@@ -0,0 +1,33 @@
+#pragma once
+#include "ClothParameters.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// complete simulation state, enough to continue a run exactly where it was saved
+struct Checkpoint {
+        unsigned int row_length = 0;
+        unsigned int column_length = 0;
+        ClothParameters parameters;
+        double simulated_time = 0;
+        // which of the two position buffers holds the current state
+        unsigned int current_buffer = 0;
+
+        enum buffer_indices { start_positions, first_positions, second_positions, velocities, num };
+
+        // every buffer holds the x, then the y, then the z coordinates of all vertices
+        std::vector<float> buffers[buffer_indices::num];
+
+        // in 64 bits, so an oversize header cannot wrap around to a small count
+        std::uint64_t get_vertex_count() const {
+            return static_cast<std::uint64_t>(row_length) * column_length;
+        }
+};
+
+// a 64 byte header with magic, version, grid size, current buffer, simulated time and
+// parameters, followed by the four buffers
+void save_checkpoint(const std::string &path, const Checkpoint &checkpoint);
+
+// throws if the file is not a checkpoint of this version or its size does not match the grid
+Checkpoint load_checkpoint(const std::string &path);
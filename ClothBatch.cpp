@@ -0,0 +1,109 @@
+#include "ClothBatch.hpp"
+
+#include <algorithm>
+#include <thread>
+
+std::vector<ClothParameters> vary_parameters(unsigned int cloth_count,
+                                             const ClothParameters &base) {
+    std::vector<ClothParameters> parameters(cloth_count, base);
+    for (unsigned int cloth = 0; cloth < cloth_count; cloth++) {
+        // from -1 to 1 across the batch, 0 for a single cloth
+        float spread = cloth_count > 1 ? 2.0f * cloth / (cloth_count - 1) - 1 : 0;
+        parameters[cloth].spinning_speed = base.spinning_speed * (1 + 0.5f * spread);
+        parameters[cloth].lower_radius = base.lower_radius * (1 + 0.25f * spread);
+    }
+    return parameters;
+}
+
+ClothBatch::ClothBatch(unsigned int row_length, unsigned int column_length,
+                       const std::vector<ClothParameters> &parameters)
+    : row_length(row_length), column_length(column_length), parameters(parameters) {
+    for (vertex_buffer &buffer : buffers) {
+        buffer.x.resize(get_vertex_count());
+        buffer.y.resize(get_vertex_count());
+        buffer.z.resize(get_vertex_count());
+    }
+
+    vertex_buffer &start = buffers[buffer_indices::start_positions];
+    for (unsigned int cloth = 0; cloth < get_cloth_count(); cloth++) {
+        unsigned int base = cloth * get_cloth_vertex_count();
+        build_start_positions(&start.x[base], &start.y[base], &start.z[base], row_length,
+                              column_length, parameters[cloth]);
+        constraints.push_back(build_grid_constraints(&start.x[base], &start.y[base],
+                                                     &start.z[base], 1, row_length,
+                                                     column_length));
+    }
+
+    buffers[buffer_indices::first_positions] = start;
+    buffers[buffer_indices::second_positions] = start;
+    // the velocities are value initialised to zero by resize
+}
+
+StepContext ClothBatch::make_step_context(unsigned int cloth, float delta_time) {
+    unsigned int base = cloth * get_cloth_vertex_count();
+    const vertex_buffer &current = buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &next = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    vertex_buffer &velocity = buffers[buffer_indices::velocities];
+
+    StepContext context;
+    context.current_x = current.x.data() + base;
+    context.current_y = current.y.data() + base;
+    context.current_z = current.z.data() + base;
+    context.next_x = next.x.data() + base;
+    context.next_y = next.y.data() + base;
+    context.next_z = next.z.data() + base;
+    context.velocity_x = velocity.x.data() + base;
+    context.velocity_y = velocity.y.data() + base;
+    context.velocity_z = velocity.z.data() + base;
+    context.row_length = row_length;
+    context.column_length = column_length;
+    context.delta_time = delta_time;
+    context.spinning_speed = parameters[cloth].spinning_speed;
+    context.spring_strength = parameters[cloth].spring_strength;
+    context.gravity_strength = parameters[cloth].gravity_strength;
+    set_constraints(context, constraints[cloth]);
+    return context;
+}
+
+void ClothBatch::set_thread_count(unsigned int thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (thread_count == 1) {
+        thread_pool.reset();
+        bands_per_cloth = 1;
+        return;
+    }
+    thread_pool = std::make_unique<ThreadPool>(thread_count);
+    // whole cloths are enough tasks once there are a few per thread
+    unsigned int wanted_tasks = thread_count * 4;
+    bands_per_cloth = std::min(column_length,
+                               (wanted_tasks + get_cloth_count() - 1) / get_cloth_count());
+}
+
+void ClothBatch::step(float delta_time) {
+    std::vector<StepContext> contexts;
+    contexts.reserve(get_cloth_count());
+    for (unsigned int cloth = 0; cloth < get_cloth_count(); cloth++) {
+        contexts.push_back(make_step_context(cloth, delta_time));
+    }
+    span_kernel span = get_span_kernel(kernel);
+
+    auto update_band = [&](unsigned int task) {
+        unsigned int cloth = task / bands_per_cloth;
+        unsigned int band = task % bands_per_cloth;
+        unsigned int y_begin = column_length * band / bands_per_cloth;
+        unsigned int y_end = column_length * (band + 1) / bands_per_cloth;
+        update_rows(contexts[cloth], span, y_begin, y_end);
+        clamp_rows_to_ground(contexts[cloth], ground_height, y_begin, y_end);
+    };
+    if (!thread_pool) {
+        for (unsigned int task = 0; task < get_cloth_count() * bands_per_cloth; task++) {
+            update_band(task);
+        }
+    } else {
+        thread_pool->run(get_cloth_count() * bands_per_cloth, update_band);
+    }
+
+    current_buffer ^= 1;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "ClothSolver.hpp"
+
+#include <memory>
+#include <vector>
+
+// spinning speed and lower radius spread evenly around the base, so side by side cloths differ
+std::vector<ClothParameters> vary_parameters(unsigned int cloth_count,
+                                             const ClothParameters &base = {});
+
+// many independent cloths of the same grid size in one set of structure-of-arrays buffers,
+// cloth c owning vertices [c * n, (c + 1) * n); every cloth has its own parameters and springs,
+// and a step updates all of them in a single parallel loop
+class ClothBatch {
+    public:
+        using vertex_buffer = ClothSolver::vertex_buffer;
+
+    private:
+        unsigned int row_length;
+        unsigned int column_length;
+        std::vector<ClothParameters> parameters;
+
+        enum buffer_indices { start_positions, first_positions, second_positions, velocities, num };
+
+        vertex_buffer buffers[buffer_indices::num];
+        unsigned int current_buffer = 0;
+
+        // one table per cloth, since the radii and so the rest lengths differ
+        std::vector<ConstraintTable> constraints;
+
+        kernel_type kernel = best_kernel_type();
+
+        std::unique_ptr<ThreadPool> thread_pool;
+        // a task is one band of one cloth
+        unsigned int bands_per_cloth = 1;
+
+        StepContext make_step_context(unsigned int cloth, float delta_time);
+
+    public:
+        ClothBatch(unsigned int row_length, unsigned int column_length,
+                   const std::vector<ClothParameters> &parameters);
+
+        void step(float delta_time);
+
+        kernel_type get_kernel() const {
+            return kernel;
+        }
+
+        void set_kernel(kernel_type type) {
+            kernel = is_kernel_supported(type) ? type : kernel_scalar;
+        }
+
+        unsigned int get_thread_count() const {
+            return thread_pool ? thread_pool->get_thread_count() : 1;
+        }
+
+        // 0 uses every hardware thread
+        void set_thread_count(unsigned int thread_count);
+
+        unsigned int get_row_length() const {
+            return row_length;
+        }
+
+        unsigned int get_column_length() const {
+            return column_length;
+        }
+
+        unsigned int get_cloth_count() const {
+            return parameters.size();
+        }
+
+        unsigned int get_cloth_vertex_count() const {
+            return row_length * column_length;
+        }
+
+        // of all cloths together
+        unsigned int get_vertex_count() const {
+            return get_cloth_count() * get_cloth_vertex_count();
+        }
+
+        const std::vector<ClothParameters> &get_parameters() const {
+            return parameters;
+        }
+
+        const vertex_buffer &get_positions() const {
+            return buffers[buffer_indices::first_positions + current_buffer];
+        }
+
+        const vertex_buffer &get_previous_positions() const {
+            return buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+        }
+
+        const vertex_buffer &get_velocities() const {
+            return buffers[buffer_indices::velocities];
+        }
+};
@@ -0,0 +1,261 @@
+#include "ClothHierarchy.hpp"
+#include "PositionBasedKernels.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+// of the spring between two neighbouring vertices, from the plane of the end it is stored at
+float get_rest_length(const ConstraintTable &table, unsigned int row_length, unsigned int first_y,
+                      unsigned int first_x, unsigned int second_y, unsigned int second_x) {
+    if (second_y < first_y || (second_y == first_y && (second_x + 1) % row_length == first_x)) {
+        std::swap(first_y, second_y);
+        std::swap(first_x, second_x);
+    }
+    unsigned int direction = ConstraintTable::down_left;
+    if (second_y == first_y) {
+        direction = ConstraintTable::right;
+    } else if (second_x == first_x) {
+        direction = ConstraintTable::down;
+    } else if (second_x == (first_x + 1) % row_length) {
+        direction = ConstraintTable::down_right;
+    }
+    return table.stencil_rest_lengths[direction][first_y * row_length + first_x];
+}
+} // namespace
+
+ClothHierarchy::ClothHierarchy(const float *x, const float *y, const float *z,
+                               unsigned int row_length, unsigned int column_length,
+                               unsigned int level_count)
+    : row_length(row_length), column_length(column_length) {
+    std::vector<float> finer_start[3] = {{x, x + row_length * column_length},
+                                         {y, y + row_length * column_length},
+                                         {z, z + row_length * column_length}};
+    unsigned int finer_row_length = row_length;
+    unsigned int finer_column_length = column_length;
+    while (levels.size() + 1 < level_count
+           && finer_column_length >= 2 * min_coarse_column_length) {
+        level coarse;
+        coarse.column_step =
+            finer_row_length % 2 == 0 && finer_row_length / 2 >= min_coarse_row_length ? 2 : 1;
+        coarse.row_length = finer_row_length / coarse.column_step;
+        // every other row up to the last even one, then the last row
+        coarse.column_length = finer_column_length / 2 + 1;
+
+        unsigned int vertex_count = coarse.row_length * coarse.column_length;
+        std::vector<float> start[3];
+        for (unsigned int k = 0; k < 3; k++) {
+            start[k].resize(vertex_count);
+            for (unsigned int y_index = 0; y_index < coarse.column_length; y_index++) {
+                unsigned int finer_y = get_finer_row(y_index, finer_column_length);
+                for (unsigned int x_index = 0; x_index < coarse.row_length; x_index++) {
+                    start[k][y_index * coarse.row_length + x_index] =
+                        finer_start[k][finer_y * finer_row_length + x_index * coarse.column_step];
+                }
+            }
+            coarse.positions[k] = start[k];
+            coarse.projection[k] = start[k];
+            coarse.restricted[k] = start[k];
+        }
+        coarse.constraints = build_grid_constraints(start[0].data(), start[1].data(),
+                                                    start[2].data(), 1, coarse.row_length,
+                                                    coarse.column_length);
+
+        finer_row_length = coarse.row_length;
+        finer_column_length = coarse.column_length;
+        for (unsigned int k = 0; k < 3; k++) {
+            finer_start[k] = std::move(start[k]);
+        }
+        levels.push_back(std::move(coarse));
+    }
+}
+
+void ClothHierarchy::restrict_level(unsigned int index, const ConstraintTable &finer_constraints,
+                                    const float *const finer[3],
+                                    const band_runner &for_each_band) {
+    level &coarse = levels[index];
+    unsigned int finer_row_length = get_finer_row_length(index);
+    unsigned int finer_column_length = get_finer_column_length(index);
+    // the directions of ConstraintTable::stencil_directions
+    const int stencil_delta_x[] = {1, -1, 0, 1};
+    const unsigned int stencil_delta_y[] = {0, 1, 1, 1};
+    for_each_band(coarse.column_length, [&](unsigned int y_begin, unsigned int y_end) {
+        for (unsigned int k = 0; k < 3; k++) {
+            for (unsigned int y = y_begin; y < y_end; y++) {
+                const float *finer_row = finer[k] + get_finer_row(y, finer_column_length)
+                                                        * finer_row_length;
+                for (unsigned int x = 0; x < coarse.row_length; x++) {
+                    float value = finer_row[x * coarse.column_step];
+                    coarse.positions[k][y * coarse.row_length + x] = value;
+                    coarse.restricted[k][y * coarse.row_length + x] = value;
+                }
+            }
+        }
+
+        // a coarse spring spans one finer spring or two, through the finer vertex between its
+        // ends; it rests at the length of those with each one scaled back to its rest length,
+        // so it is stretched just as far as they are and does not fight their bending
+        for (unsigned int direction = 0; direction < ConstraintTable::num_directions;
+             direction++) {
+            std::vector<float> &plane = coarse.constraints.stencil_rest_lengths[direction];
+            for (unsigned int y = y_begin; y < y_end; y++) {
+                if (y + stencil_delta_y[direction] >= coarse.column_length) {
+                    continue;
+                }
+                unsigned int first_y = get_finer_row(y, finer_column_length);
+                unsigned int second_y =
+                    get_finer_row(y + stencil_delta_y[direction], finer_column_length);
+                int delta_x = stencil_delta_x[direction] * static_cast<int>(coarse.column_step);
+                unsigned int middle_y = first_y + (second_y - first_y) / 2;
+                for (unsigned int x = 0; x < coarse.row_length; x++) {
+                    unsigned int first_x = x * coarse.column_step;
+                    unsigned int second_x =
+                        (first_x + finer_row_length + delta_x) % finer_row_length;
+                    if (second_y - first_y <= 1 && std::abs(delta_x) <= 1) {
+                        plane[y * coarse.row_length + x] =
+                            get_rest_length(finer_constraints, finer_row_length, first_y,
+                                            first_x, second_y, second_x);
+                        continue;
+                    }
+
+                    unsigned int middle_x =
+                        (first_x + finer_row_length + delta_x / 2) % finer_row_length;
+                    unsigned int ends[3] = {first_y * finer_row_length + first_x,
+                                            middle_y * finer_row_length + middle_x,
+                                            second_y * finer_row_length + second_x};
+                    float scales[2] = {get_rest_length(finer_constraints, finer_row_length,
+                                                       first_y, first_x, middle_y, middle_x),
+                                       get_rest_length(finer_constraints, finer_row_length,
+                                                       middle_y, middle_x, second_y, second_x)};
+                    for (unsigned int part = 0; part < 2; part++) {
+                        float length = 0;
+                        for (unsigned int k = 0; k < 3; k++) {
+                            float diff = finer[k][ends[part + 1]] - finer[k][ends[part]];
+                            length += diff * diff;
+                        }
+                        length = std::sqrt(length);
+                        scales[part] = length == 0 ? 0 : scales[part] / length;
+                    }
+                    float rest_length = 0;
+                    for (unsigned int k = 0; k < 3; k++) {
+                        float diff = scales[0] * (finer[k][ends[1]] - finer[k][ends[0]])
+                                     + scales[1] * (finer[k][ends[2]] - finer[k][ends[1]]);
+                        rest_length += diff * diff;
+                    }
+                    plane[y * coarse.row_length + x] = std::sqrt(rest_length);
+                }
+            }
+        }
+    });
+
+    // the springs of a row are stored at the row above as well
+    ConstraintTable &table = coarse.constraints;
+    for_each_band(coarse.column_length, [&](unsigned int y_begin, unsigned int y_end) {
+        for (unsigned int i = y_begin * coarse.row_length; i < y_end * coarse.row_length; i++) {
+            for (unsigned int constraint = table.offsets[i]; constraint < table.offsets[i + 1];
+                 constraint++) {
+                unsigned int other_index = table.neighbours[constraint];
+                table.rest_lengths[constraint] = get_rest_length(
+                    table, coarse.row_length, i / coarse.row_length, i % coarse.row_length,
+                    other_index / coarse.row_length, other_index % coarse.row_length);
+            }
+        }
+    });
+}
+
+void ClothHierarchy::relax_level(unsigned int index, float relaxation,
+                                 unsigned int iteration_count, const band_runner &for_each_band) {
+    level &coarse = levels[index];
+    // project_rows only reads the springs and the grid size
+    StepContext context = {};
+    set_constraints(context, coarse.constraints);
+    context.row_length = coarse.row_length;
+    context.column_length = coarse.column_length;
+    for (unsigned int iteration = 0; iteration < iteration_count; iteration++) {
+        const float *const source[3] = {coarse.positions[0].data(), coarse.positions[1].data(),
+                                        coarse.positions[2].data()};
+        float *const target[3] = {coarse.projection[0].data(), coarse.projection[1].data(),
+                                  coarse.projection[2].data()};
+        for_each_band(coarse.column_length, [&](unsigned int y_begin, unsigned int y_end) {
+            project_rows(context, source, target, relaxation, y_begin, y_end);
+        });
+        for (unsigned int k = 0; k < 3; k++) {
+            std::swap(coarse.positions[k], coarse.projection[k]);
+        }
+    }
+}
+
+void ClothHierarchy::cycle(unsigned int index, float relaxation, unsigned int pre_count,
+                           unsigned int post_count, const band_runner &for_each_band) {
+    relax_level(index, relaxation, pre_count, for_each_band);
+    if (index + 1 == levels.size()) {
+        // the coarsest level has no one to hand its error down to
+        relax_level(index, relaxation, post_count, for_each_band);
+        return;
+    }
+
+    level &coarse = levels[index];
+    float *const positions[3] = {coarse.positions[0].data(), coarse.positions[1].data(),
+                                 coarse.positions[2].data()};
+    restrict_level(index + 1, coarse.constraints, positions, for_each_band);
+    cycle(index + 1, relaxation, pre_count, post_count, for_each_band);
+    for_each_band(coarse.column_length, [&](unsigned int y_begin, unsigned int y_end) {
+        correct_finer_rows(index + 1, positions, y_begin, y_end);
+    });
+    relax_level(index, relaxation, post_count, for_each_band);
+}
+
+void ClothHierarchy::correct_finer_rows(unsigned int index, float *const finer[3],
+                                        unsigned int y_begin, unsigned int y_end) const {
+    const level &coarse = levels[index];
+    unsigned int finer_row_length = get_finer_row_length(index);
+    unsigned int finer_column_length = get_finer_column_length(index);
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        // between the coarse rows above and below, the last coarse row being the last finer
+        // row however far it lies from the one before
+        unsigned int upper = y / 2;
+        unsigned int upper_y = get_finer_row(upper, finer_column_length);
+        unsigned int lower = upper_y == y ? upper : upper + 1;
+        unsigned int lower_y = get_finer_row(lower, finer_column_length);
+        float row_weight =
+            lower_y == upper_y ? 0 : static_cast<float>(y - upper_y) / (lower_y - upper_y);
+
+        for (unsigned int x = 0; x < finer_row_length; x++) {
+            // between the coarse columns left and right, wrapping around at the seam
+            unsigned int left = x / coarse.column_step;
+            bool on_column = x % coarse.column_step == 0;
+            unsigned int right = on_column ? left : (left + 1) % coarse.row_length;
+            float column_weight = on_column ? 0 : 0.5f;
+
+            unsigned int corners[4] = {
+                upper * coarse.row_length + left, upper * coarse.row_length + right,
+                lower * coarse.row_length + left, lower * coarse.row_length + right};
+            float weights[4] = {
+                correction_weight * (1 - row_weight) * (1 - column_weight),
+                correction_weight * (1 - row_weight) * column_weight,
+                correction_weight * row_weight * (1 - column_weight),
+                correction_weight * row_weight * column_weight};
+            for (unsigned int k = 0; k < 3; k++) {
+                float correction = 0;
+                for (unsigned int corner = 0; corner < 4; corner++) {
+                    correction += weights[corner]
+                                  * (coarse.positions[k][corners[corner]]
+                                     - coarse.restricted[k][corners[corner]]);
+                }
+                finer[k][y * finer_row_length + x] += correction;
+            }
+        }
+    }
+}
+
+void ClothHierarchy::solve_coarse(const ConstraintTable &fine_constraints,
+                                  const float *const fine[3], float relaxation,
+                                  unsigned int pre_count, unsigned int post_count,
+                                  const band_runner &for_each_band) {
+    if (levels.empty()) {
+        return;
+    }
+    restrict_level(0, fine_constraints, fine, for_each_band);
+    cycle(0, relaxation, pre_count, post_count, for_each_band);
+}
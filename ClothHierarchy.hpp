@@ -0,0 +1,117 @@
+#pragma once
+#include "ConstraintTable.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// coarser copies of the cloth grid for the position based step; on the fine grid a jacobi
+// iteration carries a correction only one ring of springs further, so the pull of the top row
+// needs many steps to reach the bottom of a long cloth, while a v-cycle over the levels carries
+// it across the whole cloth within every step
+//
+// every coarse level keeps every other row of the next finer one, its last row included, and
+// every other column as long as the row length stays even and at least min_coarse_row_length
+//
+// every restriction rests a coarse spring at the length of the finer springs it spans, each one
+// scaled back to its own rest length; a coarse spring is stretched just as far as those are, so
+// once the finer springs are at rest the coarse ones are too and the correction is zero, while
+// springs fixed at their start lengths would hold the cloth to its start shape
+class ClothHierarchy {
+    public:
+        // runs task(y_begin, y_end) over bands of [0, row_count), e.g. on a thread pool
+        using band_runner = std::function<void(
+            unsigned int row_count, const std::function<void(unsigned int, unsigned int)> &task)>;
+
+        // columns are only halved while the coarse row still keeps the cone round
+        static constexpr unsigned int min_coarse_row_length = 8;
+        // rows below this are not coarsened any further
+        static constexpr unsigned int min_coarse_column_length = 3;
+        // share of its correction a level hands back; the whole of it overshoots once a few
+        // levels add up, and a tall cloth then keeps swinging instead of settling
+        static constexpr float correction_weight = 0.6f;
+
+    private:
+        struct level {
+            public:
+                unsigned int row_length;
+                unsigned int column_length;
+                // columns of the next finer level per column of this one, 1 or 2
+                unsigned int column_step;
+                ConstraintTable constraints;
+                // relaxed on this level, with the projection as the target of every other
+                // iteration
+                std::vector<float> positions[3];
+                std::vector<float> projection[3];
+                // as sampled from the next finer level, so positions minus these is the
+                // correction to hand back
+                std::vector<float> restricted[3];
+        };
+
+        unsigned int row_length;
+        unsigned int column_length;
+        // from the finest coarse level to the coarsest
+        std::vector<level> levels;
+
+        // the row of the next finer level that row y samples
+        static unsigned int get_finer_row(unsigned int y, unsigned int finer_column_length) {
+            return std::min(2 * y, finer_column_length - 1);
+        }
+
+        unsigned int get_finer_row_length(unsigned int index) const {
+            return index == 0 ? row_length : levels[index - 1].row_length;
+        }
+
+        unsigned int get_finer_column_length(unsigned int index) const {
+            return index == 0 ? column_length : levels[index - 1].column_length;
+        }
+
+        // samples the positions of the next finer level and rests the springs of the level at
+        // the length of the finer springs they span
+        void restrict_level(unsigned int index, const ConstraintTable &finer_constraints,
+                            const float *const finer[3], const band_runner &for_each_band);
+        void relax_level(unsigned int index, float relaxation, unsigned int iteration_count,
+                         const band_runner &for_each_band);
+        // the v-cycle from this level down
+        void cycle(unsigned int index, float relaxation, unsigned int pre_count,
+                   unsigned int post_count, const band_runner &for_each_band);
+        // adds correction_weight times the correction of the level to rows [y_begin, y_end) of
+        // the next finer one
+        void correct_finer_rows(unsigned int index, float *const finer[3], unsigned int y_begin,
+                                unsigned int y_end) const;
+
+    public:
+        // builds up to level_count - 1 coarse levels below the grid with the given start
+        // positions, fewer if the rows run out first
+        ClothHierarchy(const float *x, const float *y, const float *z, unsigned int row_length,
+                       unsigned int column_length, unsigned int level_count);
+
+        // the fine grid included
+        unsigned int get_level_count() const {
+            return levels.size() + 1;
+        }
+
+        // of level 0, the fine grid, up to get_level_count() - 1
+        unsigned int get_row_length(unsigned int level) const {
+            return level == 0 ? row_length : levels[level - 1].row_length;
+        }
+
+        unsigned int get_column_length(unsigned int level) const {
+            return level == 0 ? column_length : levels[level - 1].column_length;
+        }
+
+        // samples the fine positions onto the coarse levels, with springs rested against
+        // fine_constraints, and runs the coarse part of a v-cycle, with pre_count iterations on
+        // every level on the way down and post_count on the way up
+        void solve_coarse(const ConstraintTable &fine_constraints, const float *const fine[3],
+                          float relaxation, unsigned int pre_count, unsigned int post_count,
+                          const band_runner &for_each_band);
+
+        // adds the correction found by solve_coarse to rows [y_begin, y_end) of the fine
+        // positions it was given
+        void correct_rows(float *const fine[3], unsigned int y_begin, unsigned int y_end) const {
+            if (!levels.empty()) {
+                correct_finer_rows(0, fine, y_begin, y_end);
+            }
+        }
+};
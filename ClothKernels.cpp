@@ -0,0 +1,147 @@
+#include "ClothKernels.hpp"
+#include "ConstraintTable.hpp"
+
+#include <cmath>
+
+void set_constraints(StepContext &context, const ConstraintTable &table) {
+    context.constraint_offsets = table.offsets.data();
+    context.constraint_neighbours = table.neighbours.data();
+    context.constraint_rest_lengths = table.rest_lengths.data();
+
+    const float *planes[ConstraintTable::num_directions];
+    for (unsigned int direction = 0; direction < ConstraintTable::num_directions; direction++) {
+        planes[direction] = table.stencil_rest_lengths[direction].data();
+    }
+    set_stencil_planes(context, planes);
+}
+
+void set_stencil_planes(StepContext &context,
+                        const float *const planes[ConstraintTable::num_directions]) {
+    // each spring is stored at its upper or left end
+    const int row_length = context.row_length;
+    const ConstraintTable::stencil_directions directions[8] = {
+        ConstraintTable::down_right, ConstraintTable::down, ConstraintTable::down_left,
+        ConstraintTable::right,      ConstraintTable::right, ConstraintTable::down_left,
+        ConstraintTable::down,       ConstraintTable::down_right};
+    const int offsets[8] = {-row_length - 1, -row_length, -row_length + 1, -1, 0, 0, 0, 0};
+    for (unsigned int i = 0; i < 8; i++) {
+        context.stencil_planes[i] = planes[directions[i]];
+        context.stencil_offsets[i] = offsets[i];
+    }
+}
+
+void update_vertex(const StepContext &context, unsigned int x, unsigned int y) {
+    unsigned int vertex_index = y * context.row_length + x;
+
+    float velocity_x = context.velocity_x[vertex_index];
+    float velocity_y =
+        context.velocity_y[vertex_index] - context.gravity_strength * context.delta_time;
+    float velocity_z = context.velocity_z[vertex_index];
+
+    for (unsigned int constraint = context.constraint_offsets[vertex_index];
+         constraint < context.constraint_offsets[vertex_index + 1]; constraint++) {
+        unsigned int other_index = context.constraint_neighbours[constraint];
+        float wanted_distance = context.constraint_rest_lengths[constraint];
+
+        float diff_x = context.current_x[vertex_index] - context.current_x[other_index];
+        float diff_y = context.current_y[vertex_index] - context.current_y[other_index];
+        float diff_z = context.current_z[vertex_index] - context.current_z[other_index];
+        float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z);
+
+        // normalize(position_diff) * delta_len * delta_time * spring_strength
+        float factor = (wanted_distance - distance) * context.delta_time
+                       * context.spring_strength / distance;
+        velocity_x += diff_x * factor;
+        velocity_y += diff_y * factor;
+        velocity_z += diff_z * factor;
+    }
+
+    velocity_y /= 10;
+
+    context.velocity_x[vertex_index] = velocity_x;
+    context.velocity_y[vertex_index] = velocity_y;
+    context.velocity_z[vertex_index] = velocity_z;
+
+    context.next_x[vertex_index] =
+        context.current_x[vertex_index] + velocity_x * context.delta_time;
+    context.next_y[vertex_index] =
+        context.current_y[vertex_index] + velocity_y * context.delta_time;
+    context.next_z[vertex_index] =
+        context.current_z[vertex_index] + velocity_z * context.delta_time;
+}
+
+void update_top_row(const StepContext &context) {
+    float alpha = context.delta_time * context.spinning_speed;
+    float cs = std::cos(alpha);
+    float sn = std::sin(alpha);
+
+    for (unsigned int x = 0; x < context.row_length; x++) {
+        context.next_x[x] = cs * context.current_x[x] + sn * context.current_z[x];
+        context.next_y[x] = context.current_y[x];
+        context.next_z[x] = -sn * context.current_x[x] + cs * context.current_z[x];
+    }
+}
+
+void update_rows(const StepContext &context, span_kernel kernel, unsigned int y_begin,
+                 unsigned int y_end) {
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        if (y == 0) {
+            update_top_row(context);
+            continue;
+        }
+        update_vertex(context, 0, y);
+        if (context.row_length > 2) {
+            kernel(context, y, 1, context.row_length - 1);
+        }
+        if (context.row_length > 1) {
+            update_vertex(context, context.row_length - 1, y);
+        }
+    }
+}
+
+bool is_kernel_supported(kernel_type type) {
+    switch (type) {
+        case kernel_scalar:
+            return true;
+        case kernel_sse42:
+            return __builtin_cpu_supports("sse4.2");
+        case kernel_avx2:
+            return __builtin_cpu_supports("avx2");
+        default:
+            return false;
+    }
+}
+
+kernel_type best_kernel_type() {
+    if (is_kernel_supported(kernel_avx2)) {
+        return kernel_avx2;
+    }
+    if (is_kernel_supported(kernel_sse42)) {
+        return kernel_sse42;
+    }
+    return kernel_scalar;
+}
+
+span_kernel get_span_kernel(kernel_type type) {
+    switch (type) {
+        case kernel_sse42:
+            return update_span_sse42;
+        case kernel_avx2:
+            return update_span_avx2;
+        default:
+            return update_span_scalar;
+    }
+}
+
+const char *kernel_name(kernel_type type) {
+    switch (type) {
+        case kernel_scalar:
+            return "scalar";
+        case kernel_sse42:
+            return "sse4.2";
+        case kernel_avx2:
+            return "avx2";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+struct ConstraintTable;
+
+// pointers into the solver buffers and the uniforms used for one step
+struct StepContext {
+        // the springs of every vertex, used by update_vertex
+        const unsigned int *constraint_offsets;
+        const unsigned int *constraint_neighbours;
+        const float *constraint_rest_lengths;
+        // rest length of the i-th stencil neighbour of vertex v, in the order vertex_shader.hpp
+        // visits them, is stencil_planes[i][v + stencil_offsets[i]]; used by the span kernels
+        const float *stencil_planes[8];
+        int stencil_offsets[8];
+        const float *current_x;
+        const float *current_y;
+        const float *current_z;
+        float *next_x;
+        float *next_y;
+        float *next_z;
+        float *velocity_x;
+        float *velocity_y;
+        float *velocity_z;
+        unsigned int row_length;
+        unsigned int column_length;
+        float delta_time;
+        float spinning_speed;
+        float spring_strength;
+        float gravity_strength;
+};
+
+// points the context at the springs of the table
+void set_constraints(StepContext &context, const ConstraintTable &table);
+
+// points the context at stencil planes laid out like ConstraintTable::stencil_rest_lengths but
+// with the row length of the context, e.g. those of a tile; leaves the compressed rows alone
+void set_stencil_planes(StepContext &context, const float *const planes[4]);
+
+enum kernel_type { kernel_scalar, kernel_sse42, kernel_avx2, num_kernel_types };
+
+// updates vertices [x_begin, x_end) of row y, which must not touch the wrap-around column
+// (0 < x_begin, x_end < row_length) and must not be the top row
+using span_kernel = void (*)(const StepContext &context, unsigned int y, unsigned int x_begin,
+                             unsigned int x_end);
+
+void update_span_scalar(const StepContext &context, unsigned int y, unsigned int x_begin,
+                        unsigned int x_end);
+void update_span_sse42(const StepContext &context, unsigned int y, unsigned int x_begin,
+                       unsigned int x_end);
+void update_span_avx2(const StepContext &context, unsigned int y, unsigned int x_begin,
+                      unsigned int x_end);
+
+// updates any vertex below the top row from its list of springs
+void update_vertex(const StepContext &context, unsigned int x, unsigned int y);
+
+// rotates the top row around the vertical axis
+void update_top_row(const StepContext &context);
+
+// updates rows [y_begin, y_end), using the span kernel for everything except the two seam columns
+void update_rows(const StepContext &context, span_kernel kernel, unsigned int y_begin,
+                 unsigned int y_end);
+
+bool is_kernel_supported(kernel_type type);
+kernel_type best_kernel_type();
+span_kernel get_span_kernel(kernel_type type);
+const char *kernel_name(kernel_type type);
@@ -0,0 +1,84 @@
+#include "ClothMesh.hpp"
+
+#include <cmath>
+
+namespace {
+// adds normalize(cross(first, second))
+void add_triangle_normal(const float first[3], const float second[3], float normal[3]) {
+    float cross[3] = {first[1] * second[2] - first[2] * second[1],
+                      first[2] * second[0] - first[0] * second[2],
+                      first[0] * second[1] - first[1] * second[0]};
+    float length = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        normal[axis] += cross[axis] / length;
+    }
+}
+} // namespace
+
+std::vector<unsigned int> build_render_indices(unsigned int row_length,
+                                               unsigned int column_length) {
+    std::vector<unsigned int> indices;
+    indices.reserve(get_render_index_count(row_length, column_length));
+    const unsigned int x_offsets[6] = {0, 0, 1, 1, 0, 1};
+    const unsigned int y_offsets[6] = {0, 1, 0, 0, 1, 1};
+    for (unsigned int square_y = 0; square_y + 1 < column_length; square_y++) {
+        for (unsigned int square_x = 0; square_x < row_length; square_x++) {
+            for (unsigned int corner = 0; corner < 6; corner++) {
+                indices.push_back((square_y + y_offsets[corner]) * (row_length + 1) + square_x
+                                  + x_offsets[corner]);
+            }
+        }
+    }
+    return indices;
+}
+
+void compute_vertex_normal(const float *x, const float *y, const float *z, unsigned int row_length,
+                           unsigned int column_length, unsigned int vertex_x,
+                           unsigned int vertex_y, float normal[3]) {
+    unsigned int vertex_index = vertex_y * row_length + vertex_x;
+    unsigned int left_index = vertex_y * row_length + (vertex_x + row_length - 1) % row_length;
+    unsigned int right_index = vertex_y * row_length + (vertex_x + 1) % row_length;
+    auto vector_to = [&](unsigned int other_index, float vector[3]) {
+        vector[0] = x[other_index] - x[vertex_index];
+        vector[1] = y[other_index] - y[vertex_index];
+        vector[2] = z[other_index] - z[vertex_index];
+    };
+
+    normal[0] = normal[1] = normal[2] = 0;
+    unsigned int adjacent_triangles = 0;
+    float left[3];
+    float right[3];
+    float other[3];
+    vector_to(left_index, left);
+    vector_to(right_index, right);
+    if (vertex_y > 0) {
+        vector_to(vertex_index - row_length, other);
+        add_triangle_normal(other, left, normal);
+        add_triangle_normal(right, other, normal);
+        adjacent_triangles += 2;
+    }
+    if (vertex_y < column_length - 1) {
+        vector_to(vertex_index + row_length, other);
+        add_triangle_normal(left, other, normal);
+        add_triangle_normal(other, right, normal);
+        adjacent_triangles += 2;
+    }
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        normal[axis] /= adjacent_triangles;
+    }
+}
+
+void compute_normal_rows(const float *x, const float *y, const float *z, unsigned int row_length,
+                         unsigned int column_length, float *normal_x, float *normal_y,
+                         float *normal_z, unsigned int y_begin, unsigned int y_end) {
+    for (unsigned int vertex_y = y_begin; vertex_y < y_end; vertex_y++) {
+        for (unsigned int vertex_x = 0; vertex_x < row_length; vertex_x++) {
+            float normal[3];
+            compute_vertex_normal(x, y, z, row_length, column_length, vertex_x, vertex_y, normal);
+            unsigned int vertex_index = vertex_y * row_length + vertex_x;
+            normal_x[vertex_index] = normal[0];
+            normal_y[vertex_index] = normal[1];
+            normal_z[vertex_index] = normal[2];
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// the drawn mesh repeats the first column of the grid at the end of every row, so the seam gets
+// texture coordinate 1 instead of wrapping back to 0; render vertex r is grid vertex
+// (r / (row_length + 1)) * row_length + r % (row_length + 1) % row_length
+inline unsigned int get_render_vertex_count(unsigned int row_length, unsigned int column_length) {
+    return (row_length + 1) * column_length;
+}
+
+inline unsigned int get_render_index_count(unsigned int row_length, unsigned int column_length) {
+    return 6 * row_length * (column_length - 1);
+}
+
+// two triangles per quad, row by row, in the order vertex_shader.hpp used to emit them without
+// an element buffer
+std::vector<unsigned int> build_render_indices(unsigned int row_length,
+                                               unsigned int column_length);
+
+// average of the normals of the up to four triangles around vertex (vertex_x, vertex_y), the
+// way normal_shader.hpp computes it
+void compute_vertex_normal(const float *x, const float *y, const float *z, unsigned int row_length,
+                           unsigned int column_length, unsigned int vertex_x,
+                           unsigned int vertex_y, float normal[3]);
+
+// the normals of rows [y_begin, y_end)
+void compute_normal_rows(const float *x, const float *y, const float *z, unsigned int row_length,
+                         unsigned int column_length, float *normal_x, float *normal_y,
+                         float *normal_z, unsigned int y_begin, unsigned int y_end);
@@ -0,0 +1,11 @@
+#pragma once
+#include "constants.hpp"
+
+// the uniforms of vertex_shader.hpp that drive the simulation, with the same defaults
+struct ClothParameters {
+        float spinning_speed = 0.5f;
+        float spring_strength = 300;
+        float gravity_strength = 0.01f;
+        float upper_radius = ::upper_radius;
+        float lower_radius = ::lower_radius;
+};
@@ -0,0 +1,109 @@
+#include "ClothSlab.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ClothSlab::ClothSlab(unsigned int row_length, unsigned int column_length,
+                     const ClothParameters &parameters, unsigned int y_begin, unsigned int y_end,
+                     HaloTransport *transport, bool ground_collision)
+    : row_length(row_length), column_length(column_length), y_begin(y_begin), y_end(y_end),
+      parameters(parameters), transport(transport), ground_collision(ground_collision) {
+    if (y_begin >= y_end || y_end > column_length) {
+        throw std::runtime_error("a slab needs at least one row of the cloth");
+    }
+    first_row = has_neighbour(halo_above) ? 1 : 0;
+    unsigned int local_y_begin = y_begin - first_row;
+    unsigned int local_y_end = y_end + (has_neighbour(halo_below) ? 1 : 0);
+    local_column_length = local_y_end - local_y_begin;
+
+    unsigned int vertex_count = row_length * local_column_length;
+    for (vertex_buffer &buffer : buffers) {
+        buffer.x.resize(vertex_count);
+        buffer.y.resize(vertex_count);
+        buffer.z.resize(vertex_count);
+    }
+    // the halos start out where the neighbours start, so the springs reaching into them get
+    // the rest lengths of the whole cloth
+    vertex_buffer &start = buffers[buffer_indices::first_positions];
+    build_start_rows(start.x.data(), start.y.data(), start.z.data(), row_length, column_length,
+                     parameters, local_y_begin, local_y_end);
+    constraints = build_grid_constraints(start.x.data(), start.y.data(), start.z.data(), 1,
+                                         row_length, local_column_length);
+    buffers[buffer_indices::second_positions] = start;
+
+    for (unsigned int side = 0; side < num_halo_sides; side++) {
+        if (has_neighbour(static_cast<halo_side>(side))) {
+            halo_send[side].resize(3 * row_length);
+            halo_receive[side].resize(3 * row_length);
+        }
+    }
+}
+
+StepContext ClothSlab::make_step_context(float delta_time) {
+    const vertex_buffer &current = buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &next = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    vertex_buffer &velocity = buffers[buffer_indices::velocities];
+
+    StepContext context;
+    context.current_x = current.x.data();
+    context.current_y = current.y.data();
+    context.current_z = current.z.data();
+    context.next_x = next.x.data();
+    context.next_y = next.y.data();
+    context.next_z = next.z.data();
+    context.velocity_x = velocity.x.data();
+    context.velocity_y = velocity.y.data();
+    context.velocity_z = velocity.z.data();
+    context.row_length = row_length;
+    context.column_length = local_column_length;
+    context.delta_time = delta_time;
+    context.spinning_speed = parameters.spinning_speed;
+    context.spring_strength = parameters.spring_strength;
+    context.gravity_strength = parameters.gravity_strength;
+    set_constraints(context, constraints);
+    return context;
+}
+
+void ClothSlab::exchange_halos() {
+    vertex_buffer &current = buffers[buffer_indices::first_positions + current_buffer];
+    std::vector<float> *coordinates[3] = {&current.x, &current.y, &current.z};
+    // the outermost owned row on each side goes out, the halo row next to it comes in
+    const unsigned int sent_rows[num_halo_sides] = {first_row, first_row + y_end - y_begin - 1};
+    const unsigned int halo_rows[num_halo_sides] = {0, local_column_length - 1};
+
+    halo_message messages[num_halo_sides];
+    for (unsigned int side = 0; side < num_halo_sides; side++) {
+        if (halo_send[side].empty()) {
+            continue;
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            auto row = coordinates[k]->begin() + sent_rows[side] * row_length;
+            std::copy(row, row + row_length, halo_send[side].begin() + k * row_length);
+        }
+        messages[side] = {halo_send[side].data(), halo_receive[side].data(),
+                          halo_send[side].size() * sizeof(float)};
+    }
+    transport->exchange(messages);
+
+    for (unsigned int side = 0; side < num_halo_sides; side++) {
+        if (halo_receive[side].empty()) {
+            continue;
+        }
+        for (unsigned int k = 0; k < 3; k++) {
+            auto row = halo_receive[side].begin() + k * row_length;
+            std::copy(row, row + row_length,
+                      coordinates[k]->begin() + halo_rows[side] * row_length);
+        }
+    }
+}
+
+void ClothSlab::step_rows(float delta_time) {
+    StepContext context = make_step_context(delta_time);
+    // the top row of the cloth is local row 0 of the first slab, which update_rows turns
+    unsigned int row_end = first_row + y_end - y_begin;
+    update_rows(context, get_span_kernel(kernel), first_row, row_end);
+    if (ground_collision) {
+        clamp_rows_to_ground(context, ground_height, first_row, row_end);
+    }
+    current_buffer ^= 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "ClothSolver.hpp"
+#include "HaloTransport.hpp"
+
+#include <vector>
+
+// rows [y_begin, y_end) of a cloth, stepped with the explicit update the way ClothSolver steps
+// the whole grid; a row reads the rows right above and below it, so the slab keeps one halo
+// row on each side that has a neighbouring slab and fills it through the transport before every
+// step; whole rows are split, so the seam at row_length stays inside every slab
+//
+// the slab stores and builds only its own rows and halos, springs included, and steps to the
+// same bits as ClothSolver in the lab frame without self-collision
+class ClothSlab {
+    public:
+        using vertex_buffer = ClothSolver::vertex_buffer;
+
+    private:
+        unsigned int row_length;
+        // of the whole cloth
+        unsigned int column_length;
+        unsigned int y_begin;
+        unsigned int y_end;
+        ClothParameters parameters;
+        HaloTransport *transport;
+        bool ground_collision;
+
+        // local row of y_begin, 1 behind a halo above and 0 for the slab holding the top row
+        unsigned int first_row;
+        // the owned rows and the halos
+        unsigned int local_column_length;
+
+        enum buffer_indices { first_positions, second_positions, velocities, num };
+
+        vertex_buffer buffers[buffer_indices::num];
+        unsigned int current_buffer = 0;
+        ConstraintTable constraints;
+        kernel_type kernel = best_kernel_type();
+
+        // one row of x, y and z after each other per side, as sent and as received
+        std::vector<float> halo_send[num_halo_sides];
+        std::vector<float> halo_receive[num_halo_sides];
+
+        bool has_neighbour(halo_side side) const {
+            return side == halo_above ? y_begin > 0 : y_end < column_length;
+        }
+
+        StepContext make_step_context(float delta_time);
+
+    public:
+        // the transport must outlive the slab
+        ClothSlab(unsigned int row_length, unsigned int column_length,
+                  const ClothParameters &parameters, unsigned int y_begin, unsigned int y_end,
+                  HaloTransport *transport, bool ground_collision = true);
+
+        // sends the outermost owned rows to the neighbours and receives their rows into the
+        // halos of the current positions
+        void exchange_halos();
+
+        // steps the owned rows, reading the halos as the last exchange left them
+        void step_rows(float delta_time);
+
+        // exchange_halos and step_rows; every slab of the cloth has to step at the same time
+        void step(float delta_time) {
+            exchange_halos();
+            step_rows(delta_time);
+        }
+
+        unsigned int get_y_begin() const {
+            return y_begin;
+        }
+
+        unsigned int get_y_end() const {
+            return y_end;
+        }
+
+        unsigned int get_owned_vertex_count() const {
+            return (y_end - y_begin) * row_length;
+        }
+
+        // of the first owned vertex in the local buffers
+        unsigned int get_owned_offset() const {
+            return first_row * row_length;
+        }
+
+        // the owned rows and the halos, in local rows
+        const vertex_buffer &get_positions() const {
+            return buffers[buffer_indices::first_positions + current_buffer];
+        }
+
+        const vertex_buffer &get_velocities() const {
+            return buffers[buffer_indices::velocities];
+        }
+
+        kernel_type get_kernel() const {
+            return kernel;
+        }
+
+        void set_kernel(kernel_type type) {
+            kernel = is_kernel_supported(type) ? type : kernel_scalar;
+        }
+};
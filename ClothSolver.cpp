@@ -0,0 +1,765 @@
+#include "ClothSolver.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+void build_start_positions(float *x, float *y, float *z, unsigned int row_length,
+                           unsigned int column_length, const ClothParameters &parameters) {
+    build_start_rows(x, y, z, row_length, column_length, parameters, 0, column_length);
+}
+
+bool is_valid_grid_size(unsigned int row_length, unsigned int column_length) {
+    return row_length >= min_row_length && column_length >= min_column_length
+           && static_cast<unsigned long long>(row_length) * column_length <= max_vertex_count;
+}
+
+bool parse_grid_size(const char *text, unsigned int &row_length, unsigned int &column_length) {
+    unsigned int parsed_row_length;
+    unsigned int parsed_column_length;
+    int parsed_characters = 0;
+    if (std::sscanf(text, "%ux%u%n", &parsed_row_length, &parsed_column_length,
+                    &parsed_characters)
+            != 2
+        || text[parsed_characters] != '\0' || std::strchr(text, '-') != nullptr
+        || !is_valid_grid_size(parsed_row_length, parsed_column_length)) {
+        return false;
+    }
+    row_length = parsed_row_length;
+    column_length = parsed_column_length;
+    return true;
+}
+
+bool parse_count(const char *text, unsigned int &count) {
+    // strtoull would skip leading spaces and wrap a minus sign around
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || parsed > UINT_MAX) {
+        return false;
+    }
+    count = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+bool parse_number(const char *text, float &value) {
+    if (text[0] == '\0' || std::isspace(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char *end = nullptr;
+    float parsed = std::strtof(text, &end);
+    if (*end != '\0' || !std::isfinite(parsed) || parsed < 0) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+void build_start_rows(float *x, float *y, float *z, unsigned int row_length,
+                      unsigned int column_length, const ClothParameters &parameters,
+                      unsigned int y_begin, unsigned int y_end) {
+    for (unsigned int vertex_y = y_begin; vertex_y < y_end; vertex_y++) {
+        for (unsigned int vertex_x = 0; vertex_x < row_length; vertex_x++) {
+            float y_fraction = static_cast<float>(vertex_y) / column_length;
+            float radius =
+                (1 - y_fraction) * parameters.upper_radius + y_fraction * parameters.lower_radius;
+            float angle =
+                std::numbers::pi_v<float> * 2 * static_cast<float>(vertex_x) / row_length;
+            unsigned int vertex_index = (vertex_y - y_begin) * row_length + vertex_x;
+            x[vertex_index] = std::cos(angle) * radius;
+            y[vertex_index] = 0.5f - y_fraction;
+            z[vertex_index] = -std::sin(angle) * radius;
+        }
+    }
+}
+
+ClothSolver::ClothSolver(unsigned int row_length, unsigned int column_length,
+                         const ClothParameters &parameters)
+    : row_length(row_length), column_length(column_length), parameters(parameters) {
+    for (vertex_buffer &buffer : buffers) {
+        buffer.x.resize(get_vertex_count());
+        buffer.y.resize(get_vertex_count());
+        buffer.z.resize(get_vertex_count());
+    }
+    init();
+}
+
+void ClothSolver::init() {
+    vertex_buffer &start = buffers[buffer_indices::start_positions];
+    build_start_positions(start.x.data(), start.y.data(), start.z.data(), row_length,
+                          column_length, parameters);
+
+    constraints = build_grid_constraints(start.x.data(), start.y.data(), start.z.data(), 1,
+                                         row_length, column_length);
+    hierarchy.reset();
+
+    buffers[buffer_indices::first_positions] = start;
+    buffers[buffer_indices::second_positions] = start;
+
+    vertex_buffer &velocity = buffers[buffer_indices::velocities];
+    std::fill(velocity.x.begin(), velocity.x.end(), 0.0f);
+    std::fill(velocity.y.begin(), velocity.y.end(), 0.0f);
+    std::fill(velocity.z.begin(), velocity.z.end(), 0.0f);
+
+    current_buffer = 0;
+    simulated_time = 0;
+    frame_angle = 0;
+    previous_frame_angle = 0;
+    tiled_state = tiles_stale;
+    if (tiled_layout) {
+        build_tiled_stencil_planes();
+    }
+    for (unsigned int i = buffer_indices::first_positions; i < buffer_indices::num; i++) {
+        round_trip_buffer(i);
+    }
+    wake_rows();
+}
+
+float ClothSolver::get_max_stretch() const {
+    const vertex_buffer &positions = get_positions();
+    float stretch = 0;
+    for (unsigned int i = 0; i < get_vertex_count(); i++) {
+        for (unsigned int constraint = constraints.offsets[i];
+             constraint < constraints.offsets[i + 1]; constraint++) {
+            unsigned int other_index = constraints.neighbours[constraint];
+            float diff_x = positions.x[i] - positions.x[other_index];
+            float diff_y = positions.y[i] - positions.y[other_index];
+            float diff_z = positions.z[i] - positions.z[other_index];
+            float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z);
+            if (!std::isfinite(distance)) {
+                return INFINITY;
+            }
+            stretch = std::max(stretch, distance / constraints.rest_lengths[constraint]);
+        }
+    }
+    return stretch;
+}
+
+float ClothSolver::get_flare_radius() const {
+    const vertex_buffer &positions = get_positions();
+    double radius_sum = 0;
+    for (unsigned int x = 0; x < row_length; x++) {
+        unsigned int i = (column_length - 1) * row_length + x;
+        radius_sum += std::sqrt(positions.x[i] * positions.x[i] + positions.z[i] * positions.z[i]);
+    }
+    return radius_sum / row_length;
+}
+
+void ClothSolver::compute_normals(vertex_buffer &normals, bool lab_frame) {
+    const vertex_buffer &positions = get_positions();
+    normals.x.resize(get_vertex_count());
+    normals.y.resize(get_vertex_count());
+    normals.z.resize(get_vertex_count());
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        compute_normal_rows(positions.x.data(), positions.y.data(), positions.z.data(), row_length,
+                            column_length, normals.x.data(), normals.y.data(), normals.z.data(),
+                            y_begin, y_end);
+        if (co_rotating && lab_frame) {
+            rotate_vertices(normals.x.data(), normals.z.data(), y_begin * row_length,
+                            y_end * row_length, frame_angle);
+        }
+    });
+}
+
+void ClothSolver::get_lab_state(vertex_buffer &positions, vertex_buffer &velocities) const {
+    positions = get_positions();
+    velocities = get_velocities();
+    if (!co_rotating) {
+        return;
+    }
+    add_frame_velocity(positions.x.data(), positions.z.data(), velocities.x.data(),
+                       velocities.z.data(), row_length, get_vertex_count(),
+                       parameters.spinning_speed);
+    rotate_vertices(velocities.x.data(), velocities.z.data(), 0, get_vertex_count(),
+                    frame_angle);
+    rotate_vertices(positions.x.data(), positions.z.data(), 0, get_vertex_count(), frame_angle);
+}
+
+void ClothSolver::enter_frame() {
+    edit_rows();
+    vertex_buffer &positions = buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &velocities = buffers[buffer_indices::velocities];
+    // the top row keeps a zero velocity in both frames
+    add_frame_velocity(positions.x.data(), positions.z.data(), velocities.x.data(),
+                       velocities.z.data(), row_length, get_vertex_count(),
+                       -parameters.spinning_speed);
+    frame_angle = 0;
+    previous_frame_angle = 0;
+}
+
+void ClothSolver::set_co_rotating(bool enabled) {
+    if (enabled == co_rotating) {
+        return;
+    }
+    if (enabled) {
+        enter_frame();
+    } else {
+        vertex_buffer positions;
+        vertex_buffer velocities;
+        get_lab_state(positions, velocities);
+        edit_rows();
+        vertex_buffer &previous = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+        rotate_vertices(previous.x.data(), previous.z.data(), 0, get_vertex_count(),
+                        previous_frame_angle);
+        buffers[buffer_indices::first_positions + current_buffer] = std::move(positions);
+        buffers[buffer_indices::velocities] = std::move(velocities);
+        frame_angle = 0;
+        previous_frame_angle = 0;
+    }
+    co_rotating = enabled;
+    set_sleep_speed(sleep_speed);
+}
+
+void ClothSolver::set_sleep_speed(float speed) {
+    sleep_speed = speed;
+    if (co_rotating && sleep_speed > 0) {
+        row_sleep = std::make_unique<RowSleep>(row_length, column_length, sleep_speed,
+                                               default_settle_steps);
+    } else {
+        row_sleep.reset();
+    }
+}
+
+void ClothSolver::set_parameters(const ClothParameters &new_parameters) {
+    if (co_rotating) {
+        edit_rows();
+        // the velocities stay the same in the lab, so they change in the frame that now spins
+        // at another speed
+        vertex_buffer &positions = buffers[buffer_indices::first_positions + current_buffer];
+        vertex_buffer &velocities = buffers[buffer_indices::velocities];
+        add_frame_velocity(positions.x.data(), positions.z.data(), velocities.x.data(),
+                           velocities.z.data(), row_length, get_vertex_count(),
+                           parameters.spinning_speed - new_parameters.spinning_speed);
+    }
+    parameters.spinning_speed = new_parameters.spinning_speed;
+    parameters.spring_strength = new_parameters.spring_strength;
+    parameters.gravity_strength = new_parameters.gravity_strength;
+    wake_rows();
+}
+
+Checkpoint ClothSolver::get_checkpoint() const {
+    sync_rows();
+    Checkpoint checkpoint;
+    checkpoint.row_length = row_length;
+    checkpoint.column_length = column_length;
+    checkpoint.parameters = parameters;
+    checkpoint.simulated_time = simulated_time;
+    checkpoint.current_buffer = current_buffer;
+    for (unsigned int i = 0; i < buffer_indices::num; i++) {
+        std::vector<float> &target = checkpoint.buffers[i];
+        target.insert(target.end(), buffers[i].x.begin(), buffers[i].x.end());
+        target.insert(target.end(), buffers[i].y.begin(), buffers[i].y.end());
+        target.insert(target.end(), buffers[i].z.begin(), buffers[i].z.end());
+    }
+    if (co_rotating) {
+        vertex_buffer positions;
+        vertex_buffer velocities;
+        get_lab_state(positions, velocities);
+        unsigned int vertex_count = get_vertex_count();
+        auto store = [&](unsigned int index, const vertex_buffer &buffer) {
+            std::vector<float> &target = checkpoint.buffers[index];
+            std::copy(buffer.x.begin(), buffer.x.end(), target.begin());
+            std::copy(buffer.y.begin(), buffer.y.end(), target.begin() + vertex_count);
+            std::copy(buffer.z.begin(), buffer.z.end(), target.begin() + 2 * vertex_count);
+        };
+        store(buffer_indices::first_positions + current_buffer, positions);
+        store(buffer_indices::velocities, velocities);
+        std::vector<float> &previous =
+            checkpoint.buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+        rotate_vertices(previous.data(), previous.data() + 2 * vertex_count, 0, vertex_count,
+                        previous_frame_angle);
+    }
+    return checkpoint;
+}
+
+void ClothSolver::restore(const Checkpoint &checkpoint) {
+    if (checkpoint.row_length != row_length || checkpoint.column_length != column_length) {
+        throw std::runtime_error("checkpoint grid " + std::to_string(checkpoint.row_length) + "x"
+                                 + std::to_string(checkpoint.column_length)
+                                 + " does not match the solver grid "
+                                 + std::to_string(row_length) + "x"
+                                 + std::to_string(column_length));
+    }
+    parameters = checkpoint.parameters;
+    simulated_time = checkpoint.simulated_time;
+    current_buffer = checkpoint.current_buffer;
+    for (unsigned int i = 0; i < buffer_indices::num; i++) {
+        const float *source = checkpoint.buffers[i].data();
+        buffers[i].x.assign(source, source + get_vertex_count());
+        buffers[i].y.assign(source + get_vertex_count(), source + 2 * get_vertex_count());
+        buffers[i].z.assign(source + 2 * get_vertex_count(), source + 3 * get_vertex_count());
+    }
+
+    // the start positions may come from other radii
+    const vertex_buffer &start = buffers[buffer_indices::start_positions];
+    constraints = build_grid_constraints(start.x.data(), start.y.data(), start.z.data(), 1,
+                                         row_length, column_length);
+    hierarchy.reset();
+    tiled_state = tiles_stale;
+    if (tiled_layout) {
+        build_tiled_stencil_planes();
+    }
+    for (unsigned int i = buffer_indices::first_positions; i < buffer_indices::num; i++) {
+        round_trip_buffer(i);
+    }
+    if (co_rotating) {
+        enter_frame();
+    }
+    wake_rows();
+}
+
+void ClothSolver::set_state(const vertex_buffer &positions, const vertex_buffer &velocities) {
+    edit_rows();
+    buffers[buffer_indices::first_positions + current_buffer] = positions;
+    buffers[buffer_indices::velocities] = velocities;
+    if (co_rotating) {
+        enter_frame();
+    }
+    wake_rows();
+}
+
+StepContext ClothSolver::make_step_context(float delta_time) {
+    const vertex_buffer &current = buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &next = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    vertex_buffer &velocity = buffers[buffer_indices::velocities];
+
+    StepContext context;
+    context.current_x = current.x.data();
+    context.current_y = current.y.data();
+    context.current_z = current.z.data();
+    context.next_x = next.x.data();
+    context.next_y = next.y.data();
+    context.next_z = next.z.data();
+    context.velocity_x = velocity.x.data();
+    context.velocity_y = velocity.y.data();
+    context.velocity_z = velocity.z.data();
+    context.row_length = row_length;
+    context.column_length = column_length;
+    context.delta_time = delta_time;
+    // the co-rotating frame spins with the top row, which stands still in it
+    context.spinning_speed = co_rotating ? 0 : parameters.spinning_speed;
+    context.spring_strength = parameters.spring_strength;
+    context.gravity_strength = parameters.gravity_strength;
+    set_constraints(context, constraints);
+    return context;
+}
+
+void ClothSolver::set_storage_order(storage_order order, unsigned int tile_width) {
+    sync_rows();
+    storage = order;
+    tiled_state = tiles_stale;
+    if (order == storage_tiled) {
+        tiled_layout = std::make_unique<TiledLayout>(row_length, column_length, tile_width);
+        for (unsigned int i = buffer_indices::first_positions; i < buffer_indices::num; i++) {
+            tiled_buffers[i].x.resize(tiled_layout->get_stored_count());
+            tiled_buffers[i].y.resize(tiled_layout->get_stored_count());
+            tiled_buffers[i].z.resize(tiled_layout->get_stored_count());
+        }
+        build_tiled_stencil_planes();
+    } else {
+        tiled_layout.reset();
+        for (vertex_buffer &buffer : tiled_buffers) {
+            buffer = vertex_buffer();
+        }
+        for (std::vector<float> &plane : tiled_stencil_planes) {
+            plane = std::vector<float>();
+        }
+    }
+    wake_rows();
+}
+
+void ClothSolver::set_state_format(state_format new_format) {
+    format = new_format;
+    for (unsigned int i = buffer_indices::first_positions; i < buffer_indices::num; i++) {
+        round_trip_buffer(i);
+    }
+    wake_rows();
+}
+
+void ClothSolver::round_trip_buffer(unsigned int buffer) {
+    if (!is_state_format_lossy(format)) {
+        return;
+    }
+    edit_rows();
+    vertex_buffer &target = buffers[buffer];
+    round_trip_state(format, target.x.data(), target.y.data(), target.z.data(),
+                     get_vertex_count());
+}
+
+void ClothSolver::build_tiled_stencil_planes() {
+    for (unsigned int direction = 0; direction < ConstraintTable::num_directions; direction++) {
+        tiled_stencil_planes[direction].resize(tiled_layout->get_stored_count());
+        tiled_layout->scatter(constraints.stencil_rest_lengths[direction].data(),
+                              tiled_stencil_planes[direction].data());
+    }
+}
+
+void ClothSolver::sync_rows() const {
+    if (tiled_state != tiles_ahead) {
+        return;
+    }
+    for (unsigned int i = buffer_indices::first_positions; i < buffer_indices::num; i++) {
+        tiled_layout->gather(tiled_buffers[i].x.data(), buffers[i].x.data());
+        tiled_layout->gather(tiled_buffers[i].y.data(), buffers[i].y.data());
+        tiled_layout->gather(tiled_buffers[i].z.data(), buffers[i].z.data());
+    }
+    tiled_state = tiles_in_sync;
+}
+
+StepContext ClothSolver::make_tile_context(unsigned int tile, float delta_time) {
+    StepContext context = make_step_context(delta_time);
+    unsigned int offset = tiled_layout->get_tile_offset(tile);
+    vertex_buffer &current = tiled_buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &next = tiled_buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    vertex_buffer &velocity = tiled_buffers[buffer_indices::velocities];
+    context.current_x = current.x.data() + offset;
+    context.current_y = current.y.data() + offset;
+    context.current_z = current.z.data() + offset;
+    context.next_x = next.x.data() + offset;
+    context.next_y = next.y.data() + offset;
+    context.next_z = next.z.data() + offset;
+    context.velocity_x = velocity.x.data() + offset;
+    context.velocity_y = velocity.y.data() + offset;
+    context.velocity_z = velocity.z.data() + offset;
+    // a tile is a grid of its own, whose halo columns let every column use the stencil
+    context.row_length = tiled_layout->get_stride(tile);
+    context.constraint_offsets = nullptr;
+    context.constraint_neighbours = nullptr;
+    context.constraint_rest_lengths = nullptr;
+    const float *planes[ConstraintTable::num_directions];
+    for (unsigned int direction = 0; direction < ConstraintTable::num_directions; direction++) {
+        planes[direction] = tiled_stencil_planes[direction].data() + offset;
+    }
+    set_stencil_planes(context, planes);
+    return context;
+}
+
+void ClothSolver::set_thread_count(unsigned int thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (thread_count == 1) {
+        thread_pool.reset();
+        band_count = 1;
+        return;
+    }
+    thread_pool = std::make_unique<ThreadPool>(thread_count);
+    // a few bands per thread leave something to steal when the threads run unevenly
+    band_count = std::min(column_length, thread_count * 4);
+}
+
+void ClothSolver::for_each_band(unsigned int row_count,
+                                const std::function<void(unsigned int, unsigned int)> &task) {
+    if (!thread_pool) {
+        task(0, row_count);
+        return;
+    }
+    thread_pool->run(band_count, [&](unsigned int band) {
+        task(row_count * band / band_count, row_count * (band + 1) / band_count);
+    });
+}
+
+void ClothSolver::for_each_awake_run(
+    unsigned int y_begin, unsigned int y_end,
+    const std::function<void(unsigned int, unsigned int)> &task) {
+    RowSleep *sleep = get_active_row_sleep();
+    if (!sleep) {
+        task(y_begin, y_end);
+        return;
+    }
+    unsigned int run_begin = y_begin;
+    for (unsigned int y = y_begin; y <= y_end; y++) {
+        if (y < y_end && sleep->get_state(y) == RowSleep::row_awake) {
+            continue;
+        }
+        if (run_begin < y) {
+            task(run_begin, y);
+        }
+        run_begin = y + 1;
+    }
+}
+
+void ClothSolver::freeze_falling_rows(unsigned int y_begin, unsigned int y_end) {
+    RowSleep *sleep = get_active_row_sleep();
+    if (!sleep) {
+        return;
+    }
+    const vertex_buffer &current = buffers[buffer_indices::first_positions + current_buffer];
+    vertex_buffer &next = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    vertex_buffer &velocity = buffers[buffer_indices::velocities];
+    // the position based step alternates between the next and the projection buffer
+    bool has_projection = projection_buffer.x.size() == get_vertex_count();
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        if (sleep->get_state(y) != RowSleep::row_falling_asleep) {
+            continue;
+        }
+        unsigned int begin = y * row_length;
+        unsigned int end = begin + row_length;
+        std::copy(current.x.begin() + begin, current.x.begin() + end, next.x.begin() + begin);
+        std::copy(current.y.begin() + begin, current.y.begin() + end, next.y.begin() + begin);
+        std::copy(current.z.begin() + begin, current.z.begin() + end, next.z.begin() + begin);
+        if (has_projection) {
+            std::copy(current.x.begin() + begin, current.x.begin() + end,
+                      projection_buffer.x.begin() + begin);
+            std::copy(current.y.begin() + begin, current.y.begin() + end,
+                      projection_buffer.y.begin() + begin);
+            std::copy(current.z.begin() + begin, current.z.begin() + end,
+                      projection_buffer.z.begin() + begin);
+        }
+        std::fill(velocity.x.begin() + begin, velocity.x.begin() + end, 0.0f);
+        std::fill(velocity.y.begin() + begin, velocity.y.begin() + end, 0.0f);
+        std::fill(velocity.z.begin() + begin, velocity.z.begin() + end, 0.0f);
+    }
+}
+
+void ClothSolver::step_explicit(float delta_time) {
+    StepContext context = make_step_context(delta_time);
+    span_kernel span = get_span_kernel(kernel);
+    RowSleep *sleep = get_active_row_sleep();
+
+    // every row only reads the current buffer, so the bands are independent within a step
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        freeze_falling_rows(y_begin, y_end);
+        for_each_awake_run(y_begin, y_end, [&](unsigned int run_begin, unsigned int run_end) {
+            if (co_rotating) {
+                add_frame_forces_rows(context, parameters.spinning_speed, run_begin, run_end);
+            }
+            update_rows(context, span, run_begin, run_end);
+            if (ground_collision) {
+                clamp_rows_to_ground(context, ground_height, run_begin, run_end);
+            }
+        });
+        if (sleep) {
+            sleep->measure_rows(context.velocity_x, context.velocity_y, context.velocity_z,
+                                y_begin, y_end);
+        }
+    });
+}
+
+void ClothSolver::step_tiled(float delta_time) {
+    if (tiled_state == tiles_stale) {
+        // the next buffer is written in full, halos included
+        for (unsigned int i : {buffer_indices::first_positions + current_buffer,
+                               static_cast<unsigned int>(buffer_indices::velocities)}) {
+            tiled_layout->scatter(buffers[i].x.data(), tiled_buffers[i].x.data());
+            tiled_layout->scatter(buffers[i].y.data(), tiled_buffers[i].y.data());
+            tiled_layout->scatter(buffers[i].z.data(), tiled_buffers[i].z.data());
+        }
+        tiled_state = tiles_in_sync;
+    }
+
+    std::vector<StepContext> contexts;
+    for (unsigned int tile = 0; tile < tiled_layout->get_tile_count(); tile++) {
+        contexts.push_back(make_tile_context(tile, delta_time));
+    }
+    vertex_buffer &next = tiled_buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    span_kernel span = get_span_kernel(kernel);
+
+    // a band walks the tiles one after the other, so the three rows a row of a tile reads are
+    // only as wide as the tile
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        for (const StepContext &context : contexts) {
+            if (co_rotating) {
+                add_frame_forces_rows(context, parameters.spinning_speed, y_begin, y_end);
+            }
+            for (unsigned int y = y_begin; y < y_end; y++) {
+                if (y == 0) {
+                    update_top_row(context);
+                } else {
+                    span(context, y, 1, context.row_length - 1);
+                }
+            }
+            if (ground_collision) {
+                clamp_rows_to_ground(context, ground_height, y_begin, y_end);
+            }
+        }
+        // every tile of the band is written, so its halos can be taken over
+        tiled_layout->exchange_halos(next.x.data(), y_begin, y_end);
+        tiled_layout->exchange_halos(next.y.data(), y_begin, y_end);
+        tiled_layout->exchange_halos(next.z.data(), y_begin, y_end);
+    });
+    tiled_state = tiles_ahead;
+}
+
+void ClothSolver::step_position_based(float delta_time) {
+    vertex_buffer &next = buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+    if (projection_buffer.x.size() != get_vertex_count()) {
+        projection_buffer = next;
+    }
+
+    StepContext context = make_step_context(delta_time);
+    RowSleep *sleep = get_active_row_sleep();
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        freeze_falling_rows(y_begin, y_end);
+        for_each_awake_run(y_begin, y_end, [&](unsigned int run_begin, unsigned int run_end) {
+            if (co_rotating) {
+                add_frame_forces_rows(context, parameters.spinning_speed, run_begin, run_end);
+            }
+            predict_rows(context, run_begin, run_end);
+        });
+    });
+
+    // iterations alternate between the next and the projection buffer, one barrier each
+    auto project = [&](unsigned int count) {
+        for (unsigned int iteration = 0; iteration < count; iteration++) {
+            vertex_buffer &source = iteration % 2 == 0 ? next : projection_buffer;
+            vertex_buffer &target = iteration % 2 == 0 ? projection_buffer : next;
+            const float *const source_coordinates[3] = {source.x.data(), source.y.data(),
+                                                        source.z.data()};
+            float *const target_coordinates[3] = {target.x.data(), target.y.data(),
+                                                  target.z.data()};
+            // sleeping rows hold the same positions in both buffers
+            for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+                for_each_awake_run(y_begin, y_end,
+                                   [&](unsigned int run_begin, unsigned int run_end) {
+                                       project_rows(context, source_coordinates,
+                                                    target_coordinates, relaxation, run_begin,
+                                                    run_end);
+                                   });
+            });
+        }
+        if (count % 2 == 1) {
+            std::swap(next, projection_buffer);
+            context = make_step_context(delta_time);
+        }
+    };
+
+    if (level_count > 1 && !hierarchy) {
+        const vertex_buffer &start = buffers[buffer_indices::start_positions];
+        hierarchy = std::make_unique<ClothHierarchy>(start.x.data(), start.y.data(),
+                                                     start.z.data(), row_length, column_length,
+                                                     level_count);
+    }
+    if (!hierarchy) {
+        project(iteration_count);
+    } else {
+        unsigned int pre_count = iteration_count / 2;
+        unsigned int post_count = iteration_count - pre_count;
+        project(pre_count);
+        const float *const fine[3] = {next.x.data(), next.y.data(), next.z.data()};
+        hierarchy->solve_coarse(
+            constraints, fine, relaxation, pre_count, post_count,
+            [&](unsigned int row_count,
+                const std::function<void(unsigned int, unsigned int)> &task) {
+                for_each_band(row_count, task);
+            });
+        // sleeping rows keep their positions, as in the iterations
+        float *const corrected[3] = {next.x.data(), next.y.data(), next.z.data()};
+        for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+            for_each_awake_run(y_begin, y_end, [&](unsigned int run_begin, unsigned int run_end) {
+                hierarchy->correct_rows(corrected, run_begin, run_end);
+            });
+        });
+        project(post_count);
+    }
+
+    // velocity.y /= 10 of the explicit update at its default step of 0.01, spread over time
+    float vertical_damping = std::pow(0.1f, delta_time / 0.01f);
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        for_each_awake_run(y_begin, y_end, [&](unsigned int run_begin, unsigned int run_end) {
+            update_velocity_rows(context, vertical_damping, run_begin, run_end);
+            if (ground_collision) {
+                clamp_rows_to_ground(context, ground_height, run_begin, run_end);
+            }
+        });
+        if (sleep) {
+            sleep->measure_rows(context.velocity_x, context.velocity_y, context.velocity_z,
+                                y_begin, y_end);
+        }
+    });
+}
+
+void ClothSolver::resolve_self_collisions(float delta_time) {
+    StepContext context = make_step_context(delta_time);
+    // the hash has to be complete before any band looks up its neighbours, and every band has
+    // to be resolved before any vertex moves
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        self_collision->hash_rows(context.next_x, context.next_y, context.next_z, y_begin, y_end);
+    });
+    self_collision->update(context.next_x, context.next_y, context.next_z);
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        self_collision->resolve_rows(context.next_x, context.next_y, context.next_z,
+                                     context.velocity_x, context.velocity_y, context.velocity_z,
+                                     y_begin, y_end);
+    });
+    for_each_band([&](unsigned int y_begin, unsigned int y_end) {
+        self_collision->apply_rows(context.next_x, context.next_y, context.next_z,
+                                   context.velocity_x, context.velocity_y, context.velocity_z,
+                                   y_begin, y_end);
+        if (ground_collision) {
+            clamp_rows_to_ground(context, ground_height, y_begin, y_end);
+        }
+    });
+}
+
+void ClothSolver::set_self_collision(bool enabled) {
+    wake_rows();
+    if (!enabled) {
+        self_collision.reset();
+        return;
+    }
+    float shortest_spring =
+        *std::min_element(constraints.rest_lengths.begin(), constraints.rest_lengths.end());
+    self_collision =
+        std::make_unique<SelfCollision>(row_length, column_length, shortest_spring / 2);
+}
+
+void ClothSolver::step(float delta_time) {
+    RowSleep *sleep = get_active_row_sleep();
+    // a cloth entirely at rest holds the same positions in both buffers, so only the frame turns
+    // there; tiles never sleep
+    if (uses_tiles()) {
+        step_tiled(delta_time);
+    } else if (!sleep || !sleep->is_at_rest()) {
+        edit_rows();
+        if (integrator == integrator_position_based) {
+            step_position_based(delta_time);
+        } else {
+            step_explicit(delta_time);
+        }
+        if (self_collision) {
+            resolve_self_collisions(delta_time);
+        }
+        if (sleep) {
+            sleep->update();
+        }
+    }
+    round_trip_buffer(buffer_indices::first_positions + (current_buffer ^ 1));
+    round_trip_buffer(buffer_indices::velocities);
+    current_buffer ^= 1;
+    simulated_time += delta_time;
+    if (co_rotating) {
+        previous_frame_angle = frame_angle;
+        frame_angle = std::fmod(frame_angle + parameters.spinning_speed * delta_time,
+                                2 * std::numbers::pi);
+    }
+}
+
+buffer_distance measure_distance(const ClothSolver::vertex_buffer &buffer,
+                                 const ClothSolver::vertex_buffer &reference) {
+    buffer_distance distance;
+    double squared_sum = 0;
+    for (std::size_t i = 0; i < buffer.x.size(); i++) {
+        float diff_x = buffer.x[i] - reference.x[i];
+        float diff_y = buffer.y[i] - reference.y[i];
+        float diff_z = buffer.z[i] - reference.z[i];
+        float squared = diff_x * diff_x + diff_y * diff_y + diff_z * diff_z;
+        distance.max = std::max(distance.max, std::sqrt(squared));
+        squared_sum += squared;
+    }
+    if (!buffer.x.empty()) {
+        distance.rms = std::sqrt(squared_sum / buffer.x.size());
+    }
+    return distance;
+}
@@ -0,0 +1,407 @@
+#pragma once
+#include "Checkpoint.hpp"
+#include "ClothHierarchy.hpp"
+#include "ClothKernels.hpp"
+#include "ClothMesh.hpp"
+#include "ClothParameters.hpp"
+#include "CoRotatingFrame.hpp"
+#include "Collision.hpp"
+#include "ConstraintTable.hpp"
+#include "PositionBasedKernels.hpp"
+#include "StateFormat.hpp"
+#include "ThreadPool.hpp"
+#include "TiledLayout.hpp"
+#include "constants.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// the undisturbed cone every run starts from, on the cpu and, through Painter::init_buffers,
+// on the gpu
+void build_start_positions(float *x, float *y, float *z, unsigned int row_length,
+                           unsigned int column_length, const ClothParameters &parameters);
+
+// rows [y_begin, y_end) of the same cone, written from x[0] on, e.g. for one slab of it
+void build_start_rows(float *x, float *y, float *z, unsigned int row_length,
+                      unsigned int column_length, const ClothParameters &parameters,
+                      unsigned int y_begin, unsigned int y_end);
+
+bool is_valid_grid_size(unsigned int row_length, unsigned int column_length);
+
+// reads <row length>x<column length>, e.g. 60x40, as the command lines take it; false on
+// anything else, trailing characters included, and on a grid that is not valid
+bool parse_grid_size(const char *text, unsigned int &row_length, unsigned int &column_length);
+
+// the whole text as a count of the command lines; false on signs, trailing characters and
+// counts past unsigned int
+bool parse_count(const char *text, unsigned int &count);
+
+// the whole text as a finite value that is not negative; false on anything else
+bool parse_number(const char *text, float &value);
+
+enum integrator_type { integrator_explicit, integrator_position_based, num_integrator_types };
+
+// cpu implementation of the spring update from vertex_shader.hpp, working on
+// structure-of-arrays buffers and not depending on any graphics library
+class ClothSolver {
+    public:
+        struct vertex_buffer {
+            public:
+                std::vector<float> x;
+                std::vector<float> y;
+                std::vector<float> z;
+        };
+
+    private:
+        unsigned int row_length;
+        unsigned int column_length;
+        ClothParameters parameters;
+
+        enum buffer_indices { start_positions, first_positions, second_positions, velocities, num };
+
+        // in tiled storage the state is stepped in the tiled buffers below, and these are a copy
+        // brought up to date whenever they are read
+        mutable vertex_buffer buffers[buffer_indices::num];
+        unsigned int current_buffer = 0;
+        double simulated_time = 0;
+
+        // compiled from the start positions by init
+        ConstraintTable constraints;
+
+        kernel_type kernel = best_kernel_type();
+
+        integrator_type integrator = integrator_explicit;
+        unsigned int iteration_count = 10;
+        float relaxation = 1.5f;
+        // target of every other position based iteration, sized on first use
+        vertex_buffer projection_buffer;
+        // levels of the position based v-cycle, 1 for plain iterations on the fine grid
+        unsigned int level_count = 1;
+        // built from the start positions on first use while level_count is above 1
+        std::unique_ptr<ClothHierarchy> hierarchy;
+
+        // vertices that fell through the ground are put back onto it, as in the shader
+        bool ground_collision = true;
+        // created by set_self_collision
+        std::unique_ptr<SelfCollision> self_collision;
+
+        // the state is kept in the frame spinning with the top row, see set_co_rotating
+        bool co_rotating = false;
+        // how far that frame has turned since it was entered, now and one step before
+        double frame_angle = 0;
+        double previous_frame_angle = 0;
+        // rows slower than this in the co-rotating frame stop being stepped, 0 keeps them awake
+        float sleep_speed = default_sleep_speed;
+        // created while co-rotating with a sleep speed above 0
+        std::unique_ptr<RowSleep> row_sleep;
+
+        storage_order storage = storage_row_major;
+        // created by set_storage_order
+        std::unique_ptr<TiledLayout> tiled_layout;
+        // both position buffers and the velocities, and the stencil planes, in tiled order
+        vertex_buffer tiled_buffers[buffer_indices::num];
+        std::vector<float> tiled_stencil_planes[ConstraintTable::num_directions];
+        // which of the two copies of the state holds the last step
+        enum copy_states { tiles_stale, tiles_in_sync, tiles_ahead };
+        mutable copy_states tiled_state = tiles_stale;
+
+        // the state is rounded after every step as the painter would store it in this format
+        state_format format = state_format_float4;
+
+        // rows are stepped in bands on the pool when more than one thread is requested
+        std::unique_ptr<ThreadPool> thread_pool;
+        unsigned int band_count = 1;
+
+        StepContext make_step_context(float delta_time);
+
+        // runs task(y_begin, y_end) over bands of rows, on the pool if there is one
+        void for_each_band(const std::function<void(unsigned int, unsigned int)> &task) {
+            for_each_band(column_length, task);
+        }
+        // the same over [0, row_count), e.g. the rows of a coarse level
+        void for_each_band(unsigned int row_count,
+                           const std::function<void(unsigned int, unsigned int)> &task);
+
+        // the sleep tracker, or null while every row has to be stepped; self-collision can move
+        // any vertex, and rounding the state moves a row whenever its tile changes, so both keep
+        // every row awake
+        RowSleep *get_active_row_sleep() {
+            return self_collision || uses_tiles() || is_state_format_lossy(format)
+                       ? nullptr
+                       : row_sleep.get();
+        }
+
+        // only the explicit update without self-collision runs on the stencil alone, so only it
+        // is stepped in tiles; everything else reads the springs from the compressed rows
+        bool uses_tiles() const {
+            return storage == storage_tiled && integrator == integrator_explicit
+                   && !self_collision;
+        }
+
+        // copies the state of the last tiled step back into the row-major buffers
+        void sync_rows() const;
+        // the same before the row-major buffers are changed, which leaves the tiles stale
+        void edit_rows() {
+            sync_rows();
+            tiled_state = tiles_stale;
+        }
+        void build_tiled_stencil_planes();
+
+        // rounds the buffer as the state format stores it; the tiles are left stale
+        void round_trip_buffer(unsigned int buffer);
+        StepContext make_tile_context(unsigned int tile, float delta_time);
+
+        void wake_rows() {
+            if (row_sleep) {
+                row_sleep->wake_all();
+            }
+        }
+
+        // runs task(run_begin, run_end) over the runs of awake rows within [y_begin, y_end)
+        void for_each_awake_run(unsigned int y_begin, unsigned int y_end,
+                                const std::function<void(unsigned int, unsigned int)> &task);
+        // copies the rows of [y_begin, y_end) that fell asleep into every buffer the step writes
+        // and stops them
+        void freeze_falling_rows(unsigned int y_begin, unsigned int y_end);
+
+        // takes the current state from the lab into a co-rotating frame that starts at angle 0
+        void enter_frame();
+
+        void step_explicit(float delta_time);
+        void step_tiled(float delta_time);
+        void step_position_based(float delta_time);
+        void resolve_self_collisions(float delta_time);
+
+    public:
+        ClothSolver(unsigned int row_length = default_row_length,
+                    unsigned int column_length = default_column_length,
+                    const ClothParameters &parameters = {});
+
+        // builds the undisturbed cone with zero velocities, like Painter::init_buffers
+        void init();
+
+        void step(float delta_time);
+
+        // replaces the current positions and velocities, given in the lab frame
+        void set_state(const vertex_buffer &positions, const vertex_buffer &velocities);
+
+        kernel_type get_kernel() const {
+            return kernel;
+        }
+
+        // falls back to the scalar kernel if the cpu lacks the requested instructions
+        void set_kernel(kernel_type type) {
+            kernel = is_kernel_supported(type) ? type : kernel_scalar;
+        }
+
+        integrator_type get_integrator() const {
+            return integrator;
+        }
+
+        // the explicit integrator mirrors the shader; the position based one stays stable at
+        // much larger delta times
+        void set_integrator(integrator_type type) {
+            integrator = type;
+            wake_rows();
+        }
+
+        unsigned int get_iteration_count() const {
+            return iteration_count;
+        }
+
+        // constraint iterations per position based step
+        void set_iteration_count(unsigned int count) {
+            iteration_count = count;
+        }
+
+        unsigned int get_level_count() const {
+            return level_count;
+        }
+
+        // levels of the grid a position based step runs a v-cycle over, see ClothHierarchy: half
+        // the iterations on the fine grid, the same on every coarser level on the way down and
+        // back up, then the other half on the fine grid; 1 iterates on the fine grid alone, and
+        // small grids stop at fewer levels
+        void set_level_count(unsigned int count) {
+            level_count = std::max(1u, count);
+            hierarchy.reset();
+        }
+
+        // the levels actually built, null until the first position based step with more than one
+        const ClothHierarchy *get_hierarchy() const {
+            return hierarchy.get();
+        }
+
+        bool get_ground_collision() const {
+            return ground_collision;
+        }
+
+        void set_ground_collision(bool enabled) {
+            ground_collision = enabled;
+            wake_rows();
+        }
+
+        // pushes apart vertices that are not neighbours on the grid but come closer than half
+        // the shortest spring, so the cloth does not pass through itself; only on the cpu
+        void set_self_collision(bool enabled);
+
+        // null while self-collision is off
+        const SelfCollision *get_self_collision() const {
+            return self_collision.get();
+        }
+
+        bool is_co_rotating() const {
+            return co_rotating;
+        }
+
+        // simulates in the frame spinning with the top row, with the centrifugal and coriolis
+        // accelerations added; the top row stands still there and the cloth comes to rest, so
+        // its rows can fall asleep; the positions and velocities are then those seen from the
+        // frame, get_frame_angle turns them back, and the state is converted on every switch
+        void set_co_rotating(bool enabled);
+
+        // the angle get_positions has to be turned by around the y axis, in the direction the
+        // top row spins, to get the positions in the lab; 0 while not co-rotating
+        float get_frame_angle() const {
+            return frame_angle;
+        }
+
+        // the same for get_previous_positions
+        float get_previous_frame_angle() const {
+            return previous_frame_angle;
+        }
+
+        float get_sleep_speed() const {
+            return sleep_speed;
+        }
+
+        // rows whose vertices all stayed slower than this for a while, along with their
+        // neighbours, are no longer stepped until a neighbour moves again; 0 keeps every row
+        // awake
+        void set_sleep_speed(float speed);
+
+        // rows not stepped at the moment
+        unsigned int get_sleeping_row_count() const {
+            return row_sleep ? row_sleep->get_sleeping_row_count() : 0;
+        }
+
+        // every row asleep, so steps only turn the frame and leave the positions alone
+        bool is_at_rest() const {
+            return row_sleep && !self_collision && !uses_tiles() && !is_state_format_lossy(format)
+                   && row_sleep->is_at_rest();
+        }
+
+        storage_order get_storage_order() const {
+            return storage;
+        }
+
+        // tiled storage steps the explicit update tile by tile, see TiledLayout, with the same
+        // results as the row-major order; the getters below still return row-major buffers,
+        // copied from the tiles when they are read after a step
+        void set_storage_order(storage_order order, unsigned int tile_width = default_tile_width);
+
+        // null in row-major storage
+        const TiledLayout *get_tiled_layout() const {
+            return tiled_layout.get();
+        }
+
+        state_format get_state_format() const {
+            return format;
+        }
+
+        // rounds the state after init, restore and every step as the painter stores it in the
+        // format, to measure the error of a format against float4 or to mirror a painter that
+        // uses it; the step itself stays in float, and set_state takes the state as it is
+        void set_state_format(state_format new_format);
+
+        unsigned int get_thread_count() const {
+            return thread_pool ? thread_pool->get_thread_count() : 1;
+        }
+
+        // 0 uses every hardware thread
+        void set_thread_count(unsigned int thread_count);
+
+        unsigned int get_row_length() const {
+            return row_length;
+        }
+
+        unsigned int get_column_length() const {
+            return column_length;
+        }
+
+        unsigned int get_vertex_count() const {
+            return row_length * column_length;
+        }
+
+        const ClothParameters &get_parameters() const {
+            return parameters;
+        }
+
+        // changes the spinning speed, spring strength and gravity strength from the next step
+        // on and wakes every row; the radii only shape the cloth built by init
+        void set_parameters(const ClothParameters &new_parameters);
+
+        // sum of the delta times of all steps since init
+        double get_simulated_time() const {
+            return simulated_time;
+        }
+
+        // largest ratio of spring length to rest length, or infinity once a position is not
+        // finite
+        float get_max_stretch() const;
+
+        // mean distance of the bottom row from the axis of rotation
+        float get_flare_radius() const;
+
+        // the vertex normals of the current positions, as the normal pass of the painter
+        // computes them for drawing, in the lab frame, or while co-rotating also in the frame
+        // get_positions is in
+        void compute_normals(vertex_buffer &normals, bool lab_frame = true);
+
+        // the current positions and velocities in the lab frame, also while co-rotating
+        void get_lab_state(vertex_buffer &positions, vertex_buffer &velocities) const;
+
+        // in the lab frame, also while co-rotating
+        Checkpoint get_checkpoint() const;
+
+        // continues from the checkpoint, including its parameters; throws if its grid size is
+        // not the one of the solver
+        void restore(const Checkpoint &checkpoint);
+
+        const vertex_buffer &get_start_positions() const {
+            return buffers[buffer_indices::start_positions];
+        }
+
+        const vertex_buffer &get_positions() const {
+            sync_rows();
+            return buffers[buffer_indices::first_positions + current_buffer];
+        }
+
+        const ConstraintTable &get_constraints() const {
+            return constraints;
+        }
+
+        // the positions one step before the current ones
+        const vertex_buffer &get_previous_positions() const {
+            sync_rows();
+            return buffers[buffer_indices::first_positions + (current_buffer ^ 1)];
+        }
+
+        const vertex_buffer &get_velocities() const {
+            sync_rows();
+            return buffers[buffer_indices::velocities];
+        }
+};
+
+// largest and root mean square distance between the matching vertices of two buffers of the
+// same size, e.g. to measure the error of a state format against float4
+struct buffer_distance {
+    public:
+        float max = 0;
+        float rms = 0;
+};
+
+buffer_distance measure_distance(const ClothSolver::vertex_buffer &buffer,
+                                 const ClothSolver::vertex_buffer &reference);
@@ -0,0 +1,112 @@
+#include "CoRotatingFrame.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void rotate_vertices(float *x, float *z, unsigned int begin, unsigned int end, float angle) {
+    float cs = std::cos(angle);
+    float sn = std::sin(angle);
+    for (unsigned int i = begin; i < end; i++) {
+        float rotated_x = cs * x[i] + sn * z[i];
+        z[i] = -sn * x[i] + cs * z[i];
+        x[i] = rotated_x;
+    }
+}
+
+void add_frame_velocity(const float *x, const float *z, float *velocity_x, float *velocity_z,
+                        unsigned int begin, unsigned int end, float spinning_speed) {
+    // cross((0, spinning_speed, 0), position)
+    for (unsigned int i = begin; i < end; i++) {
+        velocity_x[i] += spinning_speed * z[i];
+        velocity_z[i] -= spinning_speed * x[i];
+    }
+}
+
+void add_frame_forces_rows(const StepContext &context, float spinning_speed,
+                           unsigned int y_begin, unsigned int y_end) {
+    float centrifugal = spinning_speed * spinning_speed * context.delta_time;
+    // the coriolis acceleration -2 cross(spin, velocity) only turns the velocity, so it is
+    // applied as an exact turn, which unlike an euler step does not add energy
+    float coriolis_angle = 2 * spinning_speed * context.delta_time;
+    float cs = std::cos(coriolis_angle);
+    float sn = std::sin(coriolis_angle);
+    for (unsigned int i = std::max(y_begin, 1u) * context.row_length;
+         i < y_end * context.row_length; i++) {
+        float velocity_x = context.velocity_x[i] + centrifugal * context.current_x[i];
+        float velocity_z = context.velocity_z[i] + centrifugal * context.current_z[i];
+        context.velocity_x[i] = cs * velocity_x - sn * velocity_z;
+        context.velocity_z[i] = sn * velocity_x + cs * velocity_z;
+    }
+}
+
+RowSleep::RowSleep(unsigned int row_length, unsigned int column_length, float sleep_speed,
+                   unsigned int settle_steps)
+    : row_length(row_length), column_length(column_length), sleep_speed(sleep_speed),
+      settle_steps(settle_steps) {
+    states.assign(column_length, row_awake);
+    row_speeds.assign(column_length, 0.0f);
+    calm_steps.assign(column_length, 0);
+}
+
+void RowSleep::measure_rows(const float *velocity_x, const float *velocity_y,
+                            const float *velocity_z, unsigned int y_begin, unsigned int y_end) {
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        if (states[y] != row_awake) {
+            continue;
+        }
+        float speed_squared = 0;
+        for (unsigned int i = y * row_length; i < (y + 1) * row_length; i++) {
+            speed_squared =
+                std::max(speed_squared, velocity_x[i] * velocity_x[i]
+                                            + velocity_y[i] * velocity_y[i]
+                                            + velocity_z[i] * velocity_z[i]);
+        }
+        row_speeds[y] = speed_squared;
+    }
+}
+
+void RowSleep::update() {
+    for (unsigned int y = 0; y < column_length; y++) {
+        if (states[y] == row_awake) {
+            calm_steps[y] = row_speeds[y] < sleep_speed * sleep_speed ? calm_steps[y] + 1 : 0;
+        }
+    }
+
+    // every row decides from the states its neighbours had before this update
+    bool above_calm = true;
+    bool above_moving = false;
+    sleeping_row_count = 0;
+    asleep_row_count = 0;
+    for (unsigned int y = 0; y < column_length; y++) {
+        unsigned char state = states[y];
+        bool calm = is_calm(y);
+        bool moving = state == row_awake && calm_steps[y] == 0;
+        bool below_calm = y + 1 == column_length || is_calm(y + 1);
+        bool below_moving =
+            y + 1 < column_length && states[y + 1] == row_awake && calm_steps[y + 1] == 0;
+
+        if (state == row_awake) {
+            if (calm && above_calm && below_calm) {
+                states[y] = row_falling_asleep;
+            }
+        } else if (above_moving || below_moving) {
+            // whatever it copied while falling asleep is in both buffers, so it can go on
+            states[y] = row_awake;
+            calm_steps[y] = 0;
+        } else {
+            states[y] = row_asleep;
+        }
+        sleeping_row_count += states[y] != row_awake;
+        asleep_row_count += states[y] == row_asleep;
+
+        above_calm = calm;
+        above_moving = moving;
+    }
+}
+
+void RowSleep::wake_all() {
+    std::fill(states.begin(), states.end(), row_awake);
+    std::fill(calm_steps.begin(), calm_steps.end(), 0);
+    sleeping_row_count = 0;
+    asleep_row_count = 0;
+}
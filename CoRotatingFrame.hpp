@@ -0,0 +1,89 @@
+#pragma once
+#include "ClothKernels.hpp"
+
+#include <vector>
+
+// the top row spins at a constant speed around the y axis, so in a frame spinning with it the
+// top row stands still and the rest of the cloth comes to rest; there, the springs and gravity
+// are joined by the centrifugal and coriolis accelerations
+
+// rows slower than this, in units per second, count as at rest, and have to stay so for this
+// many steps before they fall asleep
+constexpr float default_sleep_speed = 1e-3f;
+constexpr unsigned int default_settle_steps = 50;
+
+// turns x and z of vertices [begin, end) by angle around the y axis, in the direction
+// update_top_row turns the top row
+void rotate_vertices(float *x, float *z, unsigned int begin, unsigned int end, float angle);
+
+// adds the velocity a point at rest in a frame spinning at spinning_speed has, to the velocities
+// of vertices [begin, end); a negative speed takes it away again
+void add_frame_velocity(const float *x, const float *z, float *velocity_x, float *velocity_z,
+                        unsigned int begin, unsigned int end, float spinning_speed);
+
+// applies the centrifugal and coriolis accelerations of a frame spinning at spinning_speed over
+// one step to the velocities of rows [y_begin, y_end); the top row is skipped as it never moves
+void add_frame_forces_rows(const StepContext &context, float spinning_speed,
+                           unsigned int y_begin, unsigned int y_end);
+
+// decides which rows of a cloth in the co-rotating frame have come to rest and no longer need
+// to be stepped; a row falls asleep once it and both its neighbours stayed slower than the sleep
+// speed for settle_steps steps, and wakes as soon as a neighbour moves faster than that again
+//
+// a step runs measure_rows over every band of awake rows, then update; only update is serial
+class RowSleep {
+    public:
+        enum row_state { row_awake, row_falling_asleep, row_asleep };
+
+    private:
+        unsigned int row_length;
+        unsigned int column_length;
+        float sleep_speed;
+        unsigned int settle_steps;
+
+        std::vector<unsigned char> states;
+        // largest squared speed of every row in the last step
+        std::vector<float> row_speeds;
+        // steps in a row every row stayed slower than the sleep speed
+        std::vector<unsigned int> calm_steps;
+        unsigned int sleeping_row_count = 0;
+        unsigned int asleep_row_count = 0;
+
+        bool is_calm(unsigned int y) const {
+            return states[y] != row_awake || calm_steps[y] >= settle_steps;
+        }
+
+    public:
+        RowSleep(unsigned int row_length, unsigned int column_length, float sleep_speed,
+                 unsigned int settle_steps);
+
+        // a row falling asleep still has to be frozen by the step, which copies it into the next
+        // buffer and stops it; after that both position buffers hold it and it is skipped
+        row_state get_state(unsigned int y) const {
+            return static_cast<row_state>(states[y]);
+        }
+
+        // records the speeds of the awake rows among [y_begin, y_end)
+        void measure_rows(const float *velocity_x, const float *velocity_y,
+                          const float *velocity_z, unsigned int y_begin, unsigned int y_end);
+
+        // moves the rows between the states after a step
+        void update();
+
+        // e.g. after the parameters or the state changed
+        void wake_all();
+
+        // asleep or falling asleep
+        unsigned int get_sleeping_row_count() const {
+            return sleeping_row_count;
+        }
+
+        // every row asleep, so a step would not change anything
+        bool is_at_rest() const {
+            return asleep_row_count == column_length;
+        }
+
+        float get_sleep_speed() const {
+            return sleep_speed;
+        }
+};
@@ -0,0 +1,212 @@
+#include "Collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// cell coordinate along one axis; positions of a cloth that blew up land in cell 0
+int cell_coordinate(float position, float inverse_cell_size) {
+    float scaled = position * inverse_cell_size;
+    if (!(std::abs(scaled) < 1e8f)) {
+        return 0;
+    }
+    // rounds towards minus infinity without the libm call std::floor turns into
+    int cell = static_cast<int>(scaled);
+    return cell - (scaled < cell);
+}
+
+// first of the two cells along one axis that hold everything within half a cell of the
+// position: its own cell and the neighbour on the nearer side
+int lower_cell_coordinate(float position, float inverse_cell_size) {
+    return cell_coordinate(position * inverse_cell_size - 0.5f, 1);
+}
+} // namespace
+
+void clamp_rows_to_ground(const StepContext &context, float ground_height, unsigned int y_begin,
+                          unsigned int y_end) {
+    for (unsigned int i = y_begin * context.row_length; i < y_end * context.row_length; i++) {
+        if (context.next_y[i] < ground_height) {
+            context.next_y[i] = ground_height;
+            context.velocity_y[i] = std::max(context.velocity_y[i], 0.0f);
+        }
+    }
+}
+
+SelfCollision::SelfCollision(unsigned int row_length, unsigned int column_length,
+                             float thickness)
+    : row_length(row_length), column_length(column_length), thickness(thickness) {
+    unsigned int vertex_count = row_length * column_length;
+    // about two buckets per vertex keeps the chains short
+    unsigned int bucket_count = 1;
+    while (bucket_count < 2 * vertex_count) {
+        bucket_count *= 2;
+    }
+    bucket_mask = bucket_count - 1;
+
+    vertex_buckets.assign(vertex_count, 0);
+    next_vertex_buckets.assign(vertex_count, 0);
+    bucket_counts.assign(bucket_count, 0);
+    bucket_starts.assign(bucket_count + 1, 0);
+    sorted_vertices.assign(vertex_count, 0);
+    for (std::vector<float> &positions : sorted_positions) {
+        positions.assign(vertex_count, 0.0f);
+    }
+    for (std::vector<float> &correction : corrections) {
+        correction.assign(vertex_count, 0.0f);
+    }
+}
+
+unsigned int SelfCollision::bucket_term(int cell, unsigned int axis) {
+    const unsigned int primes[3] = {73856093u, 19349663u, 83492791u};
+    return static_cast<unsigned int>(cell) * primes[axis];
+}
+
+void SelfCollision::hash_rows(const float *x, const float *y, const float *z,
+                              unsigned int y_begin, unsigned int y_end) {
+    float inverse_cell_size = 1 / (2 * thickness);
+    for (unsigned int i = y_begin * row_length; i < y_end * row_length; i++) {
+        next_vertex_buckets[i] = (bucket_term(cell_coordinate(x[i], inverse_cell_size), 0)
+                                  ^ bucket_term(cell_coordinate(y[i], inverse_cell_size), 1)
+                                  ^ bucket_term(cell_coordinate(z[i], inverse_cell_size), 2))
+                                 & bucket_mask;
+    }
+}
+
+void SelfCollision::update(const float *x, const float *y, const float *z) {
+    unsigned int vertex_count = row_length * column_length;
+    moved_vertex_count = 0;
+    contact_count = 0;
+    if (!built) {
+        moved_vertex_count = vertex_count;
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            bucket_counts[next_vertex_buckets[i]]++;
+        }
+        vertex_buckets = next_vertex_buckets;
+        built = true;
+    } else {
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            if (next_vertex_buckets[i] != vertex_buckets[i]) {
+                bucket_counts[vertex_buckets[i]]--;
+                bucket_counts[next_vertex_buckets[i]]++;
+                vertex_buckets[i] = next_vertex_buckets[i];
+                moved_vertex_count++;
+            }
+        }
+    }
+
+    // a cloth that kept all its vertices in their buckets keeps its table
+    if (moved_vertex_count > 0) {
+        // every entry starts out at the end of its bucket
+        unsigned int end = 0;
+        for (unsigned int b = 0; b <= bucket_mask; b++) {
+            end += bucket_counts[b];
+            bucket_starts[b] = end;
+        }
+        bucket_starts[bucket_mask + 1] = end;
+
+        // filled from the back of every bucket, which leaves each entry at the start of its
+        // bucket
+        for (unsigned int i = vertex_count; i-- > 0;) {
+            sorted_vertices[--bucket_starts[vertex_buckets[i]]] = i;
+        }
+    }
+
+    for (unsigned int k = 0; k < vertex_count; k++) {
+        sorted_positions[0][k] = x[sorted_vertices[k]];
+        sorted_positions[1][k] = y[sorted_vertices[k]];
+        sorted_positions[2][k] = z[sorted_vertices[k]];
+    }
+}
+
+void SelfCollision::resolve_rows(const float *x, const float *y, const float *z,
+                                 const float *velocity_x, const float *velocity_y,
+                                 const float *velocity_z, unsigned int y_begin,
+                                 unsigned int y_end) {
+    float inverse_cell_size = 1 / (2 * thickness);
+    unsigned int band_contacts = 0;
+    for (unsigned int vertex_y = std::max(y_begin, 1u); vertex_y < y_end; vertex_y++) {
+        for (unsigned int vertex_x = 0; vertex_x < row_length; vertex_x++) {
+            unsigned int i = vertex_y * row_length + vertex_x;
+            float correction[6] = {0, 0, 0, 0, 0, 0};
+
+            int cell_x = lower_cell_coordinate(x[i], inverse_cell_size);
+            int cell_y = lower_cell_coordinate(y[i], inverse_cell_size);
+            int cell_z = lower_cell_coordinate(z[i], inverse_cell_size);
+            // two of the cells may share a bucket, which must not be visited twice
+            unsigned int visited_buckets[8];
+            unsigned int visited_count = 0;
+            for (int delta_z = 0; delta_z <= 1; delta_z++) {
+                unsigned int term_z = bucket_term(cell_z + delta_z, 2);
+                for (int delta_y = 0; delta_y <= 1; delta_y++) {
+                    unsigned int term_yz = term_z ^ bucket_term(cell_y + delta_y, 1);
+                    for (int delta_x = 0; delta_x <= 1; delta_x++) {
+                        unsigned int b =
+                            (term_yz ^ bucket_term(cell_x + delta_x, 0)) & bucket_mask;
+                        if (std::find(visited_buckets, visited_buckets + visited_count, b)
+                            != visited_buckets + visited_count) {
+                            continue;
+                        }
+                        visited_buckets[visited_count++] = b;
+
+                        for (unsigned int k = bucket_starts[b]; k < bucket_starts[b + 1]; k++) {
+                            float diff_x = x[i] - sorted_positions[0][k];
+                            float diff_y = y[i] - sorted_positions[1][k];
+                            float diff_z = z[i] - sorted_positions[2][k];
+                            float distance_squared =
+                                diff_x * diff_x + diff_y * diff_y + diff_z * diff_z;
+                            if (distance_squared >= thickness * thickness
+                                || distance_squared == 0) {
+                                continue;
+                            }
+
+                            // springs already keep the grid neighbours apart; checked after the
+                            // distance, as most candidates are too far anyway
+                            unsigned int j = sorted_vertices[k];
+                            unsigned int other_x = j % row_length;
+                            unsigned int other_y = j / row_length;
+                            unsigned int distance_x = vertex_x > other_x ? vertex_x - other_x
+                                                                         : other_x - vertex_x;
+                            distance_x = std::min(distance_x, row_length - distance_x);
+                            if (distance_x <= 1 && other_y + 1 >= vertex_y
+                                && other_y <= vertex_y + 1) {
+                                continue;
+                            }
+                            band_contacts++;
+
+                            // each of the two takes half of the overlap
+                            float distance = std::sqrt(distance_squared);
+                            float normal[3] = {diff_x / distance, diff_y / distance,
+                                               diff_z / distance};
+                            float push = (thickness - distance) / 2;
+                            // and loses half of the speed at which they approach
+                            float approach = (velocity_x[i] - velocity_x[j]) * normal[0]
+                                             + (velocity_y[i] - velocity_y[j]) * normal[1]
+                                             + (velocity_z[i] - velocity_z[j]) * normal[2];
+                            float brake = std::min(approach, 0.0f) / 2;
+                            for (unsigned int axis = 0; axis < 3; axis++) {
+                                correction[axis] += normal[axis] * push;
+                                correction[3 + axis] -= normal[axis] * brake;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for (unsigned int k = 0; k < 6; k++) {
+                corrections[k][i] = correction[k];
+            }
+        }
+    }
+    contact_count += band_contacts;
+}
+
+void SelfCollision::apply_rows(float *x, float *y, float *z, float *velocity_x,
+                               float *velocity_y, float *velocity_z, unsigned int y_begin,
+                               unsigned int y_end) {
+    float *const targets[6] = {x, y, z, velocity_x, velocity_y, velocity_z};
+    for (unsigned int k = 0; k < 6; k++) {
+        for (unsigned int i = std::max(y_begin, 1u) * row_length; i < y_end * row_length; i++) {
+            targets[k][i] += corrections[k][i];
+        }
+    }
+}
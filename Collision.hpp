@@ -0,0 +1,83 @@
+#pragma once
+#include "ClothKernels.hpp"
+
+#include <atomic>
+#include <vector>
+
+// moves the vertices of rows [y_begin, y_end) that fell through the ground plane back onto it
+// and stops their fall, the same way simulation_shader.hpp does
+void clamp_rows_to_ground(const StepContext &context, float ground_height, unsigned int y_begin,
+                          unsigned int y_end);
+
+// pushes apart vertices that came closer than the thickness without being neighbours on the
+// grid; the vertices are found through a uniform spatial hash with cells of twice the thickness,
+// so a vertex only looks at the 2x2x2 cells nearest to it and the cost stays linear in the
+// vertex count
+//
+// a step runs hash_rows over every band, then update, then resolve_rows and apply_rows over
+// every band; only update is serial, and it is not incremental: it re-sorts the whole table
+// whenever a vertex changed bucket and copies every position into bucket order, both linear
+// in the vertex count but a small part of the step next to the bucket lookups of resolve_rows
+class SelfCollision {
+    private:
+        unsigned int row_length;
+        unsigned int column_length;
+        float thickness;
+        unsigned int bucket_mask;
+
+        // bucket of every vertex as of the last update, and as hashed for the current one
+        std::vector<unsigned int> vertex_buckets;
+        std::vector<unsigned int> next_vertex_buckets;
+        // vertices per bucket, kept up to date by only moving the vertices that changed bucket
+        std::vector<unsigned int> bucket_counts;
+        // the vertices of bucket b are sorted_vertices[bucket_starts[b], bucket_starts[b + 1])
+        std::vector<unsigned int> bucket_starts;
+        std::vector<unsigned int> sorted_vertices;
+        // their positions in the same order, so the candidates of a bucket are read in one go
+        std::vector<float> sorted_positions[3];
+        bool built = false;
+
+        // position and velocity changes collected by resolve_rows, so no vertex is moved while
+        // another band still reads it
+        std::vector<float> corrections[6];
+
+        unsigned int moved_vertex_count = 0;
+        std::atomic<unsigned int> contact_count = 0;
+
+        // the hash of a cell is the masked xor of one term per axis
+        static unsigned int bucket_term(int cell, unsigned int axis);
+
+    public:
+        SelfCollision(unsigned int row_length, unsigned int column_length, float thickness);
+
+        float get_thickness() const {
+            return thickness;
+        }
+
+        // hashes the vertices of rows [y_begin, y_end)
+        void hash_rows(const float *x, const float *y, const float *z, unsigned int y_begin,
+                       unsigned int y_end);
+
+        // updates the counts of the vertices that changed bucket, sorts the whole table again if
+        // any did and copies the positions into it; the positions have to be the hashed ones
+        void update(const float *x, const float *y, const float *z);
+
+        // collects the corrections of the vertices of rows [y_begin, y_end); the top row is
+        // pinned and never moved
+        void resolve_rows(const float *x, const float *y, const float *z, const float *velocity_x,
+                          const float *velocity_y, const float *velocity_z, unsigned int y_begin,
+                          unsigned int y_end);
+
+        void apply_rows(float *x, float *y, float *z, float *velocity_x, float *velocity_y,
+                        float *velocity_z, unsigned int y_begin, unsigned int y_end);
+
+        // vertices that changed bucket in the last update
+        unsigned int get_moved_vertex_count() const {
+            return moved_vertex_count;
+        }
+
+        // close pairs found since the last update, each counted from both ends
+        unsigned int get_contact_count() const {
+            return contact_count;
+        }
+};
@@ -0,0 +1,74 @@
+#include "ConstraintTable.hpp"
+
+#include <cmath>
+
+namespace {
+float distance(const float *x, const float *y, const float *z, unsigned int stride,
+               unsigned int first, unsigned int second) {
+    float diff_x = x[first * stride] - x[second * stride];
+    float diff_y = y[first * stride] - y[second * stride];
+    float diff_z = z[first * stride] - z[second * stride];
+    return std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z);
+}
+} // namespace
+
+ConstraintTable build_grid_constraints(const float *x, const float *y, const float *z,
+                                       unsigned int stride, unsigned int row_length,
+                                       unsigned int column_length) {
+    ConstraintTable table;
+    unsigned int vertex_count = row_length * column_length;
+
+    table.offsets.reserve(vertex_count + 1);
+    table.neighbours.reserve(static_cast<std::size_t>(vertex_count) * 8);
+    table.rest_lengths.reserve(static_cast<std::size_t>(vertex_count) * 8);
+
+    table.offsets.push_back(0);
+    for (unsigned int vertex_y = 0; vertex_y < column_length; vertex_y++) {
+        for (unsigned int vertex_x = 0; vertex_x < row_length; vertex_x++) {
+            unsigned int vertex_index = vertex_y * row_length + vertex_x;
+            // the top row is pinned
+            if (vertex_y == 0) {
+                table.offsets.push_back(table.neighbours.size());
+                continue;
+            }
+            for (int delta_y = -1; delta_y <= 1; delta_y++) {
+                if (vertex_y == column_length - 1 && delta_y == 1) {
+                    break;
+                }
+                for (int delta_x = -1; delta_x <= 1; delta_x++) {
+                    if (delta_x == 0 && delta_y == 0) {
+                        continue;
+                    }
+                    unsigned int other_x = (vertex_x + row_length + delta_x) % row_length;
+                    unsigned int other_index = (vertex_y + delta_y) * row_length + other_x;
+                    table.neighbours.push_back(other_index);
+                    table.rest_lengths.push_back(
+                        distance(x, y, z, stride, vertex_index, other_index));
+                }
+            }
+            table.offsets.push_back(table.neighbours.size());
+        }
+    }
+
+    const int stencil_delta_x[] = {1, -1, 0, 1};
+    const int stencil_delta_y[] = {0, 1, 1, 1};
+    for (unsigned int direction = 0; direction < ConstraintTable::num_directions; direction++) {
+        std::vector<float> &plane = table.stencil_rest_lengths[direction];
+        plane.assign(vertex_count, 0.0f);
+        for (unsigned int vertex_y = 0; vertex_y < column_length; vertex_y++) {
+            unsigned int other_y = vertex_y + stencil_delta_y[direction];
+            if (other_y >= column_length) {
+                continue;
+            }
+            for (unsigned int vertex_x = 0; vertex_x < row_length; vertex_x++) {
+                unsigned int other_x =
+                    (vertex_x + row_length + stencil_delta_x[direction]) % row_length;
+                plane[vertex_y * row_length + vertex_x] =
+                    distance(x, y, z, stride, vertex_y * row_length + vertex_x,
+                             other_y * row_length + other_x);
+            }
+        }
+    }
+
+    return table;
+}
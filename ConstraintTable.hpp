@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+// rest configuration of the cloth compiled once, so steps no longer need the start positions
+struct ConstraintTable {
+        // compressed sparse rows: the springs of vertex v are [offsets[v], offsets[v + 1]), in
+        // the order vertex_shader.hpp visits them; pinned vertices (the top row) have none
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> neighbours;
+        std::vector<float> rest_lengths;
+
+        // fixed stencil for grid topologies: every spring is stored once, at its upper or left
+        // end, in one plane per direction
+        enum stencil_directions { right, down_left, down, down_right, num_directions };
+
+        std::vector<float> stencil_rest_lengths[stencil_directions::num_directions];
+
+        unsigned int get_vertex_count() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        // bytes a step reads from the table, against the 12 bytes of start position per vertex
+        // and neighbour that recomputing the rest lengths costs
+        unsigned long long get_csr_bytes() const {
+            return offsets.size() * sizeof(unsigned int)
+                   + neighbours.size() * (sizeof(unsigned int) + sizeof(float));
+        }
+
+        unsigned long long get_stencil_bytes() const {
+            return num_directions * stencil_rest_lengths[0].size() * sizeof(float);
+        }
+};
+
+// builds the 8-neighbour grid with the wrap-around seam; position i is read at (x[i * stride],
+// y[i * stride], z[i * stride]) so both the soa and the vec4 layouts can be passed
+ConstraintTable build_grid_constraints(const float *x, const float *y, const float *z,
+                                       unsigned int stride, unsigned int row_length,
+                                       unsigned int column_length);
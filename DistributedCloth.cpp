@@ -0,0 +1,208 @@
+#include "DistributedCloth.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+enum command_type : std::uint32_t { command_step, command_gather, command_stop };
+
+struct rank_command {
+    public:
+        command_type type;
+        std::uint32_t step_count;
+        float delta_time;
+};
+
+struct rank_step_reply {
+    public:
+        double seconds;
+        double halo_seconds;
+        std::uint64_t halo_bytes;
+};
+
+void make_socket_pair(int sockets[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0) {
+        throw std::runtime_error("could not create the sockets of a slab");
+    }
+}
+} // namespace
+
+DistributedCloth::DistributedCloth(unsigned int row_length, unsigned int column_length,
+                                   const ClothParameters &parameters, unsigned int rank_count,
+                                   bool ground_collision)
+    : row_length(row_length), column_length(column_length), parameters(parameters) {
+    if (rank_count == 0 || rank_count > column_length) {
+        throw std::runtime_error("a distributed cloth needs between 1 and one rank per row");
+    }
+
+    // halo_sockets[2 * r] is the lower end of rank r, halo_sockets[2 * r + 1] the upper end of
+    // rank r + 1; control_sockets[2 * r] stays here, control_sockets[2 * r + 1] goes to rank r
+    std::vector<int> halo_sockets(2 * (rank_count - 1));
+    std::vector<int> control_sockets(2 * rank_count);
+    for (unsigned int i = 0; i + 1 < rank_count; i++) {
+        make_socket_pair(&halo_sockets[2 * i]);
+    }
+    for (unsigned int i = 0; i < rank_count; i++) {
+        make_socket_pair(&control_sockets[2 * i]);
+    }
+    // only the control ends of started ranks stay open here
+    auto close_parent_sockets = [&](unsigned int started_count) {
+        for (int socket : halo_sockets) {
+            close(socket);
+        }
+        for (unsigned int i = 0; i < rank_count; i++) {
+            close(control_sockets[2 * i + 1]);
+            if (i >= started_count) {
+                close(control_sockets[2 * i]);
+            }
+        }
+    };
+    auto close_all = [&](int keep_above, int keep_below, int keep_control) {
+        for (const std::vector<int> *sockets : {&halo_sockets, &control_sockets}) {
+            for (int socket : *sockets) {
+                if (socket != keep_above && socket != keep_below && socket != keep_control) {
+                    close(socket);
+                }
+            }
+        }
+    };
+
+    for (unsigned int i = 0; i < rank_count; i++) {
+        rank started;
+        started.y_begin = column_length * i / rank_count;
+        started.y_end = column_length * (i + 1) / rank_count;
+        started.control = control_sockets[2 * i];
+        int socket_above = i > 0 ? halo_sockets[2 * (i - 1) + 1] : -1;
+        int socket_below = i + 1 < rank_count ? halo_sockets[2 * i] : -1;
+
+        started.process = fork();
+        if (started.process < 0) {
+            close_parent_sockets(i);
+            stop();
+            throw std::runtime_error("could not start the process of a slab");
+        }
+        if (started.process == 0) {
+            close_all(socket_above, socket_below, control_sockets[2 * i + 1]);
+            started.control = control_sockets[2 * i + 1];
+            run_rank(started, socket_above, socket_below, row_length, column_length,
+                     parameters, ground_collision);
+        }
+        ranks.push_back(started);
+    }
+
+    close_parent_sockets(rank_count);
+}
+
+DistributedCloth::~DistributedCloth() {
+    stop();
+}
+
+void DistributedCloth::stop() {
+    rank_command command = {command_stop, 0, 0};
+    for (rank &stopped : ranks) {
+        try {
+            write_fully(stopped.control, &command, sizeof(command));
+        } catch (const std::runtime_error &) {
+            // already gone, e.g. after an error
+        }
+        close(stopped.control);
+    }
+    for (rank &stopped : ranks) {
+        waitpid(stopped.process, nullptr, 0);
+    }
+    ranks.clear();
+}
+
+void DistributedCloth::run_rank(const rank &self, int socket_above, int socket_below,
+                                unsigned int row_length, unsigned int column_length,
+                                const ClothParameters &parameters, bool ground_collision) {
+    int status = 0;
+    try {
+        SocketTransport transport(socket_above, socket_below);
+        ClothSlab slab(row_length, column_length, parameters, self.y_begin, self.y_end,
+                       &transport, ground_collision);
+        while (true) {
+            rank_command command;
+            read_fully(self.control, &command, sizeof(command));
+            if (command.type == command_stop) {
+                break;
+            }
+            if (command.type == command_gather) {
+                unsigned int offset = slab.get_owned_offset();
+                std::size_t size = slab.get_owned_vertex_count() * sizeof(float);
+                for (const vertex_buffer *buffer :
+                     {&slab.get_positions(), &slab.get_velocities()}) {
+                    write_fully(self.control, buffer->x.data() + offset, size);
+                    write_fully(self.control, buffer->y.data() + offset, size);
+                    write_fully(self.control, buffer->z.data() + offset, size);
+                }
+                continue;
+            }
+
+            rank_step_reply reply = {};
+            unsigned long long sent_bytes = transport.get_sent_bytes();
+            auto start_time_point = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < command.step_count; i++) {
+                auto halo_time_point = std::chrono::steady_clock::now();
+                slab.exchange_halos();
+                reply.halo_seconds += std::chrono::duration<double>(
+                                          std::chrono::steady_clock::now() - halo_time_point)
+                                          .count();
+                slab.step_rows(command.delta_time);
+            }
+            reply.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                          - start_time_point)
+                                .count();
+            reply.halo_bytes = transport.get_sent_bytes() - sent_bytes;
+            write_fully(self.control, &reply, sizeof(reply));
+        }
+    } catch (const std::exception &exception) {
+        std::cerr << "slab " << self.y_begin << "-" << self.y_end << ": " << exception.what()
+                  << std::endl;
+        status = 1;
+    }
+    // skips the destructors and buffered output this process inherited
+    _exit(status);
+}
+
+DistributedCloth::step_report DistributedCloth::step(float delta_time, unsigned int step_count) {
+    rank_command command = {command_step, step_count, delta_time};
+    for (const rank &stepped : ranks) {
+        write_fully(stepped.control, &command, sizeof(command));
+    }
+    step_report report;
+    for (const rank &stepped : ranks) {
+        rank_step_reply reply;
+        read_fully(stepped.control, &reply, sizeof(reply));
+        report.seconds = std::max(report.seconds, reply.seconds);
+        report.halo_seconds += reply.halo_seconds;
+        report.halo_bytes += reply.halo_bytes;
+    }
+    return report;
+}
+
+void DistributedCloth::gather(vertex_buffer &positions, vertex_buffer &velocities) const {
+    for (vertex_buffer *buffer : {&positions, &velocities}) {
+        buffer->x.resize(get_vertex_count());
+        buffer->y.resize(get_vertex_count());
+        buffer->z.resize(get_vertex_count());
+    }
+    rank_command command = {command_gather, 0, 0};
+    for (const rank &gathered : ranks) {
+        write_fully(gathered.control, &command, sizeof(command));
+        unsigned int offset = gathered.y_begin * row_length;
+        std::size_t size = (gathered.y_end - gathered.y_begin) * row_length * sizeof(float);
+        for (vertex_buffer *buffer : {&positions, &velocities}) {
+            read_fully(gathered.control, buffer->x.data() + offset, size);
+            read_fully(gathered.control, buffer->y.data() + offset, size);
+            read_fully(gathered.control, buffer->z.data() + offset, size);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "ClothSlab.hpp"
+
+#include <sys/types.h>
+#include <vector>
+
+// one cloth split into row slabs, one per rank, each stepped by a forked process that holds
+// only its slab; neighbouring ranks exchange their halo rows over a socketpair every step, and
+// this process only sends commands and gathers the slabs over a control socket per rank, so
+// the cloth is limited by the memory and bandwidth of all ranks together rather than of one
+//
+// steps match a single ClothSolver bit for bit with the explicit integrator in the lab frame;
+// position based steps, the co-rotating frame and self-collision stay single process
+class DistributedCloth {
+    public:
+        using vertex_buffer = ClothSolver::vertex_buffer;
+
+        // of the steps of one call of step, summed over the ranks
+        struct step_report {
+            public:
+                // wall seconds of the slowest rank
+                double seconds = 0;
+                // wall seconds the ranks spent in halo exchanges, waiting for slower neighbours
+                // included
+                double halo_seconds = 0;
+                unsigned long long halo_bytes = 0;
+        };
+
+    private:
+        struct rank {
+            public:
+                pid_t process = -1;
+                int control = -1;
+                unsigned int y_begin;
+                unsigned int y_end;
+        };
+
+        unsigned int row_length;
+        unsigned int column_length;
+        ClothParameters parameters;
+        std::vector<rank> ranks;
+
+        // runs in the forked process until told to stop, never returns
+        [[noreturn]] static void run_rank(const rank &self, int socket_above, int socket_below,
+                                          unsigned int row_length, unsigned int column_length,
+                                          const ClothParameters &parameters,
+                                          bool ground_collision);
+        void stop();
+
+    public:
+        // forks rank_count processes, each holding about the same number of rows; throws if
+        // there are more ranks than rows or a process cannot be started
+        DistributedCloth(unsigned int row_length, unsigned int column_length,
+                         const ClothParameters &parameters, unsigned int rank_count,
+                         bool ground_collision = true);
+        // stops and waits for every rank
+        ~DistributedCloth();
+
+        DistributedCloth(const DistributedCloth &) = delete;
+        DistributedCloth &operator=(const DistributedCloth &) = delete;
+
+        // step_count steps on every rank, returning once all of them are done
+        step_report step(float delta_time, unsigned int step_count = 1);
+
+        // the positions and velocities of the whole cloth, copied out of every slab
+        void gather(vertex_buffer &positions, vertex_buffer &velocities) const;
+
+        unsigned int get_rank_count() const {
+            return ranks.size();
+        }
+
+        const ClothParameters &get_parameters() const {
+            return parameters;
+        }
+
+        unsigned int get_row_length() const {
+            return row_length;
+        }
+
+        unsigned int get_column_length() const {
+            return column_length;
+        }
+
+        unsigned int get_vertex_count() const {
+            return row_length * column_length;
+        }
+};
@@ -0,0 +1,138 @@
+#include "HaloTransport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+std::runtime_error socket_error(const char *what) {
+    return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+} // namespace
+
+SocketTransport::SocketTransport(int socket_above, int socket_below)
+    : sockets{socket_above, socket_below} {
+    for (int socket : sockets) {
+        if (socket >= 0 && fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK) < 0) {
+            throw socket_error("could not make a halo socket non-blocking");
+        }
+    }
+}
+
+SocketTransport::~SocketTransport() {
+    for (int socket : sockets) {
+        if (socket >= 0) {
+            close(socket);
+        }
+    }
+}
+
+void SocketTransport::exchange(const halo_message (&messages)[num_halo_sides]) {
+    std::size_t sent[num_halo_sides] = {};
+    std::size_t received[num_halo_sides] = {};
+    auto is_done = [&](unsigned int side) {
+        return sockets[side] < 0 || messages[side].size == 0
+               || (sent[side] == messages[side].size && received[side] == messages[side].size);
+    };
+
+    while (!is_done(halo_above) || !is_done(halo_below)) {
+        pollfd descriptors[num_halo_sides];
+        unsigned int descriptor_count = 0;
+        unsigned int descriptor_sides[num_halo_sides];
+        for (unsigned int side = 0; side < num_halo_sides; side++) {
+            if (is_done(side)) {
+                continue;
+            }
+            short events = 0;
+            if (sent[side] < messages[side].size) {
+                events |= POLLOUT;
+            }
+            if (received[side] < messages[side].size) {
+                events |= POLLIN;
+            }
+            descriptors[descriptor_count] = {sockets[side], events, 0};
+            descriptor_sides[descriptor_count] = side;
+            descriptor_count++;
+        }
+        if (poll(descriptors, descriptor_count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw socket_error("could not wait for a halo socket");
+        }
+
+        for (unsigned int i = 0; i < descriptor_count; i++) {
+            unsigned int side = descriptor_sides[i];
+            const halo_message &message = messages[side];
+            if ((descriptors[i].revents & POLLOUT) && sent[side] < message.size) {
+                ssize_t count = send(sockets[side], static_cast<const char *>(message.send)
+                                                        + sent[side],
+                                     message.size - sent[side], MSG_NOSIGNAL);
+                if (count < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw socket_error("could not send a halo");
+                }
+                sent[side] += std::max<ssize_t>(count, 0);
+            }
+            if ((descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))
+                && received[side] < message.size) {
+                ssize_t count = recv(sockets[side],
+                                     static_cast<char *>(message.receive) + received[side],
+                                     message.size - received[side], 0);
+                if (count == 0) {
+                    throw std::runtime_error("a neighbouring slab closed its halo socket");
+                }
+                if (count < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw socket_error("could not receive a halo");
+                }
+                received[side] += std::max<ssize_t>(count, 0);
+            }
+        }
+    }
+
+    for (unsigned int side = 0; side < num_halo_sides; side++) {
+        if (sockets[side] >= 0) {
+            sent_bytes += messages[side].size;
+        }
+    }
+    exchange_count++;
+}
+
+void write_fully(int file_descriptor, const void *data, std::size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t count = send(file_descriptor, bytes, size, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw socket_error("could not write to a slab");
+        }
+        bytes += count;
+        size -= count;
+    }
+}
+
+void read_fully(int file_descriptor, void *data, std::size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t count = recv(file_descriptor, bytes, size, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw socket_error("could not read from a slab");
+        }
+        if (count == 0) {
+            throw std::runtime_error("a slab closed its socket early");
+        }
+        bytes += count;
+        size -= count;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+// the slabs next to a slab of rows: the one holding the rows above, towards the pinned top row,
+// and the one holding the rows below
+enum halo_side { halo_above, halo_below, num_halo_sides };
+
+// what one side of a halo exchange sends and receives; both are null on a side without a
+// neighbour
+struct halo_message {
+    public:
+        const void *send = nullptr;
+        void *receive = nullptr;
+        std::size_t size = 0;
+};
+
+// carries the halos between a slab and its neighbours; a slab is written against this, so the
+// same stepping runs over sockets between processes or any other channel
+class HaloTransport {
+    public:
+        virtual ~HaloTransport() = default;
+
+        // sends every message and fills its receive buffer with what the neighbour on that side
+        // sent in the same exchange; returns once both sides are done, throws if a neighbour is
+        // gone
+        virtual void exchange(const halo_message (&messages)[num_halo_sides]) = 0;
+};
+
+// the halo exchange over stream sockets, e.g. unix sockets or a socketpair inherited through
+// fork; the sockets are made non-blocking and both sides are sent and received at once, so two
+// neighbours sending rows larger than the socket buffer to each other cannot deadlock
+class SocketTransport : public HaloTransport {
+    private:
+        // -1 on a side without a neighbour
+        int sockets[num_halo_sides];
+
+        unsigned long long sent_bytes = 0;
+        unsigned long long exchange_count = 0;
+
+    public:
+        // takes ownership of both sockets
+        SocketTransport(int socket_above, int socket_below);
+        ~SocketTransport() override;
+
+        SocketTransport(const SocketTransport &) = delete;
+        SocketTransport &operator=(const SocketTransport &) = delete;
+
+        void exchange(const halo_message (&messages)[num_halo_sides]) override;
+
+        unsigned long long get_sent_bytes() const {
+            return sent_bytes;
+        }
+
+        unsigned long long get_exchange_count() const {
+            return exchange_count;
+        }
+};
+
+// sends or receives all size bytes on a blocking stream socket; throws on errors and when the
+// other end closes early, instead of raising SIGPIPE
+void write_fully(int file_descriptor, const void *data, std::size_t size);
+void read_fully(int file_descriptor, void *data, std::size_t size);
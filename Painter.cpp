@@ -1,90 +1,155 @@
 #include "Painter.hpp"
+#include "ClothMesh.hpp"
+#include "ClothSolver.hpp"
+#include "ConstraintTable.hpp"
 #include "constants.hpp"
 
 #include "fragment_shader.hpp"
 #include "fragment_shader_ground.hpp"
+#include "normal_shader.hpp"
+#include "simulation_shader.hpp"
 #include "vertex_shader.hpp"
 #include "vertex_shader_ground.hpp"
 
-#include <numbers>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
-namespace {
-GLuint create_shader(GLint type, const char *source, const std::string &shader_name_str) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char info_log_buffer[512];
-        glGetShaderInfoLog(shader, 512, nullptr, info_log_buffer);
-        std::stringstream stream;
-        stream << "error linking program " << shader_name_str << ": " << info_log_buffer;
-        throw std::runtime_error(stream.str());
-    }
-    return shader;
-}
+void Painter::init_buffers() {
 
-void link_program(GLuint program, const std::string &program_name_str) {
+    unsigned int vertex_count = get_vertex_count();
+    GLsizeiptr normals_size = static_cast<GLsizeiptr>(vertex_count) * 4 * sizeof(GLfloat);
 
-    glLinkProgram(program);
+    // on the heap, since large grids do not fit on the stack
+    std::vector<GLfloat> vertex_positions(static_cast<std::size_t>(vertex_count) * 4);
 
-    {
-        int success;
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success) {
-            char info_log_buffer[512];
-            glGetProgramInfoLog(program, 512, nullptr, info_log_buffer);
-            std::stringstream stream;
-            stream << "error linking program " << program_name_str << ": " << info_log_buffer;
-            throw std::runtime_error(stream.str());
+    glGenBuffers(4, buffers);
+
+    // init vertex data: the cone ClothSolver starts from, interleaved as x, y, z, 1
+    unsigned int cloth_vertex_count = get_cloth_vertex_count();
+    std::vector<float> start_positions[3];
+    for (std::vector<float> &coordinates : start_positions) {
+        coordinates.resize(cloth_vertex_count);
+    }
+    for (unsigned int cloth = 0; cloth < get_cloth_count(); cloth++) {
+        build_start_positions(start_positions[0].data(), start_positions[1].data(),
+                              start_positions[2].data(), row_length, column_length,
+                              parameters[cloth]);
+        for (unsigned int i = 0; i < cloth_vertex_count; i++) {
+            GLfloat *vertex_position = &vertex_positions[4 * (cloth * cloth_vertex_count + i)];
+            vertex_position[0] = start_positions[0][i];
+            vertex_position[1] = start_positions[1][i];
+            vertex_position[2] = start_positions[2][i];
+            vertex_position[3] = 1;
         }
     }
-}
-} // namespace
 
-void Painter::init_buffers() {
+    // populate shader storage buffers with positions and velocities
+    for (unsigned int i = 0; i < buffer_indices::num; i++) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER,
+                     get_state_buffer_size(get_buffer_format(i), vertex_count), nullptr,
+                     GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    write_buffer(buffer_indices::start_positions, vertex_positions.data());
+    write_buffer(buffer_indices::first_positions, vertex_positions.data());
+    // also the previous state until the first step, for interpolated drawing
+    write_buffer(buffer_indices::second_positions, vertex_positions.data());
+    // clearing with no data zeroes the velocities on the gpu, which is a zero velocity in every
+    // state format
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer_indices::velocities]);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    current_buffer = 0;
 
-    float vertex_positions[vertex_count][4];
+    glGenBuffers(constraint_buffer_indices::num_constraint_buffers, constraint_buffers);
+    upload_constraints(vertex_positions.data());
+    for (unsigned int i = 0; i < constraint_buffer_indices::num_constraint_buffers; i++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4 + i, constraint_buffers[i]);
+    }
 
-    float zeros[vertex_count][4];
+    glGenBuffers(1, &normals_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, normals_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, normals_size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, normals_buffer);
+}
 
-    glGenBuffers(4, buffers);
-    std::memset(zeros, 0, sizeof(zeros));
-
-    // init vertex data
-    for (unsigned int y = 0; y < column_length; y++) {
-        for (unsigned int x = 0; x < row_length; x++) {
-            float y_fraction = static_cast<float>(y) / column_length;
-            float radius = (1 - y_fraction) * upper_radius + y_fraction * lower_radius;
-            vertex_positions[y * row_length + x][0] =
-                std::cos(std::numbers::pi_v<float> * 2 * static_cast<float>(x) / row_length)
-                * radius;
-            vertex_positions[y * row_length + x][1] = 0.5f - y_fraction;
-            vertex_positions[y * row_length + x][2] =
-                -std::sin(std::numbers::pi_v<float> * 2 * static_cast<float>(x) / row_length)
-                * radius;
-            vertex_positions[y * row_length + x][3] = 1;
+void Painter::upload_constraints(const float *start_positions) {
+    // the rest lengths never change, so they are computed once here instead of every step;
+    // the tables of all cloths are concatenated, with the neighbours moved to their cloth
+    ConstraintTable constraints;
+    constraints.offsets.push_back(0);
+    for (unsigned int cloth = 0; cloth < get_cloth_count(); cloth++) {
+        unsigned int base = cloth * get_cloth_vertex_count();
+        const float *cloth_start_positions = &start_positions[4 * base];
+        ConstraintTable cloth_constraints = build_grid_constraints(
+            &cloth_start_positions[0], &cloth_start_positions[1], &cloth_start_positions[2], 4,
+            row_length, column_length);
+        unsigned int spring_base = constraints.neighbours.size();
+        for (unsigned int i = 1; i < cloth_constraints.offsets.size(); i++) {
+            constraints.offsets.push_back(spring_base + cloth_constraints.offsets[i]);
+        }
+        for (unsigned int neighbour : cloth_constraints.neighbours) {
+            constraints.neighbours.push_back(base + neighbour);
         }
+        constraints.rest_lengths.insert(constraints.rest_lengths.end(),
+                                        cloth_constraints.rest_lengths.begin(),
+                                        cloth_constraints.rest_lengths.end());
     }
 
-    // populate shader storage buffers with positions and velocities
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer_indices::start_positions]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vertex_positions), vertex_positions,
-                 GL_STATIC_DRAW);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer_indices::first_positions]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vertex_positions), vertex_positions,
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, constraint_buffers[constraint_buffer_indices::offsets]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, constraints.offsets.size() * sizeof(GLuint),
+                 constraints.offsets.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,
+                 constraint_buffers[constraint_buffer_indices::neighbours]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, constraints.neighbours.size() * sizeof(GLuint),
+                 constraints.neighbours.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,
+                 constraint_buffers[constraint_buffer_indices::rest_lengths]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, constraints.rest_lengths.size() * sizeof(GLfloat),
+                 constraints.rest_lengths.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Painter::apply_parameters() {
+    // the cloth_parameters struct of simulation_shader.hpp, padded to 16 bytes
+    std::vector<GLfloat> blocks(static_cast<std::size_t>(get_cloth_count()) * 4);
+    for (unsigned int cloth = 0; cloth < get_cloth_count(); cloth++) {
+        blocks[4 * cloth] = parameters[cloth].spinning_speed;
+        blocks[4 * cloth + 1] = parameters[cloth].spring_strength;
+        blocks[4 * cloth + 2] = parameters[cloth].gravity_strength;
+    }
+    if (parameters_buffer == 0) {
+        glGenBuffers(1, &parameters_buffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, parameters_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, blocks.size() * sizeof(GLfloat), blocks.data(),
                  GL_STATIC_DRAW);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer_indices::second_positions]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(vertex_positions), nullptr, GL_STATIC_DRAW);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer_indices::velocities]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeros), zeros, GL_STATIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-    current_buffer = 0;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, parameters_buffer);
+}
 
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffers[buffer_indices::start_positions]);
+void Painter::check_single_cloth() const {
+    if (get_cloth_count() != 1) {
+        throw std::runtime_error("checkpoints hold a single cloth, the painter has "
+                                 + std::to_string(get_cloth_count()));
+    }
+}
+
+void Painter::init_element_buffer() {
+    // every vertex is shaded once per pass and reused from the post-transform cache, instead of
+    // once for each of the up to six triangles around it
+    std::vector<unsigned int> indices = build_render_indices(row_length, column_length);
+    glGenBuffers(1, &element_buffer);
+    glBindVertexArray(cloth_VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(),
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void Painter::init_ground_VAO() {
@@ -92,10 +157,10 @@ void Painter::init_ground_VAO() {
     glBindVertexArray(ground_VAO);
 
     ground_vertex vertices[] = {
-        {-2, -1,  2},
-        { 2, -1,  2},
-        {-2, -1, -2},
-        { 2, -1, -2}
+        {-2, ground_height,  2},
+        { 2, ground_height,  2},
+        {-2, ground_height, -2},
+        { 2, ground_height, -2}
     };
 
     GLuint ground_vertices_buffer;
@@ -115,6 +180,7 @@ void Painter::init_opengl_window() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     window = glfwCreateWindow(100, 100, "title", nullptr, nullptr);
     glfwMakeContextCurrent(window);
@@ -124,33 +190,38 @@ void Painter::init_opengl_window() {
 }
 
 void Painter::init_ground_shader_program() {
-
-    GLuint v_shader_ground =
-        create_shader(GL_VERTEX_SHADER, vertex_ground_shader_source, "ground vertex shader");
-    GLuint f_shader_ground =
-        create_shader(GL_FRAGMENT_SHADER, fragment_ground_shader_source, "ground fragment shader");
-    ground_program = glCreateProgram();
-    glAttachShader(ground_program, v_shader_ground);
-    glAttachShader(ground_program, f_shader_ground);
-    link_program(ground_program, "ground program");
-    glDeleteShader(v_shader_ground);
-    glDeleteShader(f_shader_ground);
+    ground_program = shader_cache.build_program(
+        {{GL_VERTEX_SHADER, vertex_ground_shader_source, "ground vertex shader"},
+         {GL_FRAGMENT_SHADER, fragment_ground_shader_source, "ground fragment shader"}},
+        "ground program");
 }
 
 void Painter::init_cloth_shader_program() {
-    GLuint v_shader = create_shader(GL_VERTEX_SHADER, vertex_shader_source, "vertex shader");
-    GLuint f_shader = create_shader(GL_FRAGMENT_SHADER, fragment_shader_source, "fragment shader");
-    program = glCreateProgram();
-    glAttachShader(program, v_shader);
-    glAttachShader(program, f_shader);
-    link_program(program, "main program");
-    glDeleteShader(v_shader);
-    glDeleteShader(f_shader);
+    program = shader_cache.build_program(
+        {{GL_VERTEX_SHADER,
+          vertex_shader_source(row_length, column_length, get_cloth_count(), format),
+          "vertex shader"},
+         {GL_FRAGMENT_SHADER, fragment_shader_source, "fragment shader"}},
+        "main program");
+}
+
+void Painter::init_simulation_shader_programs() {
+    simulation_program = shader_cache.build_program(
+        {{GL_COMPUTE_SHADER,
+          simulation_shader_source(row_length, column_length, get_cloth_count(), format),
+          "simulation shader"}},
+        "simulation program");
+    normal_program = shader_cache.build_program(
+        {{GL_COMPUTE_SHADER,
+          normal_shader_source(row_length, column_length, get_cloth_count(), format),
+          "normal shader"}},
+        "normal program");
 }
 
 void Painter::init_shader_programs() {
     init_ground_shader_program();
     init_cloth_shader_program();
+    init_simulation_shader_programs();
 }
 
 glm::mat4 Painter::construct_view_matrix() {
@@ -178,15 +249,8 @@ void Painter::init_view_transform_uniforms() {
         glGenBuffers(1, &view_display_options_buffer);
 
         glBindBuffer(GL_UNIFORM_BUFFER, view_display_options_buffer);
-        glBufferData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat) + sizeof(GLuint), nullptr,
+        glBufferData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat), glm::value_ptr(view_transform),
                      GL_STATIC_DRAW);
-
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, 4 * 4 * sizeof(GLfloat),
-                        glm::value_ptr(view_transform));
-
-        // enable updating while drawing to screen
-        GLuint do_update = true;
-        glBufferSubData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat), sizeof(GLuint), &do_update);
     }
 }
 
@@ -203,13 +267,9 @@ void Painter::init_light_transform_uniforms() {
     glGenBuffers(1, &light_display_options_buffer);
 
     glBindBuffer(GL_UNIFORM_BUFFER, light_display_options_buffer);
-    glBufferData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat) + sizeof(GLuint), nullptr,
-                 GL_STATIC_DRAW);
     // set the transform
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, 4 * 4 * sizeof(GLfloat), glm::value_ptr(light_transform));
-    // disable the simulation while drawing light
-    GLuint dont_update = false;
-    glBufferSubData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat), sizeof(GLuint), &dont_update);
+    glBufferData(GL_UNIFORM_BUFFER, 4 * 4 * sizeof(GLfloat), glm::value_ptr(light_transform),
+                 GL_STATIC_DRAW);
 
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
@@ -248,6 +308,7 @@ void Painter::init() {
 
     init_opengl_window();
     glGenVertexArrays(1, &cloth_VAO);
+    init_element_buffer();
 
     init_shader_programs();
 
@@ -257,17 +318,19 @@ void Painter::init() {
     init_view_transform_uniforms();
     init_light_transform_uniforms();
 
-    delta_time_uniform_location = glGetUniformLocation(program, "delta_time");
+    delta_time_uniform_location = glGetUniformLocation(simulation_program, "delta_time");
     light_dir_uniform_location = glGetUniformLocation (program, "light_dir");
+    interpolation_uniform_location = glGetUniformLocation(program, "interpolation");
+    frame_rotation_uniform_location = glGetUniformLocation(program, "frame_rotation");
+    apply_parameters();
 
     glProgramUniform3fv (program, light_dir_uniform_location, 1, glm::value_ptr(light_dir));
 
     init_shadow_textures_and_framebuffer();
 }
 
-void Painter::draw_shadows(float delta_time, unsigned int type) {
-    glProgramUniform1f(program, delta_time_uniform_location, delta_time);
-
+void Painter::draw_shadows(unsigned int type) {
+    Profiler::scope scope(profiler, profile_shadows);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_framebuffer);
     glViewport(0, 0, shadow_map_size, shadow_map_size);
 
@@ -286,9 +349,9 @@ void Painter::draw_shadows(float delta_time, unsigned int type) {
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, light_display_options_buffer);
 
     glBindVertexArray(cloth_VAO);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
-                     buffers[buffer_indices::first_positions + current_buffer]);
-    glDrawArrays(GL_TRIANGLES, 0, 6 * row_length * (column_length - 1));
+    bind_positions_for_drawing();
+    glDrawElementsInstanced(GL_TRIANGLES, get_render_index_count(row_length, column_length),
+                            GL_UNSIGNED_INT, nullptr, get_cloth_count());
 }
 
 void Painter::draw_to_screen(unsigned int type) {
@@ -301,35 +364,289 @@ void Painter::draw_to_screen(unsigned int type) {
     glfwGetWindowSize(window, &width, &height);
     glViewport(0, 0, width, height);
 
-    glClearColor(0.3f, 0, 1, 1);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    {
+        Profiler::scope scope(profiler, profile_cloth);
+        glClearColor(0.3f, 0, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glUseProgram(program);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, view_display_options_buffer);
+        glUseProgram(program);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, view_display_options_buffer);
 
-    glBindVertexArray(cloth_VAO);
+        glBindVertexArray(cloth_VAO);
+        bind_positions_for_drawing();
+
+        glDrawElementsInstanced(GL_TRIANGLES, get_render_index_count(row_length, column_length),
+                                GL_UNSIGNED_INT, nullptr, get_cloth_count());
+    }
+
+    {
+        Profiler::scope scope(profiler, profile_ground);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, shadow_texture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, shadow_color_texture);
+        glUseProgram(ground_program);
+        glUniform1ui(glGetUniformLocation(ground_program, "type"), type);
+        glBindVertexArray(ground_VAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    Profiler::scope scope(profiler, profile_swap);
+    glfwSwapBuffers(window);
+}
+
+void Painter::bind_positions_for_drawing() {
+    if (drawn_snapshot >= 0) {
+        // a snapshot has a single state, which is also the previous one
+        const snapshot_slot &snapshot = snapshots[drawn_snapshot];
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, snapshot.positions_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, snapshot.positions_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, snapshot.normals_buffer);
+        return;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, normals_buffer);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
                      buffers[buffer_indices::first_positions + current_buffer]);
-    current_buffer ^= 1;
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2,
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8,
+                     buffers[buffer_indices::first_positions + (current_buffer ^ 1)]);
+}
+
+void Painter::dispatch_over_vertices() {
+    constexpr unsigned int local_size = 256; // local_size_x of the compute shaders
+    glDispatchCompute((get_vertex_count() + local_size - 1) / local_size, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void Painter::update_normals() {
+    Profiler::scope scope(profiler, profile_normals);
+    glUseProgram(normal_program);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
                      buffers[buffer_indices::first_positions + current_buffer]);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers[buffer_indices::velocities]);
+    dispatch_over_vertices();
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, 6 * row_length * (column_length - 1));
+void Painter::simulate(float delta_time) {
+    {
+        // time queries cannot nest, so the normal pass is timed on its own
+        Profiler::scope scope(profiler, profile_simulation);
+        glProgramUniform1f(simulation_program, delta_time_uniform_location, delta_time);
+
+        glUseProgram(simulation_program);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                         buffers[buffer_indices::first_positions + current_buffer]);
+        current_buffer ^= 1;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2,
+                         buffers[buffer_indices::first_positions + current_buffer]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, buffers[buffer_indices::velocities]);
+        dispatch_over_vertices();
+        simulated_time += delta_time;
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, shadow_texture);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadow_color_texture);
-    glUseProgram(ground_program);
-    glUniform1ui(glGetUniformLocation(ground_program, "type"), type);
-    glBindVertexArray(ground_VAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    update_normals();
+}
 
-    glfwSwapBuffers(window);
+void Painter::upload_positions(const float *x, const float *y, const float *z) {
+    std::vector<GLfloat> vertex_positions(static_cast<std::size_t>(get_vertex_count()) * 4);
+    for (unsigned int i = 0; i < get_vertex_count(); i++) {
+        vertex_positions[4 * i] = x[i];
+        vertex_positions[4 * i + 1] = y[i];
+        vertex_positions[4 * i + 2] = z[i];
+        vertex_positions[4 * i + 3] = 1;
+    }
+    upload_vertex_positions(vertex_positions.data());
 }
 
-void Painter::display(float delta_time, unsigned int type) {
-    draw_shadows(delta_time, type);
+void Painter::upload_vertex_positions(const float *vertex_positions) {
+    {
+        Profiler::scope scope(profiler, profile_upload);
+        // the old current state becomes the previous one
+        current_buffer ^= 1;
+        write_buffer(buffer_indices::first_positions + current_buffer, vertex_positions);
+    }
+
+    update_normals();
+}
+
+void Painter::set_frame_angle(float angle) {
+    // columns of the turn update_top_row applies to the top row
+    float cs = std::cos(angle);
+    float sn = std::sin(angle);
+    const GLfloat rotation[9] = {cs, 0, -sn, 0, 1, 0, sn, 0, cs};
+    glProgramUniformMatrix3fv(program, frame_rotation_uniform_location, 1, GL_FALSE, rotation);
+}
+
+void Painter::render(unsigned int type, float interpolation) {
+    glProgramUniform1f(program, interpolation_uniform_location, interpolation);
+    draw_shadows(type);
     draw_to_screen(type);
 }
+
+void Painter::init_snapshots(unsigned int slot_count) {
+    GLint major_version = 0;
+    GLint minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+    if (major_version * 10 + minor_version < 44) {
+        throw std::runtime_error("snapshots need persistently mapped buffers, from opengl 4.4");
+    }
+    if (format != state_format_float4) {
+        throw std::runtime_error("snapshots need the float4 state format");
+    }
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(get_vertex_count()) * 4 * sizeof(GLfloat);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    snapshots.resize(slot_count);
+    for (snapshot_slot &snapshot : snapshots) {
+        GLuint *slot_buffers[2] = {&snapshot.positions_buffer, &snapshot.normals_buffer};
+        float **slot_pointers[2] = {&snapshot.positions, &snapshot.normals};
+        for (unsigned int i = 0; i < 2; i++) {
+            glGenBuffers(1, slot_buffers[i]);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, *slot_buffers[i]);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+            *slot_pointers[i] =
+                static_cast<float *>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+            if (!*slot_pointers[i]) {
+                throw std::runtime_error("could not map a snapshot buffer");
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Painter::render_snapshot(unsigned int slot, unsigned int type) {
+    drawn_snapshot = slot;
+    render(type);
+    drawn_snapshot = -1;
+
+    // the draws of this frame replace those of earlier frames, which finish before them
+    snapshot_slot &snapshot = snapshots[slot];
+    if (snapshot.fence) {
+        glDeleteSync(snapshot.fence);
+    }
+    snapshot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool Painter::is_snapshot_idle(unsigned int slot) {
+    snapshot_slot &snapshot = snapshots[slot];
+    if (!snapshot.fence) {
+        return true;
+    }
+    // flushes, so the fence is signalled eventually even if nothing else is issued
+    GLenum result = glClientWaitSync(snapshot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+        return false;
+    }
+    glDeleteSync(snapshot.fence);
+    snapshot.fence = 0;
+    return true;
+}
+
+void Painter::display(float delta_time, unsigned int type) {
+    simulate(delta_time);
+    render(type);
+}
+
+void Painter::read_buffer(unsigned int buffer, std::vector<float> &data) {
+    state_format buffer_format = get_buffer_format(buffer);
+    unsigned int vertex_count = get_vertex_count();
+    data.resize(static_cast<std::size_t>(vertex_count) * 4);
+    // the storage barrier of dispatch_over_vertices only orders shader accesses; reads through
+    // glGetBufferSubData need their own
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+    if (buffer_format == state_format_float4) {
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(float), data.data());
+    } else {
+        std::vector<std::uint32_t> words(get_state_buffer_size(buffer_format, vertex_count)
+                                         / sizeof(std::uint32_t));
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, words.size() * sizeof(std::uint32_t),
+                           words.data());
+        decode_state(buffer_format, words.data(), vertex_count, &data[0], &data[1], &data[2], 4);
+        float w = buffer == buffer_indices::velocities ? 0 : 1;
+        for (unsigned int vertex = 0; vertex < vertex_count; vertex++) {
+            data[4 * vertex + 3] = w;
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Painter::write_buffer(unsigned int buffer, const float *data) {
+    state_format buffer_format = get_buffer_format(buffer);
+    unsigned int vertex_count = get_vertex_count();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+    if (buffer_format == state_format_float4) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                        static_cast<std::size_t>(vertex_count) * 4 * sizeof(GLfloat), data);
+    } else {
+        std::vector<std::uint32_t> words;
+        encode_state(buffer_format, &data[0], &data[1], &data[2], 4, vertex_count,
+                     buffer == buffer_indices::velocities ? 0 : 1, words);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, words.size() * sizeof(std::uint32_t),
+                        words.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Painter::read_positions(std::vector<float> &positions) {
+    read_buffer(buffer_indices::first_positions + current_buffer, positions);
+}
+
+void Painter::read_velocities(std::vector<float> &velocities) {
+    read_buffer(buffer_indices::velocities, velocities);
+}
+
+Checkpoint Painter::get_checkpoint() {
+    check_single_cloth();
+    Checkpoint checkpoint;
+    checkpoint.row_length = row_length;
+    checkpoint.column_length = column_length;
+    checkpoint.parameters = parameters[0];
+    checkpoint.simulated_time = simulated_time;
+    checkpoint.current_buffer = current_buffer;
+
+    std::vector<float> data;
+    for (unsigned int i = 0; i < buffer_indices::num; i++) {
+        read_buffer(i, data);
+        std::vector<float> &target = checkpoint.buffers[i];
+        target.resize(static_cast<std::size_t>(get_vertex_count()) * 3);
+        for (unsigned int vertex = 0; vertex < get_vertex_count(); vertex++) {
+            target[vertex] = data[4 * vertex];
+            target[get_vertex_count() + vertex] = data[4 * vertex + 1];
+            target[2 * get_vertex_count() + vertex] = data[4 * vertex + 2];
+        }
+    }
+    return checkpoint;
+}
+
+void Painter::restore(const Checkpoint &checkpoint) {
+    check_single_cloth();
+    if (checkpoint.row_length != row_length || checkpoint.column_length != column_length) {
+        std::stringstream stream;
+        stream << "checkpoint grid " << checkpoint.row_length << "x" << checkpoint.column_length
+               << " does not match the painter grid " << row_length << "x" << column_length;
+        throw std::runtime_error(stream.str());
+    }
+    parameters[0] = checkpoint.parameters;
+    simulated_time = checkpoint.simulated_time;
+    current_buffer = checkpoint.current_buffer;
+    apply_parameters();
+
+    std::vector<GLfloat> data(static_cast<std::size_t>(get_vertex_count()) * 4);
+    for (unsigned int i = 0; i < buffer_indices::num; i++) {
+        const std::vector<float> &source = checkpoint.buffers[i];
+        for (unsigned int vertex = 0; vertex < get_vertex_count(); vertex++) {
+            data[4 * vertex] = source[vertex];
+            data[4 * vertex + 1] = source[get_vertex_count() + vertex];
+            data[4 * vertex + 2] = source[2 * get_vertex_count() + vertex];
+            // w is 1 for positions and 0 for velocities
+            data[4 * vertex + 3] = i == buffer_indices::velocities ? 0 : 1;
+        }
+        write_buffer(i, data.data());
+        if (i == buffer_indices::start_positions) {
+            // the start positions may come from other radii
+            upload_constraints(data.data());
+        }
+    }
+
+    update_normals();
+}
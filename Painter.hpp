@@ -1,3 +1,10 @@
+#include "Checkpoint.hpp"
+#include "ClothParameters.hpp"
+#include "Profiler.hpp"
+#include "ShaderCache.hpp"
+#include "StateFormat.hpp"
+#include "constants.hpp"
+
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
@@ -6,17 +13,37 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <vector>
+
+constexpr glm::vec3 light_dir(0.5, 3, 0.5);
 
 enum { display_type_color, display_type_shadow, num_display_types };
 
 class Painter {
     private:
         GLFWwindow *window = nullptr;
+        bool visible = true;
+        // times the passes when set and enabled
+        Profiler *profiler = nullptr;
+        unsigned int row_length;
+        unsigned int column_length;
+        // one block per cloth; every cloth has the grid size above and its own vertices,
+        // cloth c owning [c * row_length * column_length, (c + 1) * row_length * column_length)
+        std::vector<ClothParameters> parameters;
+        double simulated_time = 0;
         GLint delta_time_uniform_location = 0;
         GLint light_dir_uniform_location = 0;
+        GLint interpolation_uniform_location = 0;
+        GLint frame_rotation_uniform_location = 0;
+        // compiles the programs below, or loads them from disk
+        ShaderCache shader_cache;
         GLuint program = 0;
         GLuint ground_program = 0;
+        GLuint simulation_program = 0;
+        GLuint normal_program = 0;
         GLuint cloth_VAO = 0;
+        // the triangles of a cloth as indices into its render vertices, see ClothMesh.hpp
+        GLuint element_buffer = 0;
         GLuint ground_VAO = 0;
         unsigned int current_buffer = 0;
         GLuint shadow_texture = 0;
@@ -26,28 +53,73 @@ class Painter {
         enum buffer_indices { start_positions, first_positions, second_positions, velocities, num };
 
         GLuint buffers[buffer_indices::num];
+        // of both position buffers and the velocities; the start positions are only read on the
+        // cpu, so they stay float4
+        state_format format = state_format_float4;
+
+        // the simulation part of every parameter block, bound to 9
+        GLuint parameters_buffer = 0;
+
+        // springs compiled from the start positions, bound to 4, 5 and 6
+        enum constraint_buffer_indices {
+            offsets,
+            neighbours,
+            rest_lengths,
+            num_constraint_buffers
+        };
+
+        GLuint constraint_buffers[constraint_buffer_indices::num_constraint_buffers];
 
-        // uniform buffer that sets the transform to light and disables movement simulation
+        // written by the normal pass after every position change, bound to 7
+        GLuint normals_buffer = 0;
+
+        // a position and a normal buffer per slot of a SnapshotRing, both x, y, z, w per vertex,
+        // mapped for as long as the painter lives so another thread can write them while the
+        // painter draws other slots
+        struct snapshot_slot {
+            public:
+                GLuint positions_buffer = 0;
+                GLuint normals_buffer = 0;
+                float *positions = nullptr;
+                float *normals = nullptr;
+                // signalled once the last draw that reads the slot has finished, 0 if none is
+                // pending
+                GLsync fence = 0;
+        };
+
+        std::vector<snapshot_slot> snapshots;
+        // drawn in place of the position buffers while not negative
+        int drawn_snapshot = -1;
+
+        // uniform buffer that sets the transform to light
         GLuint light_display_options_buffer = 0;
-        // uniform buffer that sets the transform to view and makes shader simulate movement
+        // uniform buffer that sets the transform to view
         GLuint view_display_options_buffer = 0;
 
         void init_buffers();
+        // compiles the springs from start positions given as vec4s and uploads them
+        void upload_constraints(const float *start_positions);
+        // uploads the simulation part of the parameter blocks
+        void apply_parameters();
+        // only a single cloth fits into a checkpoint
+        void check_single_cloth() const;
 
         struct ground_vertex {
             public:
                 float position[3];
         };
 
+        void init_element_buffer();
         void init_ground_VAO();
 
-        void draw_shadows(float delta_time, unsigned int type);
-        void draw_to_screen(unsigned int type);
+        void bind_positions_for_drawing();
+        void dispatch_over_vertices();
 
         void init_opengl_window();
 
         void init_ground_shader_program();
         void init_cloth_shader_program();
+        void init_simulation_shader_programs();
         void init_shader_programs();
 
         void init_view_transform_uniforms();
@@ -57,20 +129,149 @@ class Painter {
 
         glm::mat4 construct_view_matrix();
 
+        state_format get_buffer_format(unsigned int buffer) const {
+            return buffer == buffer_indices::start_positions ? state_format_float4 : format;
+        }
+
+        // from and to x, y, z, w per vertex, w being 1 for positions and 0 for velocities
+        void read_buffer(unsigned int buffer, std::vector<float> &data);
+        void write_buffer(unsigned int buffer, const float *data);
+
     public:
+        Painter(unsigned int row_length = default_row_length,
+                unsigned int column_length = default_column_length,
+                const ClothParameters &parameters = {})
+            : row_length(row_length), column_length(column_length), parameters{parameters} {}
+
+        // one cloth per parameter block, simulated in the same dispatches and drawn instanced
+        Painter(unsigned int row_length, unsigned int column_length,
+                const std::vector<ClothParameters> &parameters)
+            : row_length(row_length), column_length(column_length), parameters(parameters) {}
 
         GLFWwindow *get_window() {
             return window;
         }
 
+        unsigned int get_cloth_count() const {
+            return parameters.size();
+        }
+
+        unsigned int get_cloth_vertex_count() const {
+            return row_length * column_length;
+        }
+
+        const std::vector<ClothParameters> &get_parameters() const {
+            return parameters;
+        }
+
+        // of all cloths together
+        unsigned int get_vertex_count() const {
+            return get_cloth_count() * get_cloth_vertex_count();
+        }
+
+        // a hidden window still has a default framebuffer to draw into, e.g. for benchmarks;
+        // has to be called before init
+        void set_visible(bool is_visible) {
+            visible = is_visible;
+        }
+
+        state_format get_state_format() const {
+            return format;
+        }
+
+        // has to be called before init
+        void set_state_format(state_format new_format) {
+            format = new_format;
+        }
+
+        // keeps the linked programs in the directory, so later processes with the same grid
+        // size, state format and driver skip compiling them; has to be called before init
+        void set_shader_cache_directory(const std::string &directory) {
+            shader_cache = ShaderCache(directory);
+        }
+
+        // programs loaded and compiled by init, and the time it took
+        const ShaderCache &get_shader_cache() const {
+            return shader_cache;
+        }
+
         void init();
 
+        void set_profiler(Profiler *new_profiler) {
+            profiler = new_profiler;
+        }
+
         bool has_finished() {
             return glfwWindowShouldClose(window);
         }
 
+        // advances the cloth by one step in the simulation pass and updates the normals
+        void simulate(float delta_time);
+
+        // makes the given positions the new current state, e.g. a step of a cpu simulation
+        void upload_positions(const float *x, const float *y, const float *z);
+
+        // same, from x, y, z, 1 per vertex as float4 position buffers store them, e.g. a mapped
+        // trajectory frame; the data is copied to the gpu without any conversion in that format
+        void upload_vertex_positions(const float *vertex_positions);
+
+        // creates slot_count snapshot slots; needs gl 4.4 for persistent mapping and the float4
+        // state format, since the slots are drawn with the same shaders as the position buffers
+        void init_snapshots(unsigned int slot_count);
+
+        // where the positions and normals of the slot are written, as x, y, z, w per vertex; the
+        // mapping is coherent, so writes become visible to draws issued after them
+        float *get_snapshot_positions(unsigned int slot) {
+            return snapshots[slot].positions;
+        }
+
+        float *get_snapshot_normals(unsigned int slot) {
+            return snapshots[slot].normals;
+        }
+
+        // draws the slot like render draws the current state, straight from its mapped memory
+        void render_snapshot(unsigned int slot, unsigned int type);
+
+        // whether every draw reading the slot has finished, so it may be written again; does not
+        // wait
+        bool is_snapshot_idle(unsigned int slot);
+
+        // positions simulated in a frame turned by angle around the y axis, see
+        // ClothSolver::set_co_rotating, are drawn turned back by it
+        void set_frame_angle(float angle);
+
+        // interpolation between 0 and 1 blends the previous and the current state
+        void render(unsigned int type, float interpolation = 1);
+
+        // the passes of simulate and render, separately for benchmarks
+        void update_normals();
+        void draw_shadows(unsigned int type);
+        void draw_to_screen(unsigned int type);
+
+        // waits until the gpu has executed every command issued so far
+        void finish() {
+            glFinish();
+        }
+
         void display(float delta_time, unsigned int type);
 
+        // read back the current state as vec4s in any state format, used to compare against
+        // ClothSolver
+        void read_positions(std::vector<float> &positions);
+        void read_velocities(std::vector<float> &velocities);
+
+        // sum of the delta times simulated by the shader since init
+        double get_simulated_time() const {
+            return simulated_time;
+        }
+
+        // reads back all four buffers
+        Checkpoint get_checkpoint();
+
+        // continues from the checkpoint, including its parameters; throws if its grid size is
+        // not the one of the painter
+        void restore(const Checkpoint &checkpoint);
+
         void destroy() {
             glfwDestroyWindow(window);
         }
@@ -0,0 +1,92 @@
+#include "PerfCounters.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+int open_counter(unsigned int type, unsigned long long config) {
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    // user space only, which perf_event_paranoid up to 2 allows without privileges
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+unsigned long long cache_config(unsigned long long cache, unsigned long long operation,
+                                unsigned long long result) {
+    return cache | (operation << 8) | (result << 16);
+}
+} // namespace
+
+PerfCounters::PerfCounters() {
+    const unsigned int types[num_counters] = {PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+                                              PERF_TYPE_HARDWARE};
+    const unsigned long long configs[num_counters] = {
+        cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                     PERF_COUNT_HW_CACHE_RESULT_MISS),
+        cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ,
+                     PERF_COUNT_HW_CACHE_RESULT_MISS),
+        PERF_COUNT_HW_INSTRUCTIONS};
+    for (unsigned int counter = 0; counter < num_counters; counter++) {
+        file_descriptors[counter] = open_counter(types[counter], configs[counter]);
+        if (file_descriptors[counter] < 0 && error.empty()) {
+            error = std::string("perf_event_open for ") + counter_name(counter)
+                    + " failed: " + std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int file_descriptor : file_descriptors) {
+        if (file_descriptor >= 0) {
+            close(file_descriptor);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (int file_descriptor : file_descriptors) {
+        if (file_descriptor >= 0) {
+            ioctl(file_descriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(file_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+PerfCounters::counts PerfCounters::stop() {
+    counts result;
+    for (unsigned int counter = 0; counter < num_counters; counter++) {
+        int file_descriptor = file_descriptors[counter];
+        if (file_descriptor < 0) {
+            continue;
+        }
+        ioctl(file_descriptor, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(file_descriptor, &result.values[counter], sizeof(result.values[counter]))
+            != sizeof(result.values[counter])) {
+            result.values[counter] = 0;
+        }
+    }
+    return result;
+}
+
+const char *PerfCounters::counter_name(unsigned int counter) {
+    switch (counter) {
+        case l1d_read_misses:
+            return "l1d read misses";
+        case llc_misses:
+            return "llc read misses";
+        case instructions:
+            return "instructions";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+// hardware cache counters of the calling thread through perf_event_open, for benchmarks; many
+// virtual machines and containers expose no such counters, in which case is_available is false
+// and get_error tells why
+class PerfCounters {
+    public:
+        enum counter_indices { l1d_read_misses, llc_misses, instructions, num_counters };
+
+        struct counts {
+            public:
+                unsigned long long values[num_counters] = {};
+        };
+
+    private:
+        int file_descriptors[num_counters];
+        std::string error;
+
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        bool is_available() const {
+            return error.empty();
+        }
+
+        const std::string &get_error() const {
+            return error;
+        }
+
+        // resets the counters and starts counting
+        void start();
+
+        // stops counting and returns the counts since start
+        counts stop();
+
+        static const char *counter_name(unsigned int counter);
+};
@@ -0,0 +1,78 @@
+#include "PositionBasedKernels.hpp"
+
+#include <cmath>
+
+void predict_rows(const StepContext &context, unsigned int y_begin, unsigned int y_end) {
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        if (y == 0) {
+            update_top_row(context);
+            continue;
+        }
+        for (unsigned int i = y * context.row_length; i < (y + 1) * context.row_length; i++) {
+            context.velocity_y[i] -= context.gravity_strength * context.delta_time;
+            context.next_x[i] = context.current_x[i] + context.velocity_x[i] * context.delta_time;
+            context.next_y[i] = context.current_y[i] + context.velocity_y[i] * context.delta_time;
+            context.next_z[i] = context.current_z[i] + context.velocity_z[i] * context.delta_time;
+        }
+    }
+}
+
+void project_rows(const StepContext &context, const float *const source[3],
+                  float *const target[3], float relaxation, unsigned int y_begin,
+                  unsigned int y_end) {
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        for (unsigned int i = y * context.row_length; i < (y + 1) * context.row_length; i++) {
+            unsigned int constraint_begin = context.constraint_offsets[i];
+            unsigned int constraint_end = context.constraint_offsets[i + 1];
+            if (constraint_begin == constraint_end) {
+                target[0][i] = source[0][i];
+                target[1][i] = source[1][i];
+                target[2][i] = source[2][i];
+                continue;
+            }
+
+            float correction_x = 0;
+            float correction_y = 0;
+            float correction_z = 0;
+            for (unsigned int constraint = constraint_begin; constraint < constraint_end;
+                 constraint++) {
+                unsigned int other_index = context.constraint_neighbours[constraint];
+                float diff_x = source[0][i] - source[0][other_index];
+                float diff_y = source[1][i] - source[1][other_index];
+                float diff_z = source[2][i] - source[2][other_index];
+                float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z);
+                if (distance == 0) {
+                    continue;
+                }
+                // a pinned neighbour takes none of the correction, a free one half of it
+                float share = other_index < context.row_length ? 1.0f : 0.5f;
+                float factor =
+                    share * (context.constraint_rest_lengths[constraint] - distance) / distance;
+                correction_x += diff_x * factor;
+                correction_y += diff_y * factor;
+                correction_z += diff_z * factor;
+            }
+
+            // averaging over the springs keeps the jacobi iteration from overshooting
+            float scale = relaxation / (constraint_end - constraint_begin);
+            target[0][i] = source[0][i] + correction_x * scale;
+            target[1][i] = source[1][i] + correction_y * scale;
+            target[2][i] = source[2][i] + correction_z * scale;
+        }
+    }
+}
+
+void update_velocity_rows(const StepContext &context, float vertical_damping,
+                          unsigned int y_begin, unsigned int y_end) {
+    for (unsigned int y = y_begin; y < y_end; y++) {
+        if (y == 0) {
+            continue;
+        }
+        for (unsigned int i = y * context.row_length; i < (y + 1) * context.row_length; i++) {
+            context.velocity_x[i] = (context.next_x[i] - context.current_x[i]) / context.delta_time;
+            context.velocity_y[i] = (context.next_y[i] - context.current_y[i]) / context.delta_time
+                                    * vertical_damping;
+            context.velocity_z[i] = (context.next_z[i] - context.current_z[i]) / context.delta_time;
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "ClothKernels.hpp"
+
+// jacobi style position based dynamics over the same buffers as the explicit update: positions
+// are predicted into the next buffer and the springs are projected as distance constraints, so
+// the step stays stable for any delta time
+
+// rotates the top row like update_top_row and predicts every other vertex from its velocity
+void predict_rows(const StepContext &context, unsigned int y_begin, unsigned int y_end);
+
+// one constraint iteration, reading the positions of source and writing target; the top row is
+// pinned and only copied
+void project_rows(const StepContext &context, const float *const source[3],
+                  float *const target[3], float relaxation, unsigned int y_begin,
+                  unsigned int y_end);
+
+// derives the velocities from the projected next positions and damps their vertical part by
+// vertical_damping
+void update_velocity_rows(const StepContext &context, float vertical_damping,
+                          unsigned int y_begin, unsigned int y_end);
@@ -0,0 +1,201 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+bool is_gpu_pass(unsigned int pass) {
+    return pass < profile_cpu_step;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point time_point) {
+    return std::chrono::duration<double>{std::chrono::steady_clock::now() - time_point}.count();
+}
+} // namespace
+
+const char *profile_pass_name(unsigned int pass) {
+    const char *names[] = {"simulation", "normals", "upload",   "shadows", "cloth",
+                           "ground",     "swap",    "cpu_step", "frame"};
+    return pass < num_profile_passes ? names[pass] : "unknown";
+}
+
+Profiler::~Profiler() {
+    // without a gl context only the samples already in the ring can be written
+    if (writer.joinable()) {
+        stopping = true;
+        writer.join();
+    }
+}
+
+void Profiler::begin_frame() {
+    if (requested_enabled && !writer.joinable()) {
+        output.open(path);
+        if (!output) {
+            throw std::runtime_error("could not open profile " + path);
+        }
+        writer = std::thread(&Profiler::write_loop, this);
+
+        // llvmpipe measures the first elapsed time query around rendering work from an
+        // arbitrary origin, so a throwaway one goes first; the frame clears the screen anyway
+        GLuint query;
+        glGenQueries(1, &query);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 nanoseconds;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        glDeleteQueries(1, &query);
+    }
+
+    // the slot about to be reused holds the frame from frame_latency frames ago
+    frame_record &record = frames[frame % frame_latency];
+    if (record.pending) {
+        collect(record);
+    }
+    active = requested_enabled;
+    if (!active) {
+        return;
+    }
+    record.frame = frame;
+    record.queries.clear();
+    std::fill(std::begin(record.cpu_seconds), std::end(record.cpu_seconds), 0.0);
+    std::fill(std::begin(record.counts), std::end(record.counts), 0);
+    frame_start = std::chrono::steady_clock::now();
+}
+
+void Profiler::end_frame() {
+    if (!active) {
+        return;
+    }
+    frame_record &record = frames[frame % frame_latency];
+    record.cpu_seconds[profile_frame] = seconds_since(frame_start);
+    record.counts[profile_frame] = 1;
+    record.pending = true;
+    active = false;
+    frame++;
+}
+
+void Profiler::begin_pass(unsigned int pass) {
+    pass_starts[pass] = std::chrono::steady_clock::now();
+    if (!is_gpu_pass(pass)) {
+        return;
+    }
+    frame_record &record = frames[frame % frame_latency];
+    if (record.queries.size() == record.query_pool.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        record.query_pool.push_back(query);
+    }
+    GLuint query = record.query_pool[record.queries.size()];
+    record.queries.push_back({pass, query});
+    glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void Profiler::end_pass(unsigned int pass) {
+    if (is_gpu_pass(pass)) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    frame_record &record = frames[frame % frame_latency];
+    record.cpu_seconds[pass] += seconds_since(pass_starts[pass]);
+    record.counts[pass]++;
+}
+
+void Profiler::collect(frame_record &record) {
+    record.pending = false;
+
+    // queries finish in order, but checking each one keeps this from ever blocking
+    bool available = true;
+    for (const query_record &query : record.queries) {
+        GLuint query_available = GL_FALSE;
+        glGetQueryObjectuiv(query.query, GL_QUERY_RESULT_AVAILABLE, &query_available);
+        if (!query_available) {
+            available = false;
+            break;
+        }
+    }
+    if (!available) {
+        late_frames++;
+    }
+
+    double gpu_seconds[num_profile_passes] = {};
+    if (available) {
+        for (const query_record &query : record.queries) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+            gpu_seconds[query.pass] += nanoseconds * 1e-9;
+        }
+    }
+
+    for (unsigned int pass = 0; pass < num_profile_passes; pass++) {
+        if (record.counts[pass] == 0) {
+            continue;
+        }
+        ProfileSample sample;
+        sample.frame = record.frame;
+        sample.pass = pass;
+        sample.count = record.counts[pass];
+        sample.cpu_seconds = record.cpu_seconds[pass];
+        sample.gpu_seconds = is_gpu_pass(pass) && available ? gpu_seconds[pass] : -1;
+        if (!ring.push(sample)) {
+            dropped_samples++;
+        }
+    }
+}
+
+void Profiler::write_loop() {
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    output << (json ? "[" : "frame,pass,count,cpu_seconds,gpu_seconds\n");
+
+    bool first = true;
+    while (true) {
+        // read before draining, so nothing pushed before stop is missed
+        bool stop_requested = stopping;
+        ProfileSample sample;
+        while (ring.pop(sample)) {
+            if (json) {
+                output << (first ? "\n" : ",\n") << "{\"frame\": " << sample.frame
+                       << ", \"pass\": \"" << profile_pass_name(sample.pass)
+                       << "\", \"count\": " << sample.count
+                       << ", \"cpu_seconds\": " << sample.cpu_seconds << ", \"gpu_seconds\": ";
+                if (sample.gpu_seconds < 0) {
+                    output << "null}";
+                } else {
+                    output << sample.gpu_seconds << "}";
+                }
+            } else {
+                output << sample.frame << "," << profile_pass_name(sample.pass) << ","
+                       << sample.count << "," << sample.cpu_seconds << ",";
+                if (sample.gpu_seconds >= 0) {
+                    output << sample.gpu_seconds;
+                }
+                output << "\n";
+            }
+            first = false;
+            written_samples++;
+        }
+        if (stop_requested) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (json) {
+        output << "\n]\n";
+    }
+    output.close();
+}
+
+void Profiler::stop() {
+    if (!writer.joinable()) {
+        return;
+    }
+    // the last frames are still on the gpu; waiting for them is fine once rendering is over
+    glFinish();
+    for (unsigned int i = 0; i < frame_latency; i++) {
+        frame_record &record = frames[(frame + i) % frame_latency];
+        if (record.pending) {
+            collect(record);
+        }
+    }
+    stopping = true;
+    writer.join();
+}
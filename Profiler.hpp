@@ -0,0 +1,184 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum profile_passes {
+    profile_simulation,
+    profile_normals,
+    profile_upload,
+    profile_shadows,
+    profile_cloth,
+    profile_ground,
+    profile_swap,
+    // cpu only: a step of ClothSolver and the whole frame
+    profile_cpu_step,
+    profile_frame,
+    num_profile_passes
+};
+
+const char *profile_pass_name(unsigned int pass);
+
+// timings of one pass in one frame, summed over every time the pass ran
+struct ProfileSample {
+        unsigned long long frame;
+        unsigned int pass;
+        unsigned int count;
+        double cpu_seconds;
+        // negative when the gpu had not finished the frame by the time it was collected
+        double gpu_seconds;
+};
+
+// single producer, single consumer queue without locks; capacity must be a power of two
+template <typename T, std::size_t capacity> class SampleRing {
+    private:
+        static_assert((capacity & (capacity - 1)) == 0);
+
+        std::array<T, capacity> items;
+        // head is only written by the consumer, tail only by the producer
+        alignas(64) std::atomic<std::size_t> head = 0;
+        alignas(64) std::atomic<std::size_t> tail = 0;
+
+    public:
+        // false when the ring is full
+        bool push(const T &item) {
+            std::size_t current_tail = tail.load(std::memory_order_relaxed);
+            if (current_tail - head.load(std::memory_order_acquire) == capacity) {
+                return false;
+            }
+            items[current_tail % capacity] = item;
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // false when the ring is empty
+        bool pop(T &item) {
+            std::size_t current_head = head.load(std::memory_order_relaxed);
+            if (current_head == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[current_head % capacity];
+            head.store(current_head + 1, std::memory_order_release);
+            return true;
+        }
+};
+
+// cpu timers and GL_TIME_ELAPSED queries per pass; the queries of a frame are read back
+// frame_latency frames later, so the render thread never waits for the gpu, and the samples go
+// through a ring to a background thread that writes them as csv, or as json if the path ends
+// in .json
+class Profiler {
+    public:
+        static constexpr unsigned int frame_latency = 4;
+
+        // times a pass for as long as it lives; costs a single check while profiling is off
+        class scope {
+            private:
+                Profiler *profiler;
+                unsigned int pass;
+
+            public:
+                scope(Profiler *profiler, unsigned int pass)
+                    : profiler(profiler && profiler->active ? profiler : nullptr), pass(pass) {
+                    if (this->profiler) {
+                        this->profiler->begin_pass(pass);
+                    }
+                }
+
+                ~scope() {
+                    if (profiler) {
+                        profiler->end_pass(pass);
+                    }
+                }
+
+                scope(const scope &) = delete;
+                scope &operator=(const scope &) = delete;
+        };
+
+    private:
+        struct query_record {
+            public:
+                unsigned int pass;
+                GLuint query;
+        };
+
+        struct frame_record {
+            public:
+                unsigned long long frame = 0;
+                bool pending = false;
+                std::vector<query_record> queries;
+                // query objects created for this slot, reused every time it comes around
+                std::vector<GLuint> query_pool;
+                double cpu_seconds[num_profile_passes] = {};
+                unsigned int counts[num_profile_passes] = {};
+        };
+
+        std::string path;
+        std::ofstream output;
+        bool requested_enabled = false;
+        // between begin_frame and end_frame of an enabled frame
+        bool active = false;
+
+        unsigned long long frame = 0;
+        frame_record frames[frame_latency];
+        std::chrono::steady_clock::time_point frame_start;
+        std::chrono::steady_clock::time_point pass_starts[num_profile_passes];
+
+        SampleRing<ProfileSample, 4096> ring;
+        std::atomic<unsigned long long> dropped_samples = 0;
+        unsigned long long late_frames = 0;
+
+        std::thread writer;
+        std::atomic<bool> stopping = false;
+        std::atomic<unsigned long long> written_samples = 0;
+
+        void begin_pass(unsigned int pass);
+        void end_pass(unsigned int pass);
+        // turns the finished frame of a slot into samples
+        void collect(frame_record &record);
+        void write_loop();
+
+    public:
+        explicit Profiler(const std::string &path) : path(path) {}
+        ~Profiler();
+
+        Profiler(const Profiler &) = delete;
+        Profiler &operator=(const Profiler &) = delete;
+
+        // takes effect at the next begin_frame, so a frame is never half profiled
+        void set_enabled(bool is_enabled) {
+            requested_enabled = is_enabled;
+        }
+
+        bool is_enabled() const {
+            return requested_enabled;
+        }
+
+        void begin_frame();
+        void end_frame();
+
+        // waits for the outstanding frames and the writer and closes the file; needs the gl
+        // context, so it has to be called before the window is destroyed
+        void stop();
+
+        unsigned long long get_written_samples() const {
+            return written_samples;
+        }
+
+        // samples lost because the writer fell behind
+        unsigned long long get_dropped_samples() const {
+            return dropped_samples;
+        }
+
+        // frames whose gpu time was not ready frame_latency frames later
+        unsigned long long get_late_frames() const {
+            return late_frames;
+        }
+};
@@ -0,0 +1,199 @@
+#include "ShaderCache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace {
+constexpr char cache_entry_magic[8] = {'C', 'L', 'O', 'T', 'H', 'P', 'R', 'G'};
+// part of every key, so entries of an older layout are never even opened
+constexpr std::uint32_t cache_entry_version = 1;
+
+struct cache_entry_header {
+    public:
+        char magic[8];
+        std::uint32_t version;
+        // as glGetProgramBinary returned it
+        std::uint32_t binary_format;
+        // guards against a file renamed to another key
+        std::uint64_t key;
+        std::uint64_t binary_size;
+};
+
+static_assert(sizeof(cache_entry_header) == 32);
+
+constexpr std::uint64_t fnv_offset_basis = 0xcbf29ce484222325;
+constexpr std::uint64_t fnv_prime = 0x100000001b3;
+
+std::uint64_t fnv1a(std::uint64_t hash, const void *data, std::size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+
+// with its length first, so no two lists of strings hash the same bytes
+std::uint64_t fnv1a(std::uint64_t hash, const std::string &text) {
+    std::uint64_t size = text.size();
+    hash = fnv1a(hash, &size, sizeof(size));
+    return fnv1a(hash, text.data(), text.size());
+}
+
+GLuint create_shader(GLenum type, const char *source, const std::string &shader_name_str) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char info_log_buffer[512];
+        glGetShaderInfoLog(shader, 512, nullptr, info_log_buffer);
+        std::stringstream stream;
+        stream << "error compiling " << shader_name_str << ": " << info_log_buffer;
+        throw std::runtime_error(stream.str());
+    }
+    return shader;
+}
+
+void link_program(GLuint program, const std::string &program_name_str) {
+
+    glLinkProgram(program);
+
+    {
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char info_log_buffer[512];
+            glGetProgramInfoLog(program, 512, nullptr, info_log_buffer);
+            std::stringstream stream;
+            stream << "error linking program " << program_name_str << ": " << info_log_buffer;
+            throw std::runtime_error(stream.str());
+        }
+    }
+}
+} // namespace
+
+std::uint64_t ShaderCache::get_key(const std::vector<shader_stage> &stages) const {
+    std::uint64_t hash =
+        fnv1a(fnv_offset_basis, &cache_entry_version, sizeof(cache_entry_version));
+    hash = fnv1a(hash, driver);
+    for (const shader_stage &stage : stages) {
+        std::uint32_t type = stage.type;
+        hash = fnv1a(hash, &type, sizeof(type));
+        hash = fnv1a(hash, stage.source);
+    }
+    return hash;
+}
+
+std::string ShaderCache::get_entry_path(std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool ShaderCache::load(GLuint program, std::uint64_t key) const {
+    std::ifstream file(get_entry_path(key), std::ios::binary);
+    cache_entry_header header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, cache_entry_magic, sizeof(header.magic)) != 0
+        || header.version != cache_entry_version || header.key != key
+        || header.binary_size > static_cast<std::uint64_t>(1) << 30) {
+        return false;
+    }
+    std::vector<char> binary(header.binary_size);
+    if (!file.read(binary.data(), binary.size())) {
+        return false;
+    }
+
+    glProgramBinary(program, header.binary_format, binary.data(), binary.size());
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+void ShaderCache::store(GLuint program, std::uint64_t key) const {
+    GLint binary_size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0) {
+        return;
+    }
+    std::vector<char> binary(binary_size);
+    GLsizei written_size = 0;
+    GLenum binary_format = 0;
+    glGetProgramBinary(program, binary_size, &written_size, &binary_format, binary.data());
+
+    cache_entry_header header = {};
+    std::memcpy(header.magic, cache_entry_magic, sizeof(header.magic));
+    header.version = cache_entry_version;
+    header.binary_format = binary_format;
+    header.key = key;
+    header.binary_size = written_size;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = get_entry_path(key);
+    std::string temporary_path = path + "." + std::to_string(::getpid()) + ".tmp";
+    std::ofstream file(temporary_path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(binary.data(), written_size);
+    file.close();
+    if (!file) {
+        std::filesystem::remove(temporary_path, error);
+        return;
+    }
+    std::filesystem::rename(temporary_path, path, error);
+}
+
+GLuint ShaderCache::build_program(const std::vector<shader_stage> &stages,
+                                  const std::string &name) {
+    auto start = std::chrono::steady_clock::now();
+    if (!directory.empty() && driver.empty()) {
+        for (GLenum string : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            driver += reinterpret_cast<const char *>(glGetString(string));
+            driver += '\n';
+        }
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        has_binary_formats = format_count > 0;
+    }
+    bool cached = !directory.empty() && has_binary_formats;
+    std::uint64_t key = cached ? get_key(stages) : 0;
+
+    GLuint program = glCreateProgram();
+    if (cached && load(program, key)) {
+        loaded_count++;
+    } else {
+        // a rejected binary may leave the program in any state
+        glDeleteProgram(program);
+        program = glCreateProgram();
+        if (cached) {
+            // the binary can only be retrieved if this is set before linking
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        std::vector<GLuint> shaders;
+        for (const shader_stage &stage : stages) {
+            shaders.push_back(create_shader(stage.type, stage.source.c_str(), stage.name));
+            glAttachShader(program, shaders.back());
+        }
+        link_program(program, name);
+        for (GLuint shader : shaders) {
+            glDeleteShader(shader);
+        }
+        compiled_count++;
+        if (cached) {
+            store(program, key);
+        }
+    }
+
+    build_seconds +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return program;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one shader of a program, as glShaderSource takes it
+struct shader_stage {
+    public:
+        GLenum type;
+        std::string source;
+        // in compile errors
+        std::string name;
+};
+
+// keeps linked programs on disk as glGetProgramBinary returns them, one file per program named
+// after an fnv-1a hash of its sources and of the vendor, renderer and version strings of the
+// driver; the grid size and state format are defines in the sources, so every variant gets its
+// own entry
+//
+// a program without an entry, with a damaged entry or with one the driver rejects, e.g. after an
+// update that kept the version string, is compiled and linked as without the cache and its
+// entry is written anew; nothing is cached while the directory is empty or the driver offers no
+// binary formats
+class ShaderCache {
+    private:
+        std::string directory;
+        // hashed into every key; read with the first program, since it needs a context
+        std::string driver;
+        bool has_binary_formats = false;
+
+        unsigned int loaded_count = 0;
+        unsigned int compiled_count = 0;
+        // wall seconds spent in build_program
+        double build_seconds = 0;
+
+        std::uint64_t get_key(const std::vector<shader_stage> &stages) const;
+        std::string get_entry_path(std::uint64_t key) const;
+        // false if the entry is missing, damaged or rejected
+        bool load(GLuint program, std::uint64_t key) const;
+        // written to a temporary file first, so processes starting at the same time never read
+        // half an entry; errors are ignored, the program is still usable
+        void store(GLuint program, std::uint64_t key) const;
+
+    public:
+        ShaderCache() = default;
+
+        // created if it does not exist, when the first program is built
+        explicit ShaderCache(const std::string &directory) : directory(directory) {}
+
+        const std::string &get_directory() const {
+            return directory;
+        }
+
+        // the linked program; throws with the log of the stage or program that failed
+        GLuint build_program(const std::vector<shader_stage> &stages, const std::string &name);
+
+        unsigned int get_loaded_count() const {
+            return loaded_count;
+        }
+
+        unsigned int get_compiled_count() const {
+            return compiled_count;
+        }
+
+        double get_build_seconds() const {
+            return build_seconds;
+        }
+};
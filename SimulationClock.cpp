@@ -0,0 +1,39 @@
+#include "SimulationClock.hpp"
+
+#include <chrono>
+#include <cmath>
+
+unsigned int SimulationClock::advance(float elapsed_seconds,
+                                      const std::function<void(float)> &step) {
+    accumulator += elapsed_seconds;
+
+    auto start_time_point = std::chrono::steady_clock::now();
+    unsigned int substeps = 0;
+    while (accumulator >= settings.fixed_delta_time) {
+        if (substeps == settings.max_substeps) {
+            break;
+        }
+        // the first step is always taken so the simulation keeps moving under load
+        float spent_seconds =
+            std::chrono::duration<float>{std::chrono::steady_clock::now() - start_time_point}
+                .count();
+        if (substeps > 0 && spent_seconds >= settings.catch_up_budget) {
+            break;
+        }
+        step(settings.fixed_delta_time);
+        accumulator -= settings.fixed_delta_time;
+        substeps++;
+    }
+
+    // whatever is left beyond a single step could only be caught up by exceeding the limits
+    if (accumulator >= settings.fixed_delta_time) {
+        float kept = std::fmod(accumulator, settings.fixed_delta_time);
+        dropped_time += accumulator - kept;
+        frames_with_dropped_time++;
+        accumulator = kept;
+    }
+
+    substeps_taken += substeps;
+    last_frame_substeps = substeps;
+    return substeps;
+}
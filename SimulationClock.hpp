@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <functional>
+
+struct SimulationClockSettings {
+        // simulated seconds per step
+        float fixed_delta_time = 0.01f;
+        // steps a single frame may take before the remaining time is dropped
+        unsigned int max_substeps = 8;
+        // wall seconds a single frame may spend stepping before the remaining time is dropped
+        float catch_up_budget = 0.02f;
+};
+
+// turns variable frame times into fixed steps, so a slow frame never becomes one huge step
+class SimulationClock {
+    private:
+        SimulationClockSettings settings;
+        float accumulator = 0;
+
+        unsigned long long substeps_taken = 0;
+        unsigned int last_frame_substeps = 0;
+        double dropped_time = 0;
+        unsigned long long frames_with_dropped_time = 0;
+
+    public:
+        // a step of 0 is never caught up with and a negative one runs the simulation backwards,
+        // so the command lines reject both before they get here
+        explicit SimulationClock(const SimulationClockSettings &settings = {})
+            : settings(settings) {
+            assert(settings.fixed_delta_time > 0 && std::isfinite(settings.fixed_delta_time));
+            assert(settings.max_substeps >= 1);
+        }
+
+        // adds the elapsed wall time and calls step(fixed_delta_time) for every whole step that
+        // fits, within the substep and catch-up limits; returns the number of steps taken
+        unsigned int advance(float elapsed_seconds, const std::function<void(float)> &step);
+
+        // fraction of a step between the previous and the current state that the rendered
+        // frame corresponds to
+        float get_interpolation() const {
+            return accumulator / settings.fixed_delta_time;
+        }
+
+        const SimulationClockSettings &get_settings() const {
+            return settings;
+        }
+
+        unsigned long long get_substeps_taken() const {
+            return substeps_taken;
+        }
+
+        unsigned int get_last_frame_substeps() const {
+            return last_frame_substeps;
+        }
+
+        // simulated seconds skipped because a frame hit one of the limits
+        double get_dropped_time() const {
+            return dropped_time;
+        }
+
+        unsigned long long get_frames_with_dropped_time() const {
+            return frames_with_dropped_time;
+        }
+};
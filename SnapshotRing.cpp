@@ -0,0 +1,101 @@
+#include "SnapshotRing.hpp"
+
+#include <stdexcept>
+
+SnapshotRing::SnapshotRing(unsigned int slot_count)
+    : slot_count(slot_count), slots(std::make_unique<slot[]>(slot_count)) {
+    // one slot being drawn, one being written and one to hand over
+    if (slot_count < 3) {
+        throw std::runtime_error("a snapshot ring needs at least 3 slots");
+    }
+}
+
+int SnapshotRing::find_ready(bool newest, unsigned long long &tag) const {
+    int found = -1;
+    for (unsigned int i = 0; i < slot_count; i++) {
+        unsigned long long slot_tag = slots[i].tag.load(std::memory_order_acquire);
+        if (get_state(slot_tag) != slot_ready) {
+            continue;
+        }
+        // equal states, so the tags compare as the sequences do
+        if (found < 0 || (newest ? slot_tag > tag : slot_tag < tag)) {
+            found = i;
+            tag = slot_tag;
+        }
+    }
+    return found;
+}
+
+int SnapshotRing::begin_write() {
+    while (true) {
+        // only the producer takes a slot out of the free state, so a free slot stays free
+        for (unsigned int i = 0; i < slot_count; i++) {
+            unsigned long long tag = slots[i].tag.load(std::memory_order_acquire);
+            if (get_state(tag) == slot_free) {
+                slots[i].tag.store(with_state(tag, slot_writing), std::memory_order_relaxed);
+                return i;
+            }
+        }
+        unsigned long long tag;
+        int oldest = find_ready(false, tag);
+        if (oldest < 0) {
+            full_count.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        // the consumer may take or free the slot at the same time, then the search starts over
+        if (slots[oldest].tag.compare_exchange_strong(tag, with_state(tag, slot_writing),
+                                                      std::memory_order_acquire)) {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return oldest;
+        }
+    }
+}
+
+void SnapshotRing::end_write(unsigned int slot, float frame_angle) {
+    slots[slot].frame_angle = frame_angle;
+    slots[slot].tag.store(next_sequence++ << 2 | slot_ready, std::memory_order_release);
+    published_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+int SnapshotRing::take_newest() {
+    int newest;
+    unsigned long long newest_tag;
+    while (true) {
+        newest = find_ready(true, newest_tag);
+        if (newest < 0) {
+            return -1;
+        }
+        // the producer may take the slot back at the same time
+        if (slots[newest].tag.compare_exchange_strong(
+                newest_tag, with_state(newest_tag, slot_reading), std::memory_order_acquire)) {
+            break;
+        }
+    }
+    taken_count.fetch_add(1, std::memory_order_relaxed);
+
+    // a slot republished in the meantime is newer and fails the exchange
+    for (unsigned int i = 0; i < slot_count; i++) {
+        unsigned long long tag = slots[i].tag.load(std::memory_order_relaxed);
+        if (get_state(tag) == slot_ready && tag < newest_tag
+            && slots[i].tag.compare_exchange_strong(tag, with_state(tag, slot_free),
+                                                    std::memory_order_relaxed)) {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return newest;
+}
+
+void SnapshotRing::release(unsigned int slot) {
+    unsigned long long tag = slots[slot].tag.load(std::memory_order_relaxed);
+    slots[slot].tag.store(with_state(tag, slot_free), std::memory_order_release);
+}
+
+unsigned int SnapshotRing::get_ready_count() const {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < slot_count; i++) {
+        if (get_state(slots[i].tag.load(std::memory_order_relaxed)) == slot_ready) {
+            count++;
+        }
+    }
+    return count;
+}
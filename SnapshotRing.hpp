@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// hands snapshots of the simulated state from a single producer thread to a single consumer
+// thread through a fixed number of slots, without locks and without copying; the ring only
+// tracks which slot is in which state, the slot memory itself lives elsewhere, e.g. in
+// persistently mapped buffers of the painter
+//
+// the producer writes into a free slot and publishes it; the consumer always takes the newest
+// published slot, and every older published slot that was never taken counts as dropped; when
+// the consumer falls behind and no slot is free, the producer takes back the oldest published
+// slot instead of waiting
+class SnapshotRing {
+    public:
+        enum slot_state { slot_free, slot_writing, slot_ready, slot_reading, num_slot_states };
+
+    private:
+        struct slot {
+            public:
+                // the sequence of the last publish, increasing from 1, shifted left by 2 over
+                // the slot_state; a single word, so nobody moves a slot that was republished
+                // since they looked at it
+                std::atomic<unsigned long long> tag = slot_free;
+                // written before the slot is published, read only while taken
+                float frame_angle = 0;
+        };
+
+        unsigned int slot_count;
+        std::unique_ptr<slot[]> slots;
+        // producer only
+        unsigned long long next_sequence = 1;
+
+        std::atomic<unsigned long long> published_count = 0;
+        std::atomic<unsigned long long> taken_count = 0;
+        // published but never taken, by either side
+        std::atomic<unsigned long long> dropped_count = 0;
+        // begin_write calls that found every slot written, taken or still being drawn
+        std::atomic<unsigned long long> full_count = 0;
+
+        static unsigned int get_state(unsigned long long tag) {
+            return tag & 3;
+        }
+
+        static unsigned long long with_state(unsigned long long tag, unsigned int state) {
+            return (tag & ~3ull) | state;
+        }
+
+        // of the published slot with the lowest or highest sequence, or -1 if there is none;
+        // tag is set to the tag it was found with
+        int find_ready(bool newest, unsigned long long &tag) const;
+
+    public:
+        explicit SnapshotRing(unsigned int slot_count);
+
+        SnapshotRing(const SnapshotRing &) = delete;
+        SnapshotRing &operator=(const SnapshotRing &) = delete;
+
+        unsigned int get_slot_count() const {
+            return slot_count;
+        }
+
+        // producer: a slot to write the next snapshot into, or -1 if none can be had
+        int begin_write();
+        // producer: makes the written slot the newest snapshot
+        void end_write(unsigned int slot, float frame_angle);
+
+        // consumer: takes the newest snapshot and frees the older ones, or returns -1 if nothing
+        // was published since the last call; the slot stays taken until it is released
+        int take_newest();
+        // consumer: only once nothing reads the slot anymore, e.g. after its draws finished
+        void release(unsigned int slot);
+
+        // of a taken slot
+        float get_frame_angle(unsigned int slot) const {
+            return slots[slot].frame_angle;
+        }
+
+        // published snapshots waiting to be taken, the occupancy of the ring
+        unsigned int get_ready_count() const;
+
+        unsigned long long get_published_count() const {
+            return published_count.load(std::memory_order_relaxed);
+        }
+
+        unsigned long long get_taken_count() const {
+            return taken_count.load(std::memory_order_relaxed);
+        }
+
+        unsigned long long get_dropped_count() const {
+            return dropped_count.load(std::memory_order_relaxed);
+        }
+
+        unsigned long long get_full_count() const {
+            return full_count.load(std::memory_order_relaxed);
+        }
+};
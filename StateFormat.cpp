@@ -0,0 +1,217 @@
+#include "StateFormat.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+// rounds to the nearest half float, ties to even, as packHalf2x16 does on common drivers
+std::uint16_t float_to_half(float value) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+    std::uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+    if (bits >= (127u + 16) << 23) {
+        // too large for a half, infinity or nan
+        return sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if (bits < (127u - 14) << 23) {
+        // subnormal halves; adding the magic number lets the float unit do the rounding
+        constexpr std::uint32_t magic = (127u - 15 + 23 - 10 + 1) << 23;
+        float sum = std::bit_cast<float>(bits) + std::bit_cast<float>(magic);
+        return sign | (std::bit_cast<std::uint32_t>(sum) - magic);
+    }
+    std::uint32_t odd_mantissa = (bits >> 13) & 1;
+    bits += ((15u - 127) << 23) + 0xfff + odd_mantissa;
+    return sign | (bits >> 13);
+}
+
+float half_to_float(std::uint16_t half) {
+    std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1f;
+    std::uint32_t mantissa = half & 0x3ff;
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 0x1f) {
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+    }
+    return std::bit_cast<float>(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+std::uint16_t encode_component(state_format format, float offset, float scale) {
+    if (format == state_format_half) {
+        return float_to_half(offset);
+    }
+    if (!(scale > 0)) {
+        return 0;
+    }
+    // packSnorm2x16
+    float normalized = std::clamp(offset / scale, -1.0f, 1.0f);
+    auto code = static_cast<std::int16_t>(std::nearbyint(normalized * 32767));
+    return static_cast<std::uint16_t>(code);
+}
+
+float decode_component(state_format format, std::uint16_t code, float scale) {
+    if (format == state_format_half) {
+        return half_to_float(code);
+    }
+    // unpackSnorm2x16
+    return std::max(static_cast<std::int16_t>(code) / 32767.0f, -1.0f) * scale;
+}
+
+// the centre of the bounding box of vertices [begin, end) and its largest half extent, in the
+// order of operations of encode_tile in state_format_shader.hpp
+struct tile_box {
+    public:
+        float origin[3];
+        float scale;
+};
+
+tile_box measure_tile(const float *const components[3], unsigned int stride, unsigned int begin,
+                      unsigned int end) {
+    tile_box box;
+    box.scale = 0;
+    for (unsigned int k = 0; k < 3; k++) {
+        float low = components[k][static_cast<std::size_t>(begin) * stride];
+        float high = low;
+        for (unsigned int i = begin + 1; i < end; i++) {
+            float value = components[k][static_cast<std::size_t>(i) * stride];
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+        box.origin[k] = (low + high) * 0.5f;
+        box.scale = std::max(box.scale, (high - low) * 0.5f);
+    }
+    return box;
+}
+
+unsigned int get_tile_count(unsigned int vertex_count) {
+    return (vertex_count + state_tile_size - 1) / state_tile_size;
+}
+} // namespace
+
+const char *state_format_name(state_format format) {
+    switch (format) {
+        case state_format_float4:
+            return "float4";
+        case state_format_float3:
+            return "float3";
+        case state_format_half:
+            return "half";
+        case state_format_fixed:
+            return "fixed";
+        default:
+            return "unknown";
+    }
+}
+
+bool parse_state_format(std::string_view name, state_format &format) {
+    for (unsigned int i = 0; i < num_state_formats; i++) {
+        if (name == state_format_name(static_cast<state_format>(i))) {
+            format = static_cast<state_format>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t get_state_buffer_size(state_format format, unsigned int vertex_count) {
+    switch (format) {
+        case state_format_float4:
+            return static_cast<std::size_t>(vertex_count) * 4 * sizeof(float);
+        case state_format_float3:
+            return static_cast<std::size_t>(vertex_count) * 3 * sizeof(float);
+        default:
+            return static_cast<std::size_t>(get_tile_count(vertex_count)) * state_tile_words
+                   * sizeof(std::uint32_t);
+    }
+}
+
+void encode_state(state_format format, const float *x, const float *y, const float *z,
+                  unsigned int stride, unsigned int vertex_count, float w,
+                  std::vector<std::uint32_t> &words) {
+    words.assign(get_state_buffer_size(format, vertex_count) / sizeof(std::uint32_t), 0);
+    const float *const components[3] = {x, y, z};
+    if (format == state_format_float4 || format == state_format_float3) {
+        unsigned int width = format == state_format_float4 ? 4 : 3;
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            for (unsigned int k = 0; k < 3; k++) {
+                float value = components[k][static_cast<std::size_t>(i) * stride];
+                words[width * i + k] = std::bit_cast<std::uint32_t>(value);
+            }
+            if (width == 4) {
+                words[4 * i + 3] = std::bit_cast<std::uint32_t>(w);
+            }
+        }
+        return;
+    }
+
+    for (unsigned int tile = 0; tile < get_tile_count(vertex_count); tile++) {
+        unsigned int begin = tile * state_tile_size;
+        unsigned int end = std::min(begin + state_tile_size, vertex_count);
+        tile_box box = measure_tile(components, stride, begin, end);
+        std::uint32_t *tile_words = &words[static_cast<std::size_t>(tile) * state_tile_words];
+        for (unsigned int k = 0; k < 3; k++) {
+            tile_words[k] = std::bit_cast<std::uint32_t>(box.origin[k]);
+        }
+        tile_words[3] = std::bit_cast<std::uint32_t>(box.scale);
+        for (unsigned int i = begin; i < end; i++) {
+            for (unsigned int k = 0; k < 3; k++) {
+                float offset = components[k][static_cast<std::size_t>(i) * stride] - box.origin[k];
+                unsigned int code_index = 3 * (i - begin) + k;
+                tile_words[state_tile_header_words + code_index / 2] |=
+                    static_cast<std::uint32_t>(encode_component(format, offset, box.scale))
+                    << (16 * (code_index % 2));
+            }
+        }
+    }
+}
+
+void decode_state(state_format format, const std::uint32_t *words, unsigned int vertex_count,
+                  float *x, float *y, float *z, unsigned int stride) {
+    float *const components[3] = {x, y, z};
+    if (format == state_format_float4 || format == state_format_float3) {
+        unsigned int width = format == state_format_float4 ? 4 : 3;
+        for (unsigned int i = 0; i < vertex_count; i++) {
+            for (unsigned int k = 0; k < 3; k++) {
+                components[k][static_cast<std::size_t>(i) * stride] =
+                    std::bit_cast<float>(words[width * i + k]);
+            }
+        }
+        return;
+    }
+
+    for (unsigned int i = 0; i < vertex_count; i++) {
+        const std::uint32_t *tile_words =
+            &words[static_cast<std::size_t>(i / state_tile_size) * state_tile_words];
+        float scale = std::bit_cast<float>(tile_words[3]);
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int code_index = 3 * (i % state_tile_size) + k;
+            std::uint16_t code = static_cast<std::uint16_t>(
+                tile_words[state_tile_header_words + code_index / 2] >> (16 * (code_index % 2)));
+            components[k][static_cast<std::size_t>(i) * stride] =
+                std::bit_cast<float>(tile_words[k]) + decode_component(format, code, scale);
+        }
+    }
+}
+
+void round_trip_state(state_format format, float *x, float *y, float *z,
+                      unsigned int vertex_count) {
+    if (!is_state_format_lossy(format)) {
+        return;
+    }
+    float *const components[3] = {x, y, z};
+    for (unsigned int tile = 0; tile < get_tile_count(vertex_count); tile++) {
+        unsigned int begin = tile * state_tile_size;
+        unsigned int end = std::min(begin + state_tile_size, vertex_count);
+        tile_box box = measure_tile(components, 1, begin, end);
+        for (unsigned int k = 0; k < 3; k++) {
+            for (unsigned int i = begin; i < end; i++) {
+                std::uint16_t code =
+                    encode_component(format, components[k][i] - box.origin[k], box.scale);
+                components[k][i] = box.origin[k] + decode_component(format, code, box.scale);
+            }
+        }
+    }
+}
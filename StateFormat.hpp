@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// how the position and velocity buffers of the painter store a vertex; the passes compute in
+// float in every format, only the memory between them shrinks
+//
+// float4 holds x, y, z and an unused w, float3 leaves out w; half and fixed split the vertices
+// into tiles of state_tile_size and store each component in 16 bits, relative to the centre of
+// the bounding box of its tile: half as a half float, fixed as a signed normalized integer of
+// the largest half extent of the box, the scale of the tile
+enum state_format {
+    state_format_float4,
+    state_format_float3,
+    state_format_half,
+    state_format_fixed,
+    num_state_formats
+};
+
+// vertices per tile, the local size of the simulation shader, which writes a tile per work group
+constexpr unsigned int state_tile_size = 256;
+// 32-bit words of a tile: the centre and the scale, then the components two to a word
+constexpr unsigned int state_tile_header_words = 4;
+constexpr unsigned int state_tile_words = state_tile_header_words + state_tile_size * 3 / 2;
+
+const char *state_format_name(state_format format);
+
+// false for an unknown name
+bool parse_state_format(std::string_view name, state_format &format);
+
+// half and fixed round every stored value, float4 and float3 store it exactly
+inline bool is_state_format_lossy(state_format format) {
+    return format == state_format_half || format == state_format_fixed;
+}
+
+// of a buffer holding vertex_count vertices, the last tile included in full
+std::size_t get_state_buffer_size(state_format format, unsigned int vertex_count);
+
+// the words of a buffer holding vertex_count vertices, whose components are read from x, y and
+// z at every stride-th float; w goes into the fourth component of float4
+void encode_state(state_format format, const float *x, const float *y, const float *z,
+                  unsigned int stride, unsigned int vertex_count, float w,
+                  std::vector<std::uint32_t> &words);
+
+// the reverse of encode_state, as the shaders read the buffer; w is not written
+void decode_state(state_format format, const std::uint32_t *words, unsigned int vertex_count,
+                  float *x, float *y, float *z, unsigned int stride);
+
+// leaves vertices [0, vertex_count) as the shaders would read them back after storing them,
+// without building the buffer; does nothing for the exact formats
+void round_trip_state(state_format format, float *x, float *y, float *z,
+                      unsigned int vertex_count);
@@ -0,0 +1,112 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int thread_count) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+    for (unsigned int i = 0; i < thread_count; i++) {
+        queues.push_back(std::make_unique<task_queue>());
+    }
+    for (unsigned int i = 1; i < thread_count; i++) {
+        threads.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+bool ThreadPool::pop_task(unsigned int worker, unsigned int &task) {
+    {
+        task_queue &own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    // steal from the back of the other queues, starting with the next worker
+    for (unsigned int i = 1; i < queues.size(); i++) {
+        task_queue &victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned int worker) {
+    unsigned int task;
+    while (pop_task(worker, task)) {
+        (*current_task)(task);
+        if (remaining_tasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            work_finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::worker_loop(unsigned int worker) {
+    unsigned int seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+        }
+        work(worker);
+    }
+}
+
+void ThreadPool::run(unsigned int task_count, const std::function<void(unsigned int)> &task) {
+    if (task_count == 0) {
+        return;
+    }
+    if (threads.empty()) {
+        for (unsigned int i = 0; i < task_count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    // published before any task is queued, since workers still leaving the previous run may
+    // already pick up tasks of this one
+    current_task = &task;
+    remaining_tasks.store(task_count, std::memory_order_release);
+
+    // contiguous blocks per worker keep neighbouring rows on the same core
+    for (unsigned int worker = 0; worker < queues.size(); worker++) {
+        unsigned int begin = task_count * worker / queues.size();
+        unsigned int end = task_count * (worker + 1) / queues.size();
+        std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+        for (unsigned int i = begin; i < end; i++) {
+            queues[worker]->tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    work_available.notify_all();
+
+    work(0);
+
+    // the single barrier of the step
+    std::unique_lock<std::mutex> lock(mutex);
+    work_finished.wait(lock, [&] { return remaining_tasks.load(std::memory_order_acquire) == 0; });
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent pool of workers, each owning a queue of task indices that the others steal from
+// once their own queue runs dry; the calling thread takes part as worker 0
+class ThreadPool {
+    private:
+        struct task_queue {
+            public:
+                std::mutex mutex;
+                std::deque<unsigned int> tasks;
+        };
+
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<task_queue>> queues;
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::condition_variable work_finished;
+        unsigned int generation = 0;
+        bool stopping = false;
+
+        const std::function<void(unsigned int)> *current_task = nullptr;
+        std::atomic<unsigned int> remaining_tasks = 0;
+
+        bool pop_task(unsigned int worker, unsigned int &task);
+        void work(unsigned int worker);
+        void worker_loop(unsigned int worker);
+
+    public:
+        explicit ThreadPool(unsigned int thread_count);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        unsigned int get_thread_count() const {
+            return queues.size();
+        }
+
+        // runs task(i) for every i in [0, task_count) and returns once all of them finished
+        void run(unsigned int task_count, const std::function<void(unsigned int)> &task);
+};
@@ -0,0 +1,61 @@
+#include "TiledLayout.hpp"
+
+#include <algorithm>
+
+TiledLayout::TiledLayout(unsigned int row_length, unsigned int column_length,
+                         unsigned int tile_width)
+    : row_length(row_length), column_length(column_length) {
+    // tiles of nearly the same width, rather than a narrow one left over at the end
+    unsigned int width = std::max(tile_width, 1u);
+    unsigned int tile_count = (row_length + width - 1) / width;
+    unsigned int offset = 0;
+    for (unsigned int tile = 0; tile <= tile_count; tile++) {
+        tile_columns.push_back(row_length * tile / tile_count);
+        tile_offsets.push_back(offset);
+        if (tile < tile_count) {
+            offset += (row_length * (tile + 1) / tile_count - row_length * tile / tile_count + 2)
+                      * column_length;
+        }
+    }
+}
+
+void TiledLayout::scatter(const float *grid, float *tiled) const {
+    for (unsigned int tile = 0; tile < get_tile_count(); tile++) {
+        unsigned int stride = get_stride(tile);
+        for (unsigned int y = 0; y < column_length; y++) {
+            float *target = tiled + tile_offsets[tile] + y * stride;
+            const float *row = grid + y * row_length;
+            // the halo columns wrap around the seam
+            for (unsigned int column = 0; column < stride; column++) {
+                target[column] = row[(tile_columns[tile] + column + row_length - 1) % row_length];
+            }
+        }
+    }
+}
+
+void TiledLayout::gather(const float *tiled, float *grid) const {
+    for (unsigned int tile = 0; tile < get_tile_count(); tile++) {
+        unsigned int stride = get_stride(tile);
+        for (unsigned int y = 0; y < column_length; y++) {
+            const float *source = tiled + tile_offsets[tile] + y * stride + 1;
+            std::copy(source, source + stride - 2, grid + y * row_length + tile_columns[tile]);
+        }
+    }
+}
+
+void TiledLayout::exchange_halos(float *tiled, unsigned int y_begin, unsigned int y_end) const {
+    unsigned int tile_count = get_tile_count();
+    for (unsigned int tile = 0; tile < tile_count; tile++) {
+        unsigned int stride = get_stride(tile);
+        unsigned int left = (tile + tile_count - 1) % tile_count;
+        unsigned int right = (tile + 1) % tile_count;
+        unsigned int left_stride = get_stride(left);
+        unsigned int right_stride = get_stride(right);
+        for (unsigned int y = y_begin; y < y_end; y++) {
+            float *row = tiled + tile_offsets[tile] + y * stride;
+            // the last column of the tile on the left and the first of the one on the right
+            row[0] = tiled[tile_offsets[left] + y * left_stride + left_stride - 2];
+            row[stride - 1] = tiled[tile_offsets[right] + y * right_stride + 1];
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+enum storage_order { storage_row_major, storage_tiled, num_storage_orders };
+
+// columns per tile; three rows of a tile, with positions, velocities and rest lengths, stay
+// well inside a 32 KiB l1 cache
+constexpr unsigned int default_tile_width = 256;
+
+// the grid columns split into tiles of at most tile_width columns, each stored as a grid of its
+// own, row after row, with a halo column on either side that copies the nearest column of the
+// neighbouring tile, across the seam for the first and the last tile
+//
+// a row-major step reads three full rows for every row it writes, which fall out of the l1
+// cache once a row holds a few thousand vertices; a tiled step walks the rows of one tile at a
+// time, so the three rows it reads are only as wide as the tile, and the halos let every column
+// take the stencil path, the seam included
+class TiledLayout {
+    private:
+        unsigned int row_length;
+        unsigned int column_length;
+        // first grid column of every tile, followed by row_length
+        std::vector<unsigned int> tile_columns;
+        // first stored vertex of every tile, followed by the stored vertex count
+        std::vector<unsigned int> tile_offsets;
+
+    public:
+        TiledLayout(unsigned int row_length, unsigned int column_length, unsigned int tile_width);
+
+        unsigned int get_tile_count() const {
+            return tile_columns.size() - 1;
+        }
+
+        // stored vertices per row of the tile: its columns and the two halo columns
+        unsigned int get_stride(unsigned int tile) const {
+            return tile_columns[tile + 1] - tile_columns[tile] + 2;
+        }
+
+        unsigned int get_tile_offset(unsigned int tile) const {
+            return tile_offsets[tile];
+        }
+
+        // of all tiles, halos included
+        unsigned int get_stored_count() const {
+            return tile_offsets.back();
+        }
+
+        // copies a row-major array into the tiles, halos included
+        void scatter(const float *grid, float *tiled) const;
+
+        // copies the tiles without their halos back into a row-major array
+        void gather(const float *tiled, float *grid) const;
+
+        // refreshes the halo columns of rows [y_begin, y_end) from the tiles next to them
+        void exchange_halos(float *tiled, unsigned int y_begin, unsigned int y_end) const;
+};
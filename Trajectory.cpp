@@ -0,0 +1,206 @@
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+std::string system_error_message(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+// write can return early, so loop until everything is on disk
+bool write_all(int file, const void *data, std::size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = ::write(file, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// in 64 bits, since the product of a large grid wraps around in 32
+std::uint64_t get_frame_stride(std::uint64_t row_length, std::uint64_t column_length) {
+    return row_length * column_length * 4 * sizeof(float);
+}
+} // namespace
+
+TrajectoryHeader make_trajectory_header(unsigned int row_length, unsigned int column_length,
+                                        float delta_time) {
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, trajectory_magic, sizeof(header.magic));
+    header.version = trajectory_version;
+    header.row_length = row_length;
+    header.column_length = column_length;
+    std::uint64_t frame_stride = get_frame_stride(row_length, column_length);
+    if (frame_stride > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("a frame of a " + std::to_string(row_length) + "x"
+                                 + std::to_string(column_length)
+                                 + " grid is too large for a trajectory");
+    }
+    header.frame_stride = frame_stride;
+    header.delta_time = delta_time;
+    return header;
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string &path, const TrajectoryHeader &header,
+                                   std::size_t chunk_bytes)
+    : header(header), vertex_count(header.row_length * header.column_length) {
+    frames_per_chunk = std::max<std::size_t>(1, chunk_bytes / header.frame_stride);
+    for (std::vector<float> &chunk : chunks) {
+        chunk.resize(std::size_t(frames_per_chunk) * vertex_count * 4);
+    }
+
+    file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        throw std::runtime_error(system_error_message("could not create", path));
+    }
+    if (!write_all(file, &header, sizeof(header))) {
+        std::string message = system_error_message("could not write", path);
+        ::close(file);
+        throw std::runtime_error(message);
+    }
+    thread = std::thread(&TrajectoryWriter::write_loop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    try {
+        close();
+    } catch (const std::exception &) {
+        // errors can only be reported by an explicit close
+    }
+}
+
+void TrajectoryWriter::write_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        chunk_ready.wait(lock, [&] { return pending_frames > 0 || stopping; });
+        if (pending_frames == 0) {
+            return;
+        }
+        // the chunk that is not being filled is the one to write
+        const std::vector<float> &chunk = chunks[filling_chunk ^ 1];
+        std::size_t size = std::size_t(pending_frames) * header.frame_stride;
+        lock.unlock();
+        bool success = write_all(file, chunk.data(), size);
+        lock.lock();
+        if (!success && error.empty()) {
+            error = std::string("could not write trajectory: ") + std::strerror(errno);
+        }
+        pending_frames = 0;
+        chunk_written.notify_all();
+    }
+}
+
+void TrajectoryWriter::submit_chunk() {
+    auto start_time_point = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    chunk_written.wait(lock, [&] { return pending_frames == 0; });
+    waiting_seconds +=
+        std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+            .count();
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    pending_frames = filled_frames;
+    filling_chunk ^= 1;
+    filled_frames = 0;
+    chunk_ready.notify_one();
+}
+
+void TrajectoryWriter::write_frame(const float *x, const float *y, const float *z) {
+    if (file < 0) {
+        throw std::runtime_error("trajectory is already closed");
+    }
+    float *frame = chunks[filling_chunk].data() + std::size_t(filled_frames) * vertex_count * 4;
+    for (unsigned int i = 0; i < vertex_count; i++) {
+        frame[4 * i] = x[i];
+        frame[4 * i + 1] = y[i];
+        frame[4 * i + 2] = z[i];
+        frame[4 * i + 3] = 1;
+    }
+    frames_written++;
+    if (++filled_frames == frames_per_chunk) {
+        submit_chunk();
+    }
+}
+
+void TrajectoryWriter::close() {
+    if (file < 0) {
+        return;
+    }
+    if (filled_frames > 0) {
+        submit_chunk();
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_written.wait(lock, [&] { return pending_frames == 0; });
+        stopping = true;
+    }
+    chunk_ready.notify_one();
+    thread.join();
+
+    bool closed = ::close(file) == 0;
+    file = -1;
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    if (!closed) {
+        throw std::runtime_error(std::string("could not close trajectory: ")
+                                 + std::strerror(errno));
+    }
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &path) {
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error(system_error_message("could not open", path));
+    }
+    struct stat status;
+    if (::fstat(file, &status) != 0 || std::size_t(status.st_size) < sizeof(TrajectoryHeader)) {
+        ::close(file);
+        throw std::runtime_error(path + " is not a trajectory");
+    }
+    mapping_size = status.st_size;
+    void *address = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (address == MAP_FAILED) {
+        std::string message = system_error_message("could not map", path);
+        ::close(file);
+        throw std::runtime_error(message);
+    }
+    mapping = static_cast<const unsigned char *>(address);
+    // replay walks the frames in order
+    ::madvise(address, mapping_size, MADV_SEQUENTIAL);
+
+    std::memcpy(&header, mapping, sizeof(header));
+    if (std::memcmp(header.magic, trajectory_magic, sizeof(header.magic)) != 0
+        || header.version != trajectory_version
+        || header.frame_stride != get_frame_stride(header.row_length, header.column_length)
+        || header.frame_stride == 0) {
+        ::munmap(address, mapping_size);
+        ::close(file);
+        throw std::runtime_error(path + " is not a trajectory of version "
+                                 + std::to_string(trajectory_version));
+    }
+    frame_count = (mapping_size - sizeof(TrajectoryHeader)) / header.frame_stride;
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    ::munmap(const_cast<unsigned char *>(mapping), mapping_size);
+    ::close(file);
+}
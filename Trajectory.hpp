@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// file layout: a TrajectoryHeader followed by fixed-stride frames, every frame holding the
+// positions of all vertices as x, y, z, 1 floats; this is the layout of the position buffers on
+// the gpu, so a mapped frame can be uploaded as it is
+struct TrajectoryHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t row_length;
+        std::uint32_t column_length;
+        std::uint32_t frame_stride;
+        float delta_time;
+        float spinning_speed;
+        float spring_strength;
+        float gravity_strength;
+        float upper_radius;
+        float lower_radius;
+        std::uint8_t padding[16];
+};
+
+static_assert(sizeof(TrajectoryHeader) == 64);
+
+constexpr char trajectory_magic[8] = {'C', 'L', 'O', 'T', 'H', 'T', 'R', 'J'};
+constexpr std::uint32_t trajectory_version = 1;
+
+// fills in everything except the parameters, which are left at zero; throws if a frame of the
+// grid does not fit the 32-bit frame stride
+TrajectoryHeader make_trajectory_header(unsigned int row_length, unsigned int column_length,
+                                        float delta_time);
+
+// appends frames from the simulation thread while a background thread writes them; frames are
+// collected into one of two chunks, and the simulation only waits when both are in use
+class TrajectoryWriter {
+    private:
+        int file = -1;
+        TrajectoryHeader header;
+        unsigned int vertex_count;
+        unsigned int frames_per_chunk;
+
+        std::vector<float> chunks[2];
+        unsigned int filling_chunk = 0;
+        unsigned int filled_frames = 0;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable chunk_ready;
+        std::condition_variable chunk_written;
+        // frames of the chunk handed to the writer thread, 0 while it is idle
+        unsigned int pending_frames = 0;
+        bool stopping = false;
+        std::string error;
+
+        unsigned long long frames_written = 0;
+        double waiting_seconds = 0;
+
+        void write_loop();
+        // hands the filling chunk to the writer thread once it is done with the previous one
+        void submit_chunk();
+
+    public:
+        // chunk_bytes is the size of each of the two chunks, rounded to whole frames
+        TrajectoryWriter(const std::string &path, const TrajectoryHeader &header,
+                         std::size_t chunk_bytes = 16 << 20);
+        ~TrajectoryWriter();
+
+        TrajectoryWriter(const TrajectoryWriter &) = delete;
+        TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+        void write_frame(const float *x, const float *y, const float *z);
+
+        // writes the remaining frames and closes the file; throws if any write failed
+        void close();
+
+        unsigned long long get_frames_written() const {
+            return frames_written;
+        }
+
+        // wall seconds write_frame spent waiting for the writer thread
+        double get_waiting_seconds() const {
+            return waiting_seconds;
+        }
+};
+
+// maps a trajectory file read-only, so frames are read straight from the page cache
+class TrajectoryReader {
+    private:
+        int file = -1;
+        const unsigned char *mapping = nullptr;
+        std::size_t mapping_size = 0;
+        TrajectoryHeader header;
+        unsigned int frame_count = 0;
+
+    public:
+        explicit TrajectoryReader(const std::string &path);
+        ~TrajectoryReader();
+
+        TrajectoryReader(const TrajectoryReader &) = delete;
+        TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+        const TrajectoryHeader &get_header() const {
+            return header;
+        }
+
+        // frames cut off by an interrupted recording are not counted
+        unsigned int get_frame_count() const {
+            return frame_count;
+        }
+
+        // x, y, z, 1 for every vertex of the frame
+        const float *get_frame(unsigned int frame) const {
+            return reinterpret_cast<const float *>(mapping + sizeof(TrajectoryHeader)
+                                                   + std::size_t(frame) * header.frame_stride);
+        }
+};
@@ -0,0 +1,435 @@
+#include "AnimationStream.hpp"
+#include "ClothSolver.hpp"
+#include "DistributedCloth.hpp"
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// final positions and velocities, one vertex per line, followed by the normals if given
+void write_state(std::ostream &output, unsigned int row_length, unsigned int column_length,
+                 const ClothSolver::vertex_buffer &positions,
+                 const ClothSolver::vertex_buffer &velocities,
+                 const ClothSolver::vertex_buffer *normals) {
+    // enough digits to read the floats back exactly
+    output.precision(std::numeric_limits<float>::max_digits10);
+    output << "# " << row_length << "x" << column_length
+           << ": x y z velocity_x velocity_y velocity_z"
+           << (normals ? " normal_x normal_y normal_z\n" : "\n");
+    for (unsigned int i = 0; i < row_length * column_length; i++) {
+        output << positions.x[i] << " " << positions.y[i] << " " << positions.z[i] << " "
+               << velocities.x[i] << " " << velocities.y[i] << " " << velocities.z[i];
+        if (normals) {
+            output << " " << normals->x[i] << " " << normals->y[i] << " " << normals->z[i];
+        }
+        output << "\n";
+    }
+}
+
+// the same in the lab frame
+void write_state(std::ostream &output, const ClothSolver &solver,
+                 const ClothSolver::vertex_buffer *normals) {
+    ClothSolver::vertex_buffer positions;
+    ClothSolver::vertex_buffer velocities;
+    solver.get_lab_state(positions, velocities);
+    write_state(output, solver.get_row_length(), solver.get_column_length(), positions,
+                velocities, normals);
+}
+
+// steps the cloth split into row slabs over rank_count processes and writes the gathered state
+// like the single process run
+int run_distributed(unsigned int row_length, unsigned int column_length,
+                    const ClothParameters &parameters, bool ground_collision,
+                    unsigned int rank_count, unsigned int step_count, float delta_time,
+                    bool write_normals, const std::string &output_path) {
+    auto init_time_point = std::chrono::steady_clock::now();
+    DistributedCloth cloth(row_length, column_length, parameters, rank_count, ground_collision);
+    // the ranks build their slabs before they answer the first command
+    cloth.step(delta_time, 0);
+    auto start_time_point = std::chrono::steady_clock::now();
+    DistributedCloth::step_report report = cloth.step(delta_time, step_count);
+    auto end_time_point = std::chrono::steady_clock::now();
+    double init_seconds =
+        std::chrono::duration<double>{start_time_point - init_time_point}.count();
+    double step_seconds = std::chrono::duration<double>{end_time_point - start_time_point}.count();
+
+    ClothSolver::vertex_buffer positions;
+    ClothSolver::vertex_buffer velocities;
+    cloth.gather(positions, velocities);
+    ClothSolver::vertex_buffer normals;
+    if (write_normals) {
+        for (std::vector<float> *coordinate : {&normals.x, &normals.y, &normals.z}) {
+            coordinate->resize(cloth.get_vertex_count());
+        }
+        compute_normal_rows(positions.x.data(), positions.y.data(), positions.z.data(),
+                            row_length, column_length, normals.x.data(), normals.y.data(),
+                            normals.z.data(), 0, column_length);
+    }
+    if (output_path.empty()) {
+        write_state(std::cout, row_length, column_length, positions, velocities,
+                    write_normals ? &normals : nullptr);
+    } else {
+        std::ofstream output(output_path);
+        if (!output) {
+            std::cerr << "could not open " << output_path << std::endl;
+            return 1;
+        }
+        write_state(output, row_length, column_length, positions, velocities,
+                    write_normals ? &normals : nullptr);
+    }
+
+    std::cerr << "grid: " << row_length << "x" << column_length << "\n"
+              << "ranks: " << rank_count << ", " << column_length / rank_count
+              << " or more rows each\n"
+              << "integrator: explicit\n"
+              << "steps: " << step_count << " of " << delta_time << " seconds\n"
+              << "init seconds: " << init_seconds << "\n"
+              << "step seconds: " << step_seconds << "\n"
+              << "mean step us: " << step_seconds / std::max(1u, step_count) * 1e6 << "\n"
+              << "steps/second: " << step_count / step_seconds << "\n"
+              << "simulated seconds/second: " << step_count * delta_time / step_seconds << "\n"
+              << "halo share of rank seconds: "
+              << report.halo_seconds / std::max(1e-9, report.seconds * rank_count) << "\n"
+              << "halo MB/second: " << report.halo_bytes / step_seconds / 1e6 << std::endl;
+    return 0;
+}
+
+// runs the simulation without a window or gpu as fast as the cpu allows and reports the final
+// state and timing
+int main(int argc, char **argv) {
+    unsigned int row_length = default_row_length;
+    unsigned int column_length = default_column_length;
+    unsigned int step_count = 1000;
+    float delta_time = 0.01f;
+    unsigned int thread_count = 0;
+    // any number of constraint iterations switches to the position based integrator
+    unsigned int iteration_count = 0;
+    // levels of the v-cycle the position based integrator runs its iterations over
+    unsigned int level_count = 1;
+    // splits the cloth into row slabs stepped by this many processes
+    unsigned int rank_count = 0;
+    ClothParameters parameters;
+    bool ground_collision = true;
+    bool self_collision = false;
+    // simulates in the frame spinning with the top row, where rows at rest stop being stepped
+    bool co_rotating = false;
+    float sleep_speed = default_sleep_speed;
+    // stores the grid in tiles of this many columns, which only the explicit integrator uses
+    unsigned int tile_width = 0;
+    // rounds the state after every step as the painter stores it in this format
+    state_format format = state_format_float4;
+    // runs the same steps again in float4 and reports how far the state format took the run
+    // from it
+    bool accuracy_report = false;
+    // adds the vertex normals to the written state, e.g. for rendering it elsewhere
+    bool write_normals = false;
+    // the final state goes to stdout when no file is given
+    std::string output_path;
+    // writes every step, starting with the initial state, as a trajectory for replay
+    std::string record_path;
+    // the same steps quantized and compressed, for renderers elsewhere
+    std::string export_path;
+    float export_precision = default_animation_precision;
+    unsigned int keyframe_interval = default_keyframe_interval;
+    // continues from a saved state, whose grid and parameters replace the given ones
+    std::string load_checkpoint_path;
+    // saves the final state
+    std::string save_checkpoint_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        // false once the value of a numeric option does not parse
+        bool valid = true;
+        if (argument == "--grid" && i + 1 < argc) {
+            if (!parse_grid_size(argv[++i], row_length, column_length)) {
+                std::cerr << "invalid grid size " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (argument == "--steps" && i + 1 < argc) {
+            valid = parse_count(argv[++i], step_count);
+        } else if (argument == "--dt" && i + 1 < argc) {
+            valid = parse_number(argv[++i], delta_time) && delta_time > 0;
+        } else if (argument == "--threads" && i + 1 < argc) {
+            valid = parse_count(argv[++i], thread_count);
+        } else if (argument == "--iterations" && i + 1 < argc) {
+            valid = parse_count(argv[++i], iteration_count);
+        } else if (argument == "--ranks" && i + 1 < argc) {
+            valid = parse_count(argv[++i], rank_count);
+        } else if (argument == "--levels" && i + 1 < argc) {
+            valid = parse_count(argv[++i], level_count);
+        } else if (argument == "--spinning-speed" && i + 1 < argc) {
+            valid = parse_number(argv[++i], parameters.spinning_speed);
+        } else if (argument == "--spring-strength" && i + 1 < argc) {
+            valid = parse_number(argv[++i], parameters.spring_strength);
+        } else if (argument == "--gravity-strength" && i + 1 < argc) {
+            valid = parse_number(argv[++i], parameters.gravity_strength);
+        } else if (argument == "--upper-radius" && i + 1 < argc) {
+            valid = parse_number(argv[++i], parameters.upper_radius);
+        } else if (argument == "--lower-radius" && i + 1 < argc) {
+            valid = parse_number(argv[++i], parameters.lower_radius);
+        } else if (argument == "--no-ground") {
+            ground_collision = false;
+        } else if (argument == "--self-collision") {
+            self_collision = true;
+        } else if (argument == "--co-rotating") {
+            co_rotating = true;
+        } else if (argument == "--sleep-speed" && i + 1 < argc) {
+            valid = parse_number(argv[++i], sleep_speed);
+        } else if (argument == "--tile-width" && i + 1 < argc) {
+            valid = parse_count(argv[++i], tile_width);
+        } else if (argument == "--state-format" && i + 1 < argc) {
+            if (!parse_state_format(argv[++i], format)) {
+                std::cerr << "unknown state format " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (argument == "--accuracy-report") {
+            accuracy_report = true;
+        } else if (argument == "--normals") {
+            write_normals = true;
+        } else if (argument == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (argument == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (argument == "--export" && i + 1 < argc) {
+            export_path = argv[++i];
+        } else if (argument == "--export-precision" && i + 1 < argc) {
+            valid = parse_number(argv[++i], export_precision) && export_precision > 0;
+        } else if (argument == "--keyframe-interval" && i + 1 < argc) {
+            valid = parse_count(argv[++i], keyframe_interval);
+        } else if (argument == "--load-checkpoint" && i + 1 < argc) {
+            load_checkpoint_path = argv[++i];
+        } else if (argument == "--save-checkpoint" && i + 1 < argc) {
+            save_checkpoint_path = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--grid <row length>x<column length>]"
+                      << " [--steps <count>] [--dt <seconds>] [--threads <count>]"
+                      << " [--ranks <count>] [--iterations <count>] [--levels <count>]"
+                      << " [--spinning-speed <radians per second>]"
+                      << " [--spring-strength <value>] [--gravity-strength <value>]"
+                      << " [--upper-radius <value>] [--lower-radius <value>]"
+                      << " [--no-ground] [--self-collision] [--co-rotating]"
+                      << " [--sleep-speed <units per second>] [--tile-width <columns>]"
+                      << " [--state-format <float4|float3|half|fixed>] [--accuracy-report]"
+                      << " [--normals]"
+                      << " [--output <path>] [--record <trajectory>]"
+                      << " [--export <animation>] [--export-precision <units>]"
+                      << " [--keyframe-interval <frames>]"
+                      << " [--load-checkpoint <path>] [--save-checkpoint <path>]" << std::endl;
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "invalid value " << argv[i] << " for " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    if (rank_count > 0) {
+        // a rank steps its slab on one thread with the explicit update in the lab frame
+        if (thread_count != 0 || iteration_count > 0 || self_collision || co_rotating
+            || tile_width > 0 || format != state_format_float4 || accuracy_report
+            || !record_path.empty() || !export_path.empty() || !load_checkpoint_path.empty()
+            || !save_checkpoint_path.empty()) {
+            std::cerr << "--ranks only takes --grid, --steps, --dt, the cloth parameters,"
+                      << " --no-ground, --normals and --output" << std::endl;
+            return 1;
+        }
+        // every rank owns at least one row of the cloth
+        if (rank_count > column_length) {
+            std::cerr << "--ranks " << rank_count << " exceeds the " << column_length
+                      << " rows of the grid" << std::endl;
+            return 1;
+        }
+        return run_distributed(row_length, column_length, parameters, ground_collision,
+                               rank_count, step_count, delta_time, write_normals, output_path);
+    }
+
+    auto init_time_point = std::chrono::steady_clock::now();
+    Checkpoint checkpoint;
+    if (!load_checkpoint_path.empty()) {
+        checkpoint = load_checkpoint(load_checkpoint_path);
+        row_length = checkpoint.row_length;
+        column_length = checkpoint.column_length;
+        parameters = checkpoint.parameters;
+    }
+    // the same run for the solver and the float4 reference of the accuracy report
+    auto configure = [&](ClothSolver &target, state_format target_format) {
+        if (!load_checkpoint_path.empty()) {
+            target.restore(checkpoint);
+        }
+        target.set_thread_count(thread_count);
+        target.set_ground_collision(ground_collision);
+        target.set_self_collision(self_collision);
+        if (iteration_count > 0) {
+            target.set_integrator(integrator_position_based);
+            target.set_iteration_count(iteration_count);
+            target.set_level_count(level_count);
+        }
+        target.set_sleep_speed(sleep_speed);
+        target.set_co_rotating(co_rotating);
+        if (tile_width > 0) {
+            target.set_storage_order(storage_tiled, tile_width);
+        }
+        target.set_state_format(target_format);
+    };
+    ClothSolver solver(row_length, column_length, parameters);
+    configure(solver, format);
+
+    std::unique_ptr<TrajectoryWriter> recorder;
+    std::unique_ptr<AnimationWriter> exporter;
+    ClothSolver::vertex_buffer lab_positions;
+    ClothSolver::vertex_buffer lab_velocities;
+    auto record = [&]() {
+        const ClothSolver::vertex_buffer *positions = &solver.get_positions();
+        if (co_rotating) {
+            solver.get_lab_state(lab_positions, lab_velocities);
+            positions = &lab_positions;
+        }
+        if (recorder) {
+            recorder->write_frame(positions->x.data(), positions->y.data(), positions->z.data());
+        }
+        if (exporter) {
+            exporter->write_frame(positions->x.data(), positions->y.data(), positions->z.data());
+        }
+    };
+    if (!record_path.empty()) {
+        TrajectoryHeader header = make_trajectory_header(row_length, column_length, delta_time);
+        header.spinning_speed = parameters.spinning_speed;
+        header.spring_strength = parameters.spring_strength;
+        header.gravity_strength = parameters.gravity_strength;
+        header.upper_radius = parameters.upper_radius;
+        header.lower_radius = parameters.lower_radius;
+        recorder = std::make_unique<TrajectoryWriter>(record_path, header);
+    }
+    if (!export_path.empty()) {
+        exporter = std::make_unique<AnimationWriter>(
+            export_path,
+            make_animation_header(row_length, column_length, delta_time,
+                                  parameters.spinning_speed, export_precision, keyframe_interval));
+    }
+    if (recorder || exporter) {
+        record();
+    }
+
+    auto start_time_point = std::chrono::steady_clock::now();
+    double slowest_step_seconds = 0;
+    for (unsigned int i = 0; i < step_count; i++) {
+        auto step_time_point = std::chrono::steady_clock::now();
+        solver.step(delta_time);
+        if (recorder || exporter) {
+            record();
+        }
+        slowest_step_seconds = std::max(
+            slowest_step_seconds,
+            std::chrono::duration<double>{std::chrono::steady_clock::now() - step_time_point}
+                .count());
+    }
+    if (recorder) {
+        recorder->close();
+    }
+    if (exporter) {
+        exporter->close();
+    }
+    auto end_time_point = std::chrono::steady_clock::now();
+    double init_seconds =
+        std::chrono::duration<double>{start_time_point - init_time_point}.count();
+    double step_seconds = std::chrono::duration<double>{end_time_point - start_time_point}.count();
+
+    if (!save_checkpoint_path.empty()) {
+        save_checkpoint(save_checkpoint_path, solver.get_checkpoint());
+    }
+
+    ClothSolver::vertex_buffer normals;
+    if (write_normals) {
+        solver.compute_normals(normals);
+    }
+    if (output_path.empty()) {
+        write_state(std::cout, solver, write_normals ? &normals : nullptr);
+    } else {
+        std::ofstream output(output_path);
+        if (!output) {
+            std::cerr << "could not open " << output_path << std::endl;
+            return 1;
+        }
+        write_state(output, solver, write_normals ? &normals : nullptr);
+    }
+
+    // the stats go to stderr so they never mix with a state written to stdout
+    std::cerr << "grid: " << row_length << "x" << column_length << "\n"
+              << "threads: " << solver.get_thread_count() << "\n"
+              << "integrator: "
+              << (solver.get_integrator() == integrator_explicit ? "explicit" : "position based")
+              << "\n"
+              << "steps: " << step_count << " of " << delta_time << " seconds\n"
+              << "simulated time: " << solver.get_simulated_time() << " seconds\n"
+              << "init seconds: " << init_seconds << "\n"
+              << "step seconds: " << step_seconds << "\n"
+              << "mean step us: " << step_seconds / std::max(1u, step_count) * 1e6 << "\n"
+              << "slowest step us: " << slowest_step_seconds * 1e6 << "\n"
+              << "steps/second: " << step_count / step_seconds << "\n"
+              << "simulated seconds/second: " << step_count * delta_time / step_seconds
+              << std::endl;
+    if (co_rotating) {
+        std::cerr << "sleeping rows: " << solver.get_sleeping_row_count() << " of "
+                  << column_length << (solver.is_at_rest() ? ", at rest" : "") << std::endl;
+    }
+    if (recorder) {
+        double recorded_bytes = static_cast<double>(recorder->get_frames_written())
+                                * solver.get_vertex_count() * 4 * sizeof(float);
+        std::cerr << "recorded frames: " << recorder->get_frames_written() << "\n"
+                  << "recorded MB/second: " << recorded_bytes / step_seconds / 1e6 << "\n"
+                  << "seconds waiting for the writer: " << recorder->get_waiting_seconds()
+                  << std::endl;
+    }
+    if (exporter) {
+        std::cerr << "exported frames: " << exporter->get_frames_written() << "\n"
+                  << "exported MB: " << exporter->get_encoded_bytes() / 1e6 << ", "
+                  << static_cast<double>(exporter->get_raw_bytes())
+                         / exporter->get_encoded_bytes()
+                  << "x smaller than a trajectory\n"
+                  << "export encode MB/second: "
+                  << exporter->get_raw_bytes() / exporter->get_encode_seconds() / 1e6 << "\n"
+                  << "seconds waiting for the exporter: " << exporter->get_waiting_seconds()
+                  << std::endl;
+    }
+    if (accuracy_report) {
+        // after the timing, so the reference does not slow down the measured run
+        ClothSolver reference(row_length, column_length, parameters);
+        configure(reference, state_format_float4);
+        for (unsigned int i = 0; i < step_count; i++) {
+            reference.step(delta_time);
+        }
+        ClothSolver::vertex_buffer positions;
+        ClothSolver::vertex_buffer velocities;
+        ClothSolver::vertex_buffer reference_positions;
+        ClothSolver::vertex_buffer reference_velocities;
+        solver.get_lab_state(positions, velocities);
+        reference.get_lab_state(reference_positions, reference_velocities);
+        buffer_distance position_error = measure_distance(positions, reference_positions);
+        buffer_distance velocity_error = measure_distance(velocities, reference_velocities);
+        // the explicit update is chaotic, so the errors above grow with the steps; rounding the
+        // final reference state once shows what the format loses in a single step
+        ClothSolver::vertex_buffer rounded_positions = reference_positions;
+        round_trip_state(format, rounded_positions.x.data(), rounded_positions.y.data(),
+                         rounded_positions.z.data(), reference.get_vertex_count());
+        buffer_distance rounding_error = measure_distance(rounded_positions, reference_positions);
+        std::cerr << "state format: " << state_format_name(format) << ", "
+                  << static_cast<double>(get_state_buffer_size(format, solver.get_vertex_count()))
+                         / solver.get_vertex_count()
+                  << " bytes per vertex instead of 16\n"
+                  << "max position rounding: " << rounding_error.max << "\n"
+                  << "max position error: " << position_error.max << "\n"
+                  << "rms position error: " << position_error.rms << "\n"
+                  << "max velocity error: " << velocity_error.max << "\n"
+                  << "rms velocity error: " << velocity_error.rms << "\n"
+                  << "flare radius: " << solver.get_flare_radius() << " instead of "
+                  << reference.get_flare_radius() << "\n"
+                  << "max stretch: " << solver.get_max_stretch() << " instead of "
+                  << reference.get_max_stretch() << std::endl;
+    }
+}
@@ -0,0 +1,677 @@
+#include "AnimationStream.hpp"
+#include "Benchmark.hpp"
+#include "ClothBatch.hpp"
+#include "ClothSolver.hpp"
+#include "DistributedCloth.hpp"
+#include "PerfCounters.hpp"
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+struct grid_size {
+    public:
+        unsigned int row_length;
+        unsigned int column_length;
+};
+
+std::string grid_name(const grid_size &size) {
+    return std::to_string(size.row_length) + "x" + std::to_string(size.column_length);
+}
+
+float max_difference(const ClothSolver &first, const ClothSolver &second) {
+    const ClothSolver::vertex_buffer &first_positions = first.get_positions();
+    const ClothSolver::vertex_buffer &second_positions = second.get_positions();
+    float difference = 0;
+    for (unsigned int i = 0; i < first.get_vertex_count(); i++) {
+        difference = std::max(difference, std::abs(first_positions.x[i] - second_positions.x[i]));
+        difference = std::max(difference, std::abs(first_positions.y[i] - second_positions.y[i]));
+        difference = std::max(difference, std::abs(first_positions.z[i] - second_positions.z[i]));
+    }
+    return difference;
+}
+
+void bench_kernels(BenchmarkSuite &suite, const grid_size &size) {
+    // the kernels are compared on the same number of steps, separately from the timing, which
+    // takes as many samples as fit into its budget
+    constexpr unsigned int comparison_step_count = 100;
+    ClothSolver reference(size.row_length, size.column_length);
+    reference.set_kernel(kernel_scalar);
+    for (unsigned int i = 0; i < comparison_step_count; i++) {
+        reference.step(0.01f);
+    }
+
+    double scalar_seconds = 0;
+    for (unsigned int type = kernel_scalar; type < num_kernel_types; type++) {
+        std::string name = "step/" + grid_name(size) + "/"
+                           + kernel_name(static_cast<kernel_type>(type));
+        if (!is_kernel_supported(static_cast<kernel_type>(type))) {
+            std::cout << name << ": not supported\n";
+            continue;
+        }
+        ClothSolver solver(size.row_length, size.column_length);
+        solver.set_kernel(static_cast<kernel_type>(type));
+        for (unsigned int i = 0; i < comparison_step_count; i++) {
+            solver.step(0.01f);
+        }
+        float difference = max_difference(solver, reference);
+
+        double seconds = suite.run(name, solver.get_vertex_count(), "vertices", [&] {
+            solver.step(0.01f);
+        }).median();
+        if (type == kernel_scalar) {
+            scalar_seconds = seconds;
+        }
+        std::cout << "  speedup " << scalar_seconds / seconds
+                  << ", max difference to scalar: " << difference << "\n";
+    }
+}
+
+void bench_threads(BenchmarkSuite &suite, const grid_size &size) {
+    // powers of two up to the hardware thread count, which is always measured last
+    unsigned int max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int thread_count = 1; thread_count < max_thread_count; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(max_thread_count);
+
+    double single_thread_seconds = 0;
+    for (unsigned int thread_count : thread_counts) {
+        ClothSolver solver(size.row_length, size.column_length);
+        solver.set_thread_count(thread_count);
+        double seconds =
+            suite.run("step/" + grid_name(size) + "/threads=" + std::to_string(thread_count),
+                      solver.get_vertex_count(), "vertices", [&] { solver.step(0.01f); })
+                .median();
+        if (thread_count == 1) {
+            single_thread_seconds = seconds;
+        }
+        std::cout << "  speedup " << single_thread_seconds / seconds << ", efficiency "
+                  << single_thread_seconds / seconds / thread_count << "\n";
+    }
+}
+
+// steps per second of the default configuration, every hardware thread and the best kernel
+void bench_grid_sweep(BenchmarkSuite &suite, const std::vector<grid_size> &sizes) {
+    for (const grid_size &size : sizes) {
+        ClothSolver solver(size.row_length, size.column_length);
+        solver.set_thread_count(0);
+        suite.run("step/" + grid_name(size), solver.get_vertex_count(), "vertices",
+                  [&] { solver.step(0.01f); });
+    }
+}
+
+// k cloths in one batch against k solvers stepped one after the other, both on every hardware
+// thread; small cloths are where the per-solver overhead shows
+void bench_batch(BenchmarkSuite &suite, const grid_size &size,
+                 const std::vector<unsigned int> &cloth_counts) {
+    for (unsigned int cloth_count : cloth_counts) {
+        std::vector<ClothParameters> parameters = vary_parameters(cloth_count);
+        std::string name = grid_name(size) + "/K=" + std::to_string(cloth_count);
+
+        ClothBatch batch(size.row_length, size.column_length, parameters);
+        batch.set_thread_count(0);
+        suite.run("batch_step/" + name, batch.get_vertex_count(), "vertices",
+                  [&] { batch.step(0.01f); });
+
+        std::vector<std::unique_ptr<ClothSolver>> solvers;
+        for (const ClothParameters &cloth_parameters : parameters) {
+            solvers.push_back(std::make_unique<ClothSolver>(size.row_length, size.column_length,
+                                                            cloth_parameters));
+            solvers.back()->set_thread_count(0);
+        }
+        suite.run("separate_step/" + name, batch.get_vertex_count(), "vertices", [&] {
+            for (std::unique_ptr<ClothSolver> &solver : solvers) {
+                solver->step(0.01f);
+            }
+        });
+    }
+}
+
+// a step without collisions, with the ground clamp and with self-collision on top, from a
+// flared cloth; the overhead against the plain step is printed once all three ran
+void bench_collision(BenchmarkSuite &suite, const std::vector<grid_size> &sizes) {
+    constexpr unsigned int flare_step_count = 300;
+    for (const grid_size &size : sizes) {
+        const char *const names[] = {"step_no_collision/", "step_ground/", "step_self_collision/"};
+        double medians[3];
+        for (unsigned int mode = 0; mode < 3; mode++) {
+            ClothSolver solver(size.row_length, size.column_length);
+            solver.set_thread_count(0);
+            solver.set_ground_collision(mode > 0);
+            solver.set_self_collision(mode > 1);
+            for (unsigned int i = 0; i < flare_step_count; i++) {
+                solver.step(0.01f);
+            }
+            suite.run(names[mode] + grid_name(size), solver.get_vertex_count(), "vertices",
+                      [&] { solver.step(0.01f); });
+            medians[mode] = suite.get_results().back().median();
+
+            if (const SelfCollision *self_collision = solver.get_self_collision()) {
+                std::cout << "  " << self_collision->get_moved_vertex_count()
+                          << " vertices changed cell in the last step, "
+                          << self_collision->get_contact_count() << " contacts\n";
+            }
+        }
+        std::cout << "collision overhead " << grid_name(size) << ": ground "
+                  << 100 * (medians[1] / medians[0] - 1) << "%, self-collision "
+                  << 100 * (medians[2] / medians[0] - 1) << "%\n";
+    }
+}
+
+// the normals of a frame once per grid vertex against once per drawn triangle corner, which is
+// what a vertex shader without an element buffer ends up doing for each of the two draws
+void bench_normals(BenchmarkSuite &suite, const grid_size &size) {
+    ClothSolver solver(size.row_length, size.column_length);
+    solver.set_thread_count(0);
+    for (unsigned int i = 0; i < 300; i++) {
+        solver.step(0.01f);
+    }
+    const ClothSolver::vertex_buffer &positions = solver.get_positions();
+    unsigned int row_length = size.row_length;
+    unsigned int column_length = size.column_length;
+    std::vector<unsigned int> indices = build_render_indices(row_length, column_length);
+
+    ClothSolver::vertex_buffer normals;
+    suite.run("normals_per_vertex/" + grid_name(size), solver.get_vertex_count(), "vertices",
+              [&] { solver.compute_normals(normals); });
+    double per_vertex = suite.get_results().back().median();
+
+    std::vector<float> corner_normals(3 * indices.size());
+    suite.run("normals_per_corner/" + grid_name(size), solver.get_vertex_count(), "vertices", [&] {
+        for (unsigned int draw = 0; draw < 2; draw++) {
+            for (unsigned int k = 0; k < indices.size(); k++) {
+                unsigned int render_x = indices[k] % (row_length + 1);
+                compute_vertex_normal(positions.x.data(), positions.y.data(), positions.z.data(),
+                                      row_length, column_length, render_x % row_length,
+                                      indices[k] / (row_length + 1), &corner_normals[3 * k]);
+            }
+        }
+    });
+    double per_corner = suite.get_results().back().median();
+
+    // a vertex reads its position and normal, 16 bytes each, per shader invocation; with the
+    // element buffer the post-transform cache runs about one invocation per render vertex
+    unsigned long long corners = 2ull * indices.size();
+    unsigned long long render_vertices =
+        2ull * get_render_vertex_count(row_length, column_length);
+    std::cout << "per frame " << grid_name(size) << ": " << corners << " vertex shader runs "
+              << "and normal evaluations without the element buffer, about " << render_vertices
+              << " runs and " << solver.get_vertex_count() << " normal evaluations with it; "
+              << corners * 32 / 1024 << " against " << render_vertices * 32 / 1024
+              << " KiB read; normals " << per_corner / per_vertex << "x faster\n";
+}
+
+// the position based step in the lab against the co-rotating frame once every row fell asleep,
+// and how long the cloth takes to get there and to settle again after the spinning speed changed
+void bench_co_rotating(BenchmarkSuite &suite, const grid_size &size) {
+    constexpr unsigned int max_step_count = 50000;
+    ClothSolver lab(size.row_length, size.column_length);
+    ClothSolver frame(size.row_length, size.column_length);
+    for (ClothSolver *solver : {&lab, &frame}) {
+        solver->set_thread_count(0);
+        solver->set_integrator(integrator_position_based);
+    }
+    frame.set_co_rotating(true);
+    unsigned int rest_steps = 0;
+    while (!frame.is_at_rest() && rest_steps < max_step_count) {
+        frame.step(0.01f);
+        lab.step(0.01f);
+        rest_steps++;
+    }
+
+    ClothSolver::vertex_buffer frame_positions;
+    ClothSolver::vertex_buffer frame_velocities;
+    frame.get_lab_state(frame_positions, frame_velocities);
+    float deviation = 0;
+    for (unsigned int i = 0; i < lab.get_vertex_count(); i++) {
+        const ClothSolver::vertex_buffer &lab_positions = lab.get_positions();
+        deviation = std::max(deviation, std::hypot(frame_positions.x[i] - lab_positions.x[i],
+                                                   frame_positions.y[i] - lab_positions.y[i],
+                                                   frame_positions.z[i] - lab_positions.z[i]));
+    }
+
+    suite.run("step_lab/" + grid_name(size), lab.get_vertex_count(), "vertices",
+              [&] { lab.step(0.01f); });
+    double lab_median = suite.get_results().back().median();
+    suite.run("step_co_rotating_at_rest/" + grid_name(size), frame.get_vertex_count(),
+              "vertices", [&] { frame.step(0.01f); });
+    double frame_median = suite.get_results().back().median();
+
+    ClothParameters parameters = frame.get_parameters();
+    parameters.spinning_speed *= 2;
+    frame.set_parameters(parameters);
+    unsigned int wake_steps = 0;
+    while (!frame.is_at_rest() && wake_steps < max_step_count) {
+        frame.step(0.01f);
+        wake_steps++;
+    }
+
+    std::cout << "co-rotating " << grid_name(size) << ": at rest after " << rest_steps
+              << " steps, " << deviation << " from the lab, step " << lab_median / frame_median
+              << "x faster at rest; at rest again " << wake_steps
+              << " steps after doubling the spinning speed\n";
+}
+
+// steps and wall time until a co-rotating position based run sleeps, on the fine grid alone and
+// with every level the grid allows; tall cloths need the most steps on the fine grid alone, so
+// runs give up after max_step_count and report how fast the cloth still moves
+void bench_hierarchy(const std::vector<grid_size> &sizes, unsigned int max_step_count) {
+    for (const grid_size &size : sizes) {
+        std::cout << "hierarchy " << grid_name(size) << ":";
+        for (unsigned int level_count : {1u, 32u}) {
+            ClothSolver solver(size.row_length, size.column_length);
+            solver.set_thread_count(0);
+            solver.set_integrator(integrator_position_based);
+            solver.set_co_rotating(true);
+            solver.set_level_count(level_count);
+            unsigned int step_count = 0;
+            auto start_time_point = std::chrono::high_resolution_clock::now();
+            while (!solver.is_at_rest() && step_count < max_step_count) {
+                solver.step(0.01f);
+                step_count++;
+            }
+            auto end_time_point = std::chrono::high_resolution_clock::now();
+            double seconds =
+                std::chrono::duration<double>{end_time_point - start_time_point}.count();
+
+            const ClothHierarchy *hierarchy = solver.get_hierarchy();
+            std::cout << (level_count == 1 ? " " : "; ")
+                      << (hierarchy ? hierarchy->get_level_count() : 1) << " levels "
+                      << (solver.is_at_rest() ? "at rest" : "not at rest") << " after "
+                      << step_count << " steps";
+            const ClothSolver::vertex_buffer &velocities = solver.get_velocities();
+            float max_speed = 0;
+            for (unsigned int i = 0; i < solver.get_vertex_count(); i++) {
+                max_speed = std::max(max_speed, std::sqrt(velocities.x[i] * velocities.x[i]
+                                                          + velocities.y[i] * velocities.y[i]
+                                                          + velocities.z[i] * velocities.z[i]));
+            }
+            std::cout << ", " << seconds << " s, " << seconds / step_count * 1e3
+                      << " ms per step, max speed " << max_speed << ", max stretch "
+                      << solver.get_max_stretch();
+        }
+        std::cout << "\n";
+    }
+}
+
+// strong scaling: the same grid over more and more ranks; weak scaling: rows_per_rank rows of
+// row_length vertices on every rank; the halo share is the part of the rank seconds spent in
+// exchanges, waiting for slower neighbours included
+void bench_distributed(unsigned int row_length, unsigned int rows_per_rank,
+                       const std::vector<unsigned int> &rank_counts, unsigned int step_count) {
+    std::cout << "distributed " << row_length << " vertices per row, " << step_count
+              << " steps, " << std::thread::hardware_concurrency() << " hardware threads\n";
+    for (bool weak : {false, true}) {
+        double first_seconds = 0;
+        for (unsigned int rank_count : rank_counts) {
+            unsigned int column_length = rows_per_rank * (weak ? rank_count : rank_counts.back());
+            DistributedCloth cloth(row_length, column_length, ClothParameters(), rank_count);
+            cloth.step(0.01f, 1);
+            DistributedCloth::step_report report = cloth.step(0.01f, step_count);
+            if (rank_count == rank_counts.front()) {
+                first_seconds = report.seconds;
+            }
+            std::cout << "  " << (weak ? "weak" : "strong") << " " << row_length << "x"
+                      << column_length << " on " << rank_count << " ranks: "
+                      << report.seconds / step_count * 1e3 << " ms per step, "
+                      << (weak ? "efficiency " : "speedup ") << first_seconds / report.seconds
+                      << ", halo share "
+                      << report.halo_seconds / (report.seconds * rank_count) << ", "
+                      << report.halo_bytes / step_count << " halo bytes per step\n";
+        }
+    }
+}
+
+// the explicit step in row-major and tiled storage on one thread, with the cache misses per
+// vertex where the cpu exposes its counters, and otherwise the bytes of the three rows a row
+// reads against the cache sizes
+void bench_storage_orders(BenchmarkSuite &suite, const std::vector<grid_size> &sizes,
+                          const std::vector<unsigned int> &tile_widths) {
+    PerfCounters counters;
+    if (!counters.is_available()) {
+        std::cout << "no cache counters: " << counters.get_error() << "\n";
+        std::cout << "l1d " << sysconf(_SC_LEVEL1_DCACHE_SIZE) / 1024 << " KiB, l2 "
+                  << sysconf(_SC_LEVEL2_CACHE_SIZE) / 1024 << " KiB\n";
+    }
+    // current positions of three rows, and the next positions, velocities and rest lengths of
+    // the row being written
+    auto window_bytes = [](unsigned int width) {
+        return (3 * 3 + 3 + 3 + 4) * sizeof(float) * static_cast<unsigned long long>(width);
+    };
+
+    for (const grid_size &size : sizes) {
+        std::vector<unsigned int> widths = {0};
+        widths.insert(widths.end(), tile_widths.begin(), tile_widths.end());
+        double row_major_median = 0;
+        for (unsigned int width : widths) {
+            ClothSolver solver(size.row_length, size.column_length);
+            if (width > 0) {
+                solver.set_storage_order(storage_tiled, width);
+            }
+            std::string name = width > 0 ? "step_tiled_" + std::to_string(width) : "step_row_major";
+            suite.run(name + "/" + grid_name(size), solver.get_vertex_count(), "vertices",
+                      [&] { solver.step(0.01f); });
+            double median = suite.get_results().back().median();
+            if (width == 0) {
+                row_major_median = median;
+            }
+
+            std::cout << "  " << window_bytes(width > 0 ? width + 2 : size.row_length) / 1024
+                      << " KiB read per row, " << row_major_median / median
+                      << "x the row-major speed";
+            if (counters.is_available()) {
+                constexpr unsigned int counted_step_count = 10;
+                counters.start();
+                for (unsigned int i = 0; i < counted_step_count; i++) {
+                    solver.step(0.01f);
+                }
+                PerfCounters::counts counts = counters.stop();
+                double vertex_count =
+                    static_cast<double>(solver.get_vertex_count()) * counted_step_count;
+                for (unsigned int counter = 0; counter < PerfCounters::num_counters; counter++) {
+                    std::cout << ", " << counts.values[counter] / vertex_count << " "
+                              << PerfCounters::counter_name(counter) << " per vertex";
+                }
+            }
+            std::cout << "\n";
+        }
+    }
+}
+
+// how far every state format takes the explicit and the position based update from float4, and
+// what encoding a state for upload costs in it
+void bench_state_formats(BenchmarkSuite &suite, const grid_size &size, unsigned int step_count) {
+    for (unsigned int integrator = 0; integrator < num_integrator_types; integrator++) {
+        auto run = [&](state_format format) {
+            auto solver = std::make_unique<ClothSolver>(size.row_length, size.column_length);
+            solver->set_integrator(static_cast<integrator_type>(integrator));
+            solver->set_state_format(format);
+            for (unsigned int i = 0; i < step_count; i++) {
+                solver->step(0.01f);
+            }
+            return solver;
+        };
+        std::unique_ptr<ClothSolver> reference = run(state_format_float4);
+        for (unsigned int format = state_format_float3; format < num_state_formats; format++) {
+            std::unique_ptr<ClothSolver> solver = run(static_cast<state_format>(format));
+            ClothSolver::vertex_buffer rounded = reference->get_positions();
+            round_trip_state(static_cast<state_format>(format), rounded.x.data(),
+                             rounded.y.data(), rounded.z.data(), reference->get_vertex_count());
+            buffer_distance rounding = measure_distance(rounded, reference->get_positions());
+            buffer_distance error =
+                measure_distance(solver->get_positions(), reference->get_positions());
+            std::cout << state_format_name(static_cast<state_format>(format)) << " "
+                      << grid_name(size) << " "
+                      << (integrator == integrator_explicit ? "explicit" : "position based")
+                      << ": "
+                      << static_cast<double>(get_state_buffer_size(
+                             static_cast<state_format>(format), solver->get_vertex_count()))
+                             / solver->get_vertex_count()
+                      << " bytes per vertex, max rounding " << rounding.max << ", after "
+                      << step_count << " steps rms error " << error.rms << ", flare radius "
+                      << solver->get_flare_radius() << " instead of "
+                      << reference->get_flare_radius() << "\n";
+        }
+    }
+
+    ClothSolver solver(size.row_length, size.column_length);
+    const ClothSolver::vertex_buffer &positions = solver.get_positions();
+    std::vector<std::uint32_t> words;
+    for (unsigned int format = 0; format < num_state_formats; format++) {
+        std::string format_name = state_format_name(static_cast<state_format>(format));
+        suite.run("encode_state_" + format_name + "/" + grid_name(size),
+                  solver.get_vertex_count(), "vertices", [&] {
+                      encode_state(static_cast<state_format>(format), positions.x.data(),
+                                   positions.y.data(), positions.z.data(), 1,
+                                   solver.get_vertex_count(), 1, words);
+                  });
+    }
+}
+
+// checkpoint and trajectory throughput, through files in the temporary directory
+void bench_state_io(BenchmarkSuite &suite, const grid_size &size) {
+    ClothSolver solver(size.row_length, size.column_length);
+    for (unsigned int i = 0; i < 10; i++) {
+        solver.step(0.01f);
+    }
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string checkpoint_path = directory / "cloth_bench.ckp";
+    std::string trajectory_path = directory / "cloth_bench.traj";
+
+    save_checkpoint(checkpoint_path, solver.get_checkpoint());
+    double checkpoint_bytes = std::filesystem::file_size(checkpoint_path);
+    suite.run("checkpoint_save/" + grid_name(size), checkpoint_bytes, "bytes",
+              [&] { save_checkpoint(checkpoint_path, solver.get_checkpoint()); });
+    suite.run("checkpoint_load/" + grid_name(size), checkpoint_bytes, "bytes",
+              [&] { solver.restore(load_checkpoint(checkpoint_path)); });
+
+    // a run records 10 frames, so the chunks of the writer fill up and get written
+    constexpr unsigned int frame_count = 10;
+    double frame_bytes = 4.0 * sizeof(float) * solver.get_vertex_count();
+    const ClothSolver::vertex_buffer &positions = solver.get_positions();
+    suite.run("trajectory_record/" + grid_name(size), frame_count * frame_bytes, "bytes", [&] {
+        TrajectoryWriter writer(trajectory_path, make_trajectory_header(size.row_length,
+                                                                        size.column_length, 0.01f));
+        for (unsigned int i = 0; i < frame_count; i++) {
+            writer.write_frame(positions.x.data(), positions.y.data(), positions.z.data());
+        }
+        writer.close();
+    });
+    // reads every float, the way an upload of every frame would
+    volatile float sink = 0;
+    suite.run("trajectory_replay/" + grid_name(size), frame_count * frame_bytes, "bytes", [&] {
+        TrajectoryReader reader(trajectory_path);
+        float sum = 0;
+        for (unsigned int frame = 0; frame < reader.get_frame_count(); frame++) {
+            const float *data = reader.get_frame(frame);
+            for (unsigned int i = 0; i < reader.get_header().frame_stride / sizeof(float); i++) {
+                sum += data[i];
+            }
+        }
+        sink = sum;
+    });
+
+    std::filesystem::remove(checkpoint_path);
+    std::filesystem::remove(trajectory_path);
+}
+
+// animation export and decoding of frame_count consecutive steps of a swinging cloth, in bytes
+// of the float4 frames a trajectory would store, and how small every predictor makes them;
+// the frames start after the first 2 seconds, once the cloth has left its still start
+void bench_animation_stream(BenchmarkSuite &suite, const grid_size &size,
+                            unsigned int frame_count) {
+    ClothSolver solver(size.row_length, size.column_length);
+    for (unsigned int i = 0; i < 200; i++) {
+        solver.step(0.01f);
+    }
+    unsigned int vertex_count = solver.get_vertex_count();
+    std::vector<float> frames(3 * std::size_t(vertex_count) * frame_count);
+    for (unsigned int frame = 0; frame < frame_count; frame++) {
+        const ClothSolver::vertex_buffer &positions = solver.get_positions();
+        float *data = frames.data() + 3 * std::size_t(vertex_count) * frame;
+        std::copy(positions.x.begin(), positions.x.end(), data);
+        std::copy(positions.y.begin(), positions.y.end(), data + vertex_count);
+        std::copy(positions.z.begin(), positions.z.end(), data + 2 * vertex_count);
+        solver.step(0.01f);
+    }
+    std::string path = std::filesystem::temp_directory_path() / "cloth_bench.anim";
+    auto export_frames = [&](animation_predictor predictor) {
+        AnimationWriter writer(path, make_animation_header(size.row_length, size.column_length,
+                                                           0.01f,
+                                                           solver.get_parameters().spinning_speed,
+                                                           default_animation_precision,
+                                                           default_keyframe_interval, predictor));
+        for (unsigned int frame = 0; frame < frame_count; frame++) {
+            const float *data = frames.data() + 3 * std::size_t(vertex_count) * frame;
+            writer.write_frame(data, data + vertex_count, data + 2 * vertex_count);
+        }
+        writer.close();
+        return static_cast<double>(writer.get_raw_bytes()) / writer.get_encoded_bytes();
+    };
+
+    const char *predictor_names[num_animation_predictors] = {"previous", "linear", "rotating"};
+    for (unsigned int predictor = 0; predictor < num_animation_predictors; predictor++) {
+        std::cout << "animation " << grid_name(size) << " " << predictor_names[predictor] << ": "
+                  << export_frames(static_cast<animation_predictor>(predictor))
+                  << "x smaller than float4 frames\n";
+    }
+
+    double raw_bytes = 4.0 * sizeof(float) * vertex_count * frame_count;
+    suite.run("animation_export/" + grid_name(size), raw_bytes, "bytes",
+              [&] { export_frames(predict_rotating); });
+    std::vector<float> x(vertex_count);
+    std::vector<float> y(vertex_count);
+    std::vector<float> z(vertex_count);
+    suite.run("animation_decode/" + grid_name(size), raw_bytes, "bytes", [&] {
+        AnimationReader reader(path);
+        for (unsigned int frame = 0; frame < reader.get_frame_count(); frame++) {
+            reader.read_frame(frame, x.data(), y.data(), z.data());
+        }
+    });
+    std::filesystem::remove(path);
+}
+
+struct integrator_run {
+    public:
+        integrator_type integrator;
+        float delta_time;
+        unsigned int iteration_count;
+};
+
+// wall time per simulated second and the stretch left after simulated_seconds
+void bench_integrators(unsigned int row_length, unsigned int column_length,
+                       float simulated_seconds) {
+    std::cout << "grid " << row_length << "x" << column_length << " integrators over "
+              << simulated_seconds << " simulated seconds\n";
+
+    const integrator_run runs[] = {
+        {      integrator_explicit, 0.01f,  0},
+        {      integrator_explicit, 0.02f,  0},
+        {      integrator_explicit, 0.05f,  0},
+        {integrator_position_based, 0.01f, 10},
+        {integrator_position_based,  0.1f, 10},
+        {integrator_position_based,  0.1f, 40},
+        {integrator_position_based, 0.25f, 40},
+        {integrator_position_based,  0.5f, 40},
+    };
+    for (const integrator_run &run : runs) {
+        ClothSolver solver(row_length, column_length);
+        solver.set_integrator(run.integrator);
+        if (run.iteration_count > 0) {
+            solver.set_iteration_count(run.iteration_count);
+        }
+        unsigned int step_count = std::lround(simulated_seconds / run.delta_time);
+
+        auto start_time_point = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < step_count; i++) {
+            solver.step(run.delta_time);
+        }
+        auto end_time_point = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>{end_time_point - start_time_point}.count();
+
+        float stretch = solver.get_max_stretch();
+        std::cout << "  "
+                  << (run.integrator == integrator_explicit ? "explicit" : "position based")
+                  << " dt " << run.delta_time;
+        if (run.integrator == integrator_position_based) {
+            std::cout << " x" << run.iteration_count << " iterations";
+        }
+        std::cout << ": " << seconds / simulated_seconds * 1e3 << " ms per simulated second, max "
+                  << "stretch " << stretch << (stretch < 4 ? "" : " (unstable)") << "\n";
+    }
+}
+
+// bytes the spring loop reads per step to know its rest lengths
+void bench_constraint_traffic(const grid_size &size) {
+    ClothSolver solver(size.row_length, size.column_length);
+    const ConstraintTable &constraints = solver.get_constraints();
+    unsigned long long spring_count = constraints.neighbours.size();
+
+    // both ends of every spring, 3 floats each, as vertex_shader.hpp used to reload them
+    unsigned long long recomputed_bytes = spring_count * 2 * 3 * sizeof(float);
+    // offsets, neighbour index and rest length, as the shader and update_vertex read them
+    unsigned long long csr_bytes = constraints.get_csr_bytes();
+    // one float per spring end, as the span kernels read them
+    unsigned long long stencil_bytes = spring_count * sizeof(float);
+
+    std::cout << "grid " << size.row_length << "x" << size.column_length
+              << " rest length bytes per step\n"
+              << "  recomputed from start positions: " << recomputed_bytes << "\n"
+              << "  csr table: " << csr_bytes << " ("
+              << 100.0 * csr_bytes / recomputed_bytes << "%)\n"
+              << "  stencil planes: " << stencil_bytes << " ("
+              << 100.0 * stencil_bytes / recomputed_bytes << "%), "
+              << constraints.get_stencil_bytes() << " bytes resident\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchmarkSettings settings;
+    std::string json_path;
+    if (!parse_benchmark_arguments(argc, argv, settings, json_path)) {
+        std::cerr << "usage: " << argv[0] << " [--json <path>] [--samples <count>]"
+                  << " [--warmup <count>] [--max-seconds <seconds>]" << std::endl;
+        return 1;
+    }
+    BenchmarkSuite suite(settings);
+
+    bench_grid_sweep(suite, {
+                                {  60,   40},
+                                { 250,  250},
+                                {1000, 1000},
+                                {2000, 2000}
+    });
+    bench_kernels(suite, {60, 40});
+    bench_kernels(suite, {2000, 2000});
+    bench_threads(suite, {2000, 2000});
+    bench_state_io(suite, {1000, 1000});
+    bench_animation_stream(suite, {60, 40}, 300);
+    bench_animation_stream(suite, {250, 250}, 50);
+    bench_batch(suite, {60, 40}, {1, 4, 16, 64, 256});
+    bench_collision(suite, {
+                               {  60,   40},
+                               { 250,  250},
+                               {1000, 1000}
+    });
+    bench_normals(suite, {60, 40});
+    bench_normals(suite, {250, 250});
+    bench_co_rotating(suite, {60, 40});
+    bench_co_rotating(suite, {120, 80});
+    bench_hierarchy({{60, 40}, {128, 500}}, 5000);
+    bench_hierarchy({{256, 1000}, {128, 4000}}, 500);
+    bench_distributed(2000, 250, {1, 2, 4}, 50);
+    bench_storage_orders(suite,
+                         {
+                             {1024, 256},
+                             {2048, 256},
+                             {4096, 256}
+    },
+                         {64, 256, 1024});
+    bench_state_formats(suite, {60, 40}, 1000);
+    bench_state_formats(suite, {250, 250}, 1000);
+
+    bench_constraint_traffic({2000, 2000});
+    bench_integrators(60, 40, 10);
+
+    if (!json_path.empty()) {
+        std::ofstream output(json_path);
+        suite.write_json(output);
+        if (!output) {
+            std::cerr << "could not write " << json_path << std::endl;
+            return 1;
+        }
+    }
+}
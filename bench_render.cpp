@@ -0,0 +1,168 @@
+#include "Benchmark.hpp"
+#include "ClothBatch.hpp"
+#include "Painter.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+// every pass is followed by a finish, so a sample covers the gpu work and not just its
+// submission
+void bench_passes(BenchmarkSuite &suite, unsigned int row_length, unsigned int column_length) {
+    Painter pnt(row_length, column_length);
+    pnt.set_visible(false);
+    pnt.init();
+
+    std::string grid = std::to_string(row_length) + "x" + std::to_string(column_length);
+    double vertex_count = pnt.get_vertex_count();
+
+    suite.run("gpu_step/" + grid, vertex_count, "vertices", [&] {
+        pnt.simulate(0.01f);
+        pnt.finish();
+    });
+    suite.run("normals/" + grid, vertex_count, "vertices", [&] {
+        pnt.update_normals();
+        pnt.finish();
+    });
+    suite.run("shadow_pass/" + grid, vertex_count, "vertices", [&] {
+        pnt.draw_shadows(display_type_color);
+        pnt.finish();
+    });
+    suite.run("main_pass/" + grid, vertex_count, "vertices", [&] {
+        pnt.draw_to_screen(display_type_color);
+        pnt.finish();
+    });
+
+    // the four buffers as a checkpoint stores them
+    double state_bytes = vertex_count * 4 * 3 * sizeof(float);
+    Checkpoint checkpoint = pnt.get_checkpoint();
+    suite.run("state_readback/" + grid, state_bytes, "bytes",
+              [&] { checkpoint = pnt.get_checkpoint(); });
+    suite.run("state_upload/" + grid, state_bytes, "bytes", [&] {
+        pnt.restore(checkpoint);
+        pnt.finish();
+    });
+
+    pnt.destroy();
+}
+
+// the simulation and normal passes with the state in every format, see StateFormat.hpp
+void bench_state_formats(BenchmarkSuite &suite, unsigned int row_length,
+                         unsigned int column_length) {
+    for (unsigned int format = 0; format < num_state_formats; format++) {
+        Painter pnt(row_length, column_length);
+        pnt.set_visible(false);
+        pnt.set_state_format(static_cast<state_format>(format));
+        pnt.init();
+
+        std::string name = std::string(state_format_name(static_cast<state_format>(format)))
+                           + "/" + std::to_string(row_length) + "x"
+                           + std::to_string(column_length);
+        double vertex_count = pnt.get_vertex_count();
+        suite.run("gpu_step_" + name, vertex_count, "vertices", [&] {
+            pnt.simulate(0.01f);
+            pnt.finish();
+        });
+        suite.run("normals_" + name, vertex_count, "vertices", [&] {
+            pnt.update_normals();
+            pnt.finish();
+        });
+
+        pnt.destroy();
+    }
+}
+
+// k cloths in the same dispatches and one instanced draw
+void bench_batch(BenchmarkSuite &suite, unsigned int row_length, unsigned int column_length,
+                 const std::vector<unsigned int> &cloth_counts) {
+    for (unsigned int cloth_count : cloth_counts) {
+        Painter pnt(row_length, column_length, vary_parameters(cloth_count));
+        pnt.set_visible(false);
+        pnt.init();
+
+        std::string name = std::to_string(row_length) + "x" + std::to_string(column_length)
+                           + "/K=" + std::to_string(cloth_count);
+        double vertex_count = pnt.get_vertex_count();
+        suite.run("batch_gpu_step/" + name, vertex_count, "vertices", [&] {
+            pnt.simulate(0.01f);
+            pnt.finish();
+        });
+        suite.run("batch_main_pass/" + name, vertex_count, "vertices", [&] {
+            pnt.draw_to_screen(display_type_color);
+            pnt.finish();
+        });
+
+        pnt.destroy();
+    }
+}
+
+// init of a painter with its programs compiled, compiled into an empty shader cache and loaded
+// from the cache, see ShaderCache.hpp; every run also opens a window and fills the buffers, so
+// the time spent building the programs is printed on its own
+void bench_startup(BenchmarkSuite &suite, unsigned int row_length, unsigned int column_length) {
+    std::string grid = std::to_string(row_length) + "x" + std::to_string(column_length);
+    std::filesystem::path directory = std::filesystem::temp_directory_path()
+                                      / ("cloth_shader_cache_" + std::to_string(::getpid()));
+    double build_seconds = 0;
+    unsigned int start_count = 0;
+    auto start = [&](const std::string &cache_directory) {
+        Painter pnt(row_length, column_length);
+        pnt.set_visible(false);
+        pnt.set_shader_cache_directory(cache_directory);
+        pnt.init();
+        pnt.finish();
+        build_seconds += pnt.get_shader_cache().get_build_seconds();
+        start_count++;
+        pnt.destroy();
+    };
+    auto run = [&](const std::string &name, const std::function<void()> &run_start) {
+        build_seconds = 0;
+        start_count = 0;
+        suite.run(name + "/" + grid, 1, "starts", run_start);
+        std::cout << "  of which building the programs: " << build_seconds / start_count * 1e6
+                  << " us on average" << std::endl;
+    };
+
+    run("startup_uncached", [&] { start(""); });
+    run("startup_cold_cache", [&] {
+        std::filesystem::remove_all(directory);
+        start(directory.string());
+    });
+    run("startup_warm_cache", [&] { start(directory.string()); });
+    std::filesystem::remove_all(directory);
+}
+} // namespace
+
+// gpu side of the benchmarks, in a hidden window; under a software renderer like llvmpipe the
+// numbers track cpu cost
+int main(int argc, char **argv) {
+    BenchmarkSettings settings;
+    std::string json_path;
+    if (!parse_benchmark_arguments(argc, argv, settings, json_path)) {
+        std::cerr << "usage: " << argv[0] << " [--json <path>] [--samples <count>]"
+                  << " [--warmup <count>] [--max-seconds <seconds>]" << std::endl;
+        return 1;
+    }
+    BenchmarkSuite suite(settings);
+
+    bench_passes(suite, 60, 40);
+    bench_passes(suite, 250, 250);
+    bench_passes(suite, 1000, 1000);
+    bench_batch(suite, 60, 40, {1, 16, 256});
+    bench_state_formats(suite, 1000, 1000);
+    bench_startup(suite, 60, 40);
+
+    if (!json_path.empty()) {
+        std::ofstream output(json_path);
+        suite.write_json(output);
+        if (!output) {
+            std::cerr << "could not write " << json_path << std::endl;
+            return 1;
+        }
+    }
+}
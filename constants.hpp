@@ -1,16 +1,19 @@
 #pragma once
-#include <glm/glm.hpp>
 
-constexpr glm::vec3 light_dir(0.5,3,0.5);
-
-constexpr unsigned int row_length = 60; // remember to also change str
-#define ROW_LENGTH_STR "60"
-constexpr unsigned int column_length = 40; // remember to also change str
-#define COLUMN_LENGTH_STR "40"
-
-constexpr unsigned int vertex_count = column_length * row_length;
+// grid size used when none is given at startup
+constexpr unsigned int default_row_length = 60;
+constexpr unsigned int default_column_length = 40;
+// the smallest grid the seam and the constraint table handle
+constexpr unsigned int min_row_length = 3;
+constexpr unsigned int min_column_length = 2;
+// the constraint table and the gpu spring buffers count the eight springs of every vertex in 32
+// bits
+constexpr unsigned long long max_vertex_count = 0xffffffffull / 8;
 
 constexpr float upper_radius = 0.4f;
 constexpr float lower_radius = 0.6f;
 
+// height of the ground quad, which the cloth cannot fall through
+constexpr float ground_height = -1.0f;
+
 constexpr unsigned int shadow_map_size = 2000;
@@ -1,7 +1,7 @@
 #pragma once
 
 constexpr static const char fragment_shader_source[] = R"(
-#version 460 core
+#version 430 core
 
 out vec4 color;
 in vec3 vertex_normal_vec;
@@ -1,7 +1,7 @@
 #pragma once
 
 constexpr static const char fragment_ground_shader_source[] = R"(
-#version 460 core
+#version 430 core
 
 layout (binding=0) uniform sampler2DShadow shadow_sampler;
 layout (binding=1) uniform sampler2D shadow_color_sampler;
@@ -0,0 +1,76 @@
+#include "ClothKernels.hpp"
+
+#include <immintrin.h>
+
+// compiled with -mavx2 only; the operation order matches update_span_scalar, so without fma
+// contraction both paths produce identical results
+void update_span_avx2(const StepContext &context, unsigned int y, unsigned int x_begin,
+                      unsigned int x_end) {
+    const int row_length = context.row_length;
+    const int offsets[8] = {-row_length - 1, -row_length, -row_length + 1, -1, 1,
+                            row_length - 1,  row_length,  row_length + 1};
+    const unsigned int neighbour_count = y == context.column_length - 1 ? 5 : 8;
+
+    const __m256 delta_time = _mm256_set1_ps(context.delta_time);
+    const __m256 spring_strength = _mm256_set1_ps(context.spring_strength);
+    const __m256 gravity = _mm256_set1_ps(context.gravity_strength * context.delta_time);
+    const __m256 damping = _mm256_set1_ps(10);
+
+    unsigned int x = x_begin;
+    for (; x + 8 <= x_end; x += 8) {
+        unsigned int vertex_index = y * row_length + x;
+
+        __m256 current_x = _mm256_loadu_ps(context.current_x + vertex_index);
+        __m256 current_y = _mm256_loadu_ps(context.current_y + vertex_index);
+        __m256 current_z = _mm256_loadu_ps(context.current_z + vertex_index);
+
+        __m256 velocity_x = _mm256_loadu_ps(context.velocity_x + vertex_index);
+        __m256 velocity_y =
+            _mm256_sub_ps(_mm256_loadu_ps(context.velocity_y + vertex_index), gravity);
+        __m256 velocity_z = _mm256_loadu_ps(context.velocity_z + vertex_index);
+
+        for (unsigned int i = 0; i < neighbour_count; i++) {
+            unsigned int other_index = vertex_index + offsets[i];
+
+            __m256 wanted_distance = _mm256_loadu_ps(
+                context.stencil_planes[i] + vertex_index + context.stencil_offsets[i]);
+
+            __m256 diff_x =
+                _mm256_sub_ps(current_x, _mm256_loadu_ps(context.current_x + other_index));
+            __m256 diff_y =
+                _mm256_sub_ps(current_y, _mm256_loadu_ps(context.current_y + other_index));
+            __m256 diff_z =
+                _mm256_sub_ps(current_z, _mm256_loadu_ps(context.current_z + other_index));
+            __m256 distance = _mm256_sqrt_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diff_x, diff_x),
+                                            _mm256_mul_ps(diff_y, diff_y)),
+                              _mm256_mul_ps(diff_z, diff_z)));
+
+            __m256 factor = _mm256_div_ps(
+                _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(wanted_distance, distance), delta_time),
+                              spring_strength),
+                distance);
+            velocity_x = _mm256_add_ps(velocity_x, _mm256_mul_ps(diff_x, factor));
+            velocity_y = _mm256_add_ps(velocity_y, _mm256_mul_ps(diff_y, factor));
+            velocity_z = _mm256_add_ps(velocity_z, _mm256_mul_ps(diff_z, factor));
+        }
+
+        velocity_y = _mm256_div_ps(velocity_y, damping);
+
+        _mm256_storeu_ps(context.velocity_x + vertex_index, velocity_x);
+        _mm256_storeu_ps(context.velocity_y + vertex_index, velocity_y);
+        _mm256_storeu_ps(context.velocity_z + vertex_index, velocity_z);
+
+        _mm256_storeu_ps(context.next_x + vertex_index,
+                         _mm256_add_ps(current_x, _mm256_mul_ps(velocity_x, delta_time)));
+        _mm256_storeu_ps(context.next_y + vertex_index,
+                         _mm256_add_ps(current_y, _mm256_mul_ps(velocity_y, delta_time)));
+        _mm256_storeu_ps(context.next_z + vertex_index,
+                         _mm256_add_ps(current_z, _mm256_mul_ps(velocity_z, delta_time)));
+    }
+
+    // fewer than 8 vertices left
+    if (x < x_end) {
+        update_span_scalar(context, y, x, x_end);
+    }
+}
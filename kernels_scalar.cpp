@@ -0,0 +1,52 @@
+#include "ClothKernels.hpp"
+
+#include <cmath>
+
+void update_span_scalar(const StepContext &context, unsigned int y, unsigned int x_begin,
+                        unsigned int x_end) {
+    const int row_length = context.row_length;
+    // neighbour offsets in the order vertex_shader.hpp visits them
+    const int offsets[8] = {-row_length - 1, -row_length, -row_length + 1, -1, 1,
+                            row_length - 1,  row_length,  row_length + 1};
+    const unsigned int neighbour_count = y == context.column_length - 1 ? 5 : 8;
+
+    for (unsigned int x = x_begin; x < x_end; x++) {
+        unsigned int vertex_index = y * row_length + x;
+
+        float velocity_x = context.velocity_x[vertex_index];
+        float velocity_y =
+            context.velocity_y[vertex_index] - context.gravity_strength * context.delta_time;
+        float velocity_z = context.velocity_z[vertex_index];
+
+        for (unsigned int i = 0; i < neighbour_count; i++) {
+            unsigned int other_index = vertex_index + offsets[i];
+
+            float wanted_distance =
+                context.stencil_planes[i][vertex_index + context.stencil_offsets[i]];
+
+            float diff_x = context.current_x[vertex_index] - context.current_x[other_index];
+            float diff_y = context.current_y[vertex_index] - context.current_y[other_index];
+            float diff_z = context.current_z[vertex_index] - context.current_z[other_index];
+            float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z);
+
+            float factor = (wanted_distance - distance) * context.delta_time
+                           * context.spring_strength / distance;
+            velocity_x += diff_x * factor;
+            velocity_y += diff_y * factor;
+            velocity_z += diff_z * factor;
+        }
+
+        velocity_y /= 10;
+
+        context.velocity_x[vertex_index] = velocity_x;
+        context.velocity_y[vertex_index] = velocity_y;
+        context.velocity_z[vertex_index] = velocity_z;
+
+        context.next_x[vertex_index] =
+            context.current_x[vertex_index] + velocity_x * context.delta_time;
+        context.next_y[vertex_index] =
+            context.current_y[vertex_index] + velocity_y * context.delta_time;
+        context.next_z[vertex_index] =
+            context.current_z[vertex_index] + velocity_z * context.delta_time;
+    }
+}
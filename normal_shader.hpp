@@ -0,0 +1,73 @@
+#pragma once
+#include "StateFormat.hpp"
+#include "state_format_shader.hpp"
+
+#include <string>
+
+// computes every vertex normal of every cloth once per step for the drawing passes;
+// ROW_LENGTH, COLUMN_LENGTH and CLOTH_COUNT are defined by normal_shader_source
+constexpr static const char normal_shader_body[] = R"(
+layout (local_size_x = 256) in;
+
+layout (std430, binding=1) readonly buffer vertex_pos_current{
+    STATE_WORD pos [];
+} pos_current;
+layout (std430, binding=7) writeonly buffer vertex_normal {
+    vec4 data [];
+} normals;
+
+void main () {
+    uint vertex_index = gl_GlobalInvocationID.x;
+    if (vertex_index >= ROW_LENGTH * COLUMN_LENGTH * CLOTH_COUNT) {
+        return;
+    }
+
+    // the first vertex of the cloth
+    uint base = vertex_index - vertex_index % (ROW_LENGTH * COLUMN_LENGTH);
+    uint vertex_y = vertex_index % (ROW_LENGTH * COLUMN_LENGTH) / ROW_LENGTH;
+    uint vertex_x = vertex_index % ROW_LENGTH;
+
+    vec3 normal_vec = vec3 (0,0,0);
+    uint adjacent_triangles = 0;
+
+    vec3 my_position = LOAD_STATE(pos_current.pos, vertex_index);
+
+    uint left_x = (vertex_x + ROW_LENGTH - 1) % ROW_LENGTH;
+    uint right_x = (vertex_x + 1) % ROW_LENGTH;
+
+    if (vertex_y > 0) {
+        vec3 vectors_to_adjacents [] = {
+            LOAD_STATE(pos_current.pos, base + vertex_y * ROW_LENGTH + left_x) - my_position,
+            LOAD_STATE(pos_current.pos, base + (vertex_y-1) * ROW_LENGTH + vertex_x) - my_position,
+            LOAD_STATE(pos_current.pos, base + vertex_y * ROW_LENGTH + right_x) - my_position,
+        };
+        for (uint i = 0; i < 2; i++) {
+            normal_vec += normalize (cross (vectors_to_adjacents[i+1], vectors_to_adjacents[i]));
+        }
+        adjacent_triangles += 2;
+    }
+    if (vertex_y < COLUMN_LENGTH-1) {
+        vec3 vectors_to_adjacents [] = {
+            LOAD_STATE(pos_current.pos, base + vertex_y * ROW_LENGTH + left_x) - my_position,
+            LOAD_STATE(pos_current.pos, base + (vertex_y+1) * ROW_LENGTH + vertex_x) - my_position,
+            LOAD_STATE(pos_current.pos, base + vertex_y * ROW_LENGTH + right_x) - my_position,
+        };
+        for (uint i = 0; i < 2; i++) {
+            normal_vec += normalize (cross (vectors_to_adjacents[i], vectors_to_adjacents[i+1]));
+        }
+        adjacent_triangles += 2;
+    }
+
+    normals.data[vertex_index] = vec4 (normal_vec / adjacent_triangles, 0);
+}
+)";
+
+// the defines have to come right after the version directive
+inline std::string normal_shader_source(unsigned int row_length, unsigned int column_length,
+                                        unsigned int cloth_count = 1,
+                                        state_format format = state_format_float4) {
+    return "#version 430 core\n" + state_format_shader_source(format) + "#define ROW_LENGTH "
+           + std::to_string(row_length)
+           + "\n#define COLUMN_LENGTH " + std::to_string(column_length)
+           + "\n#define CLOTH_COUNT " + std::to_string(cloth_count) + "\n" + normal_shader_body;
+}
@@ -1,33 +1,558 @@
+#include "ClothBatch.hpp"
+#include "ClothSolver.hpp"
 #include "Painter.hpp"
+#include "Profiler.hpp"
+#include "SimulationClock.hpp"
+#include "SnapshotRing.hpp"
+#include "Trajectory.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <string>
+#include <string_view>
+#include <thread>
 
 unsigned int current_display_type = display_type_color;
+// toggled with p
+Profiler *frame_profiler = nullptr;
+// presses of the up arrow minus presses of the down arrow not applied yet, each changing the
+// spinning speed of a cpu simulation by a quarter; read by the simulation thread when pipelined
+std::atomic<int> spinning_speed_changes = 0;
 
 void key_callback(GLFWwindow *, int key, int, int action, int) {
     if (key == GLFW_KEY_C && action == GLFW_PRESS) {
         current_display_type++;
         current_display_type %= num_display_types;
     }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS && frame_profiler) {
+        frame_profiler->set_enabled(!frame_profiler->is_enabled());
+    }
+    if (key == GLFW_KEY_UP && action == GLFW_PRESS) {
+        spinning_speed_changes++;
+    }
+    if (key == GLFW_KEY_DOWN && action == GLFW_PRESS) {
+        spinning_speed_changes--;
+    }
+}
+
+// largest distance between a gpu vertex and the matching cpu vertex
+float solver_deviation(Painter &pnt, const ClothSolver &solver) {
+    std::vector<float> gpu_positions;
+    pnt.read_positions(gpu_positions);
+    const ClothSolver::vertex_buffer &cpu_positions = solver.get_positions();
+    float deviation = 0;
+    for (unsigned int i = 0; i < solver.get_vertex_count(); i++) {
+        float diff_x = gpu_positions[4 * i] - cpu_positions.x[i];
+        float diff_y = gpu_positions[4 * i + 1] - cpu_positions.y[i];
+        float diff_z = gpu_positions[4 * i + 2] - cpu_positions.z[i];
+        deviation =
+            std::max(deviation, std::sqrt(diff_x * diff_x + diff_y * diff_y + diff_z * diff_z));
+    }
+    return deviation;
+}
+
+ClothSolver::vertex_buffer to_vertex_buffer(const std::vector<float> &data) {
+    ClothSolver::vertex_buffer buffer;
+    for (std::size_t i = 0; i < data.size(); i += 4) {
+        buffer.x.push_back(data[i]);
+        buffer.y.push_back(data[i + 1]);
+        buffer.z.push_back(data[i + 2]);
+    }
+    return buffer;
 }
 
-int main() {
+// the update is chaotic, so rounding differences grow over many steps; resyncing after every
+// frame keeps the comparison to a single step
+void sync_solver(Painter &pnt, ClothSolver &solver) {
+    std::vector<float> gpu_positions;
+    std::vector<float> gpu_velocities;
+    pnt.read_positions(gpu_positions);
+    pnt.read_velocities(gpu_velocities);
+    solver.set_state(to_vertex_buffer(gpu_positions), to_vertex_buffer(gpu_velocities));
+}
+
+void print_clock_stats(const SimulationClock &clock) {
+    std::cout << "substeps taken: " << clock.get_substeps_taken()
+              << ", last frame: " << clock.get_last_frame_substeps()
+              << ", dropped seconds: " << clock.get_dropped_time() << " in "
+              << clock.get_frames_with_dropped_time() << " frames" << std::endl;
+}
+
+void apply_spinning_speed_changes(ClothSolver &solver) {
+    int changes = spinning_speed_changes.exchange(0);
+    if (changes == 0) {
+        return;
+    }
+    ClothParameters parameters = solver.get_parameters();
+    parameters.spinning_speed *= std::pow(1.25f, changes);
+    solver.set_parameters(parameters);
+    std::cout << "spinning speed: " << parameters.spinning_speed << std::endl;
+}
+
+// steps the solver on a thread of its own, at the pace of its own clock, and hands every new
+// state to the render loop through a ring of persistently mapped snapshots, so neither waits
+// for the other; the render loop draws the newest snapshot and never copies it
+void run_pipelined(Painter &pnt, ClothSolver &solver, Profiler &profiler,
+                   const SimulationClockSettings &clock_settings, unsigned int slot_count,
+                   bool clock_stats) {
+    pnt.init_snapshots(slot_count);
+    SnapshotRing ring(slot_count);
+    std::atomic<bool> stopping = false;
+
+    std::thread simulation_thread([&]() {
+        SimulationClock clock(clock_settings);
+        ClothSolver::vertex_buffer normals;
+        auto prev_time_point = std::chrono::high_resolution_clock::now();
+        while (!stopping.load(std::memory_order_relaxed)) {
+            auto cur_time_point = std::chrono::high_resolution_clock::now();
+            float elapsed_seconds =
+                std::chrono::duration<float>{cur_time_point - prev_time_point}.count();
+            prev_time_point = cur_time_point;
+
+            apply_spinning_speed_changes(solver);
+            unsigned int substeps =
+                clock.advance(elapsed_seconds, [&](float delta_time) { solver.step(delta_time); });
+            // with every slot taken the state is skipped, the next step publishes again
+            int slot = substeps > 0 ? ring.begin_write() : -1;
+            if (slot >= 0) {
+                // drawn turned back by the frame angle, as in the unpipelined loop
+                const ClothSolver::vertex_buffer &positions = solver.get_positions();
+                solver.compute_normals(normals, false);
+                float *slot_positions = pnt.get_snapshot_positions(slot);
+                float *slot_normals = pnt.get_snapshot_normals(slot);
+                for (unsigned int i = 0; i < solver.get_vertex_count(); i++) {
+                    slot_positions[4 * i] = positions.x[i];
+                    slot_positions[4 * i + 1] = positions.y[i];
+                    slot_positions[4 * i + 2] = positions.z[i];
+                    slot_positions[4 * i + 3] = 1;
+                    slot_normals[4 * i] = normals.x[i];
+                    slot_normals[4 * i + 1] = normals.y[i];
+                    slot_normals[4 * i + 2] = normals.z[i];
+                    slot_normals[4 * i + 3] = 0;
+                }
+                ring.end_write(slot, solver.get_frame_angle());
+            }
+
+            // sleeps until the next step is due
+            float remaining_seconds =
+                (1 - clock.get_interpolation()) * clock_settings.fixed_delta_time;
+            std::this_thread::sleep_for(std::chrono::duration<float>(remaining_seconds));
+        }
+        if (clock_stats) {
+            print_clock_stats(clock);
+        }
+    });
+
+    // slots drawn in earlier frames, released as soon as the gpu has finished those draws
+    std::vector<unsigned int> retiring_slots;
+    int drawn_slot = -1;
+    unsigned long long frame_count = 0;
+    unsigned long long repeated_frames = 0;
+    unsigned long long ready_slot_sum = 0;
+    while (!pnt.has_finished()) {
+        profiler.begin_frame();
+        std::erase_if(retiring_slots, [&](unsigned int slot) {
+            if (!pnt.is_snapshot_idle(slot)) {
+                return false;
+            }
+            ring.release(slot);
+            return true;
+        });
+
+        ready_slot_sum += ring.get_ready_count();
+        int newest_slot = ring.take_newest();
+        if (newest_slot >= 0) {
+            if (drawn_slot >= 0) {
+                retiring_slots.push_back(drawn_slot);
+            }
+            drawn_slot = newest_slot;
+        } else {
+            repeated_frames++;
+        }
+
+        if (drawn_slot >= 0) {
+            pnt.set_frame_angle(ring.get_frame_angle(drawn_slot));
+            pnt.render_snapshot(drawn_slot, current_display_type);
+        } else {
+            // the start positions, until the first step
+            pnt.render(current_display_type);
+        }
+        profiler.end_frame();
+        frame_count++;
+
+        glfwPollEvents();
+    }
+
+    stopping = true;
+    simulation_thread.join();
+
+    std::cout << "snapshots: " << ring.get_published_count() << " published, "
+              << ring.get_taken_count() << " drawn, " << ring.get_dropped_count()
+              << " dropped, ring full " << ring.get_full_count() << " times; mean occupancy "
+              << static_cast<double>(ready_slot_sum) / std::max(frame_count, 1ull) << " of "
+              << slot_count << " slots, " << repeated_frames << " of " << frame_count
+              << " frames repeated a snapshot" << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    // steps ClothSolver alongside the shader and prints how far apart they drift
+    bool verify_solver = false;
+    // simulates with ClothSolver on every core and only uploads the positions for drawing
+    bool cpu_simulation = false;
+    // keeps the cloth from passing through itself, only in cpu simulation
+    bool self_collision = false;
+    // simulates in the frame spinning with the top row and stops stepping the rows at rest,
+    // only in cpu simulation
+    bool co_rotating = false;
+    // position based iterations per step in cpu simulation, 0 for the explicit update
+    unsigned int iteration_count = 0;
+    // how the painter stores positions and velocities between the passes, see StateFormat.hpp
+    state_format format = state_format_float4;
+    // simulates on a thread of its own and draws the newest state through a snapshot ring,
+    // only in cpu simulation
+    bool pipelined = false;
+    // snapshots in the ring, at least 3
+    unsigned int ring_slot_count = 3;
+    // prints the simulation clock counters every few seconds
+    bool clock_stats = false;
+    unsigned int row_length = default_row_length;
+    unsigned int column_length = default_column_length;
+    // cloths with varied spinning speeds and radii, simulated and drawn side by side
+    unsigned int cloth_count = 1;
+    SimulationClockSettings clock_settings;
+    // plays back a recorded trajectory instead of simulating
+    std::string replay_path;
+    // starts from a saved state instead of the undisturbed cone
+    std::string load_checkpoint_path;
+    // saves the state on exit
+    std::string save_checkpoint_path;
+    // keeps the linked shader programs, so later starts skip compiling them
+    std::string shader_cache_path;
+    // where the frame profiler writes, as json if the path ends in .json and csv otherwise
+    std::string profile_path = "profile.csv";
+    bool profile = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        // false once the value of a numeric option does not parse
+        bool valid = true;
+        if (argument == "--verify-solver") {
+            verify_solver = true;
+        } else if (argument == "--cpu-simulation") {
+            cpu_simulation = true;
+        } else if (argument == "--self-collision") {
+            self_collision = true;
+        } else if (argument == "--co-rotating") {
+            co_rotating = true;
+        } else if (argument == "--iterations" && i + 1 < argc) {
+            valid = parse_count(argv[++i], iteration_count);
+        } else if (argument == "--state-format" && i + 1 < argc) {
+            if (!parse_state_format(argv[++i], format)) {
+                std::cerr << "unknown state format " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (argument == "--pipelined") {
+            pipelined = true;
+        } else if (argument == "--ring-slots" && i + 1 < argc) {
+            if (!parse_count(argv[++i], ring_slot_count)) {
+                valid = false;
+            } else if (ring_slot_count < 3) {
+                std::cerr << "the ring needs at least 3 slots" << std::endl;
+                return 1;
+            }
+        } else if (argument == "--clock-stats") {
+            clock_stats = true;
+        } else if (argument == "--fixed-dt" && i + 1 < argc) {
+            valid = parse_number(argv[++i], clock_settings.fixed_delta_time)
+                    && clock_settings.fixed_delta_time > 0;
+        } else if (argument == "--max-substeps" && i + 1 < argc) {
+            valid = parse_count(argv[++i], clock_settings.max_substeps)
+                    && clock_settings.max_substeps >= 1;
+        } else if (argument == "--catch-up-budget-ms" && i + 1 < argc) {
+            valid = parse_number(argv[++i], clock_settings.catch_up_budget);
+            clock_settings.catch_up_budget /= 1000;
+        } else if (argument == "--replay" && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (argument == "--load-checkpoint" && i + 1 < argc) {
+            load_checkpoint_path = argv[++i];
+        } else if (argument == "--save-checkpoint" && i + 1 < argc) {
+            save_checkpoint_path = argv[++i];
+        } else if (argument == "--shader-cache" && i + 1 < argc) {
+            shader_cache_path = argv[++i];
+        } else if (argument == "--profile" && i + 1 < argc) {
+            profile = true;
+            profile_path = argv[++i];
+        } else if (argument == "--cloths" && i + 1 < argc) {
+            if (!parse_count(argv[++i], cloth_count)) {
+                valid = false;
+            } else if (cloth_count == 0) {
+                std::cerr << "at least one cloth is needed" << std::endl;
+                return 1;
+            }
+        } else if (argument == "--grid" && i + 1 < argc) {
+            if (!parse_grid_size(argv[++i], row_length, column_length)) {
+                std::cerr << "invalid grid size " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--grid <row length>x<column length>]"
+                      << " [--cloths <count>] [--verify-solver] [--cpu-simulation]"
+                      << " [--self-collision] [--co-rotating] [--iterations <count>]"
+                      << " [--state-format <float4|float3|half|fixed>] [--fixed-dt <seconds>]"
+                      << " [--max-substeps <count>] [--catch-up-budget-ms <milliseconds>]"
+                      << " [--pipelined] [--ring-slots <count>]"
+                      << " [--clock-stats] [--replay <trajectory>]"
+                      << " [--load-checkpoint <path>] [--save-checkpoint <path>]"
+                      << " [--shader-cache <directory>]"
+                      << " [--profile <csv or json path>]" << std::endl;
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "invalid value " << argv[i] << " for " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    // the solver, trajectories and checkpoints all hold a single cloth
+    if (cloth_count > 1
+        && (verify_solver || !replay_path.empty() || !load_checkpoint_path.empty()
+            || !save_checkpoint_path.empty())) {
+        std::cerr << "--cloths cannot be combined with --verify-solver, --replay or checkpoints"
+                  << std::endl;
+        return 1;
+    }
 
-    Painter pnt;
+    if ((self_collision || co_rotating || iteration_count > 0)
+        && (!cpu_simulation || cloth_count > 1)) {
+        std::cerr << "--self-collision, --co-rotating and --iterations need --cpu-simulation with"
+                  << " a single cloth" << std::endl;
+        return 1;
+    }
+
+    // the snapshots hold a single cloth in float4, and only a cpu simulation runs off the
+    // render thread
+    if (pipelined
+        && (!cpu_simulation || cloth_count > 1 || format != state_format_float4
+            || !replay_path.empty())) {
+        std::cerr << "--pipelined needs --cpu-simulation with a single cloth in the float4 state"
+                  << " format, without --replay" << std::endl;
+        return 1;
+    }
+
+    // the cpu simulation replaces the shader step that --verify-solver compares the solver against
+    if (verify_solver && cpu_simulation) {
+        std::cerr << "--verify-solver cannot be combined with --cpu-simulation" << std::endl;
+        return 1;
+    }
+
+    // a replay plays frames of its own grid, which a checkpoint would resize the painter away
+    // from
+    if (!replay_path.empty() && !load_checkpoint_path.empty()) {
+        std::cerr << "--replay cannot be combined with --load-checkpoint" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<TrajectoryReader> replay;
+    if (!replay_path.empty()) {
+        replay = std::make_unique<TrajectoryReader>(replay_path);
+        if (replay->get_frame_count() == 0) {
+            std::cerr << replay_path << " has no frames" << std::endl;
+            return 1;
+        }
+        // the frames are played back at the rate they were recorded
+        row_length = replay->get_header().row_length;
+        column_length = replay->get_header().column_length;
+        if (!is_valid_grid_size(row_length, column_length)) {
+            std::cerr << replay_path << " holds an invalid grid size " << row_length << "x"
+                      << column_length << std::endl;
+            return 1;
+        }
+        clock_settings.fixed_delta_time = replay->get_header().delta_time;
+        if (!(clock_settings.fixed_delta_time > 0)
+            || !std::isfinite(clock_settings.fixed_delta_time)) {
+            std::cerr << replay_path << " holds an invalid dt "
+                      << clock_settings.fixed_delta_time << std::endl;
+            return 1;
+        }
+    }
+    unsigned int replay_frame = 0;
+
+    Checkpoint checkpoint;
+    if (!load_checkpoint_path.empty()) {
+        checkpoint = load_checkpoint(load_checkpoint_path);
+        row_length = checkpoint.row_length;
+        column_length = checkpoint.column_length;
+    }
+
+    Profiler profiler(profile_path);
+    profiler.set_enabled(profile);
+    frame_profiler = &profiler;
+
+    Painter pnt(row_length, column_length, vary_parameters(cloth_count, checkpoint.parameters));
+    pnt.set_profiler(&profiler);
+    pnt.set_state_format(format);
+    pnt.set_shader_cache_directory(shader_cache_path);
     pnt.init();
+    if (!shader_cache_path.empty()) {
+        const ShaderCache &shader_cache = pnt.get_shader_cache();
+        std::cout << "shader programs: " << shader_cache.get_loaded_count() << " loaded from "
+                  << shader_cache_path << ", " << shader_cache.get_compiled_count()
+                  << " compiled, in " << shader_cache.get_build_seconds() * 1000 << " ms"
+                  << std::endl;
+    }
+
+    // only a single cloth is stepped or verified on the cpu by a solver, several by the batch
+    std::unique_ptr<ClothSolver> solver;
+    if (cloth_count == 1) {
+        solver = std::make_unique<ClothSolver>(row_length, column_length, checkpoint.parameters);
+        // rounds the state as the painter does, so --verify-solver compares the same steps
+        solver->set_state_format(format);
+    }
+    if (!load_checkpoint_path.empty()) {
+        pnt.restore(checkpoint);
+        solver->restore(checkpoint);
+    }
+    std::unique_ptr<ClothBatch> batch;
+    if (cpu_simulation && cloth_count > 1) {
+        batch = std::make_unique<ClothBatch>(row_length, column_length, pnt.get_parameters());
+        batch->set_thread_count(0);
+    } else if (cpu_simulation) {
+        solver->set_thread_count(0);
+        solver->set_self_collision(self_collision);
+        if (iteration_count > 0) {
+            solver->set_integrator(integrator_position_based);
+            solver->set_iteration_count(iteration_count);
+        }
+        solver->set_co_rotating(co_rotating);
+    }
+    // a cloth at rest in the co-rotating frame only has to be uploaded until both position
+    // buffers of the painter hold it
+    unsigned int uploads_at_rest = 0;
+    unsigned int frame = 0;
+    float max_deviation = 0;
+
+    SimulationClock clock(clock_settings);
+    float stats_seconds = 0;
+
+    auto step = [&](float delta_time) {
+        if (replay) {
+            replay_frame = (replay_frame + 1) % replay->get_frame_count();
+            return;
+        }
+        if (cpu_simulation) {
+            Profiler::scope scope(&profiler, profile_cpu_step);
+            if (batch) {
+                batch->step(delta_time);
+            } else {
+                solver->step(delta_time);
+            }
+            return;
+        }
+        pnt.simulate(delta_time);
+        if (verify_solver) {
+            {
+                Profiler::scope scope(&profiler, profile_cpu_step);
+                solver->step(delta_time);
+            }
+            max_deviation = std::max(max_deviation, solver_deviation(pnt, *solver));
+            sync_solver(pnt, *solver);
+            if (++frame % 100 == 0) {
+                std::cout << "step " << frame << " max single step deviation: " << max_deviation
+                          << std::endl;
+                max_deviation = 0;
+            }
+        }
+    };
 
     glfwSetKeyCallback(pnt.get_window(), key_callback);
 
+    if (pipelined) {
+        run_pipelined(pnt, *solver, profiler, clock_settings, ring_slot_count, clock_stats);
+    }
+
     auto prev_time_point = std::chrono::high_resolution_clock::now();
-    while (!pnt.has_finished()) {
+    while (!pipelined && !pnt.has_finished()) {
         auto cur_time_point = std::chrono::high_resolution_clock::now();
         float elapsed_seconds =
             std::chrono::duration<float>{cur_time_point - prev_time_point}.count();
         prev_time_point = cur_time_point;
-        pnt.display(elapsed_seconds, current_display_type);
+
+        profiler.begin_frame();
+
+        if (cpu_simulation && !batch) {
+            apply_spinning_speed_changes(*solver);
+        }
+        spinning_speed_changes = 0;
+
+        unsigned int substeps = clock.advance(elapsed_seconds, step);
+        bool at_rest = cpu_simulation && !batch && solver->is_at_rest();
+        if (!at_rest) {
+            uploads_at_rest = 0;
+        }
+
+        if (replay && substeps > 0) {
+            // both frames the render interpolates between, wrapping around at the end
+            if (substeps > 1) {
+                unsigned int frame_count = replay->get_frame_count();
+                pnt.upload_vertex_positions(
+                    replay->get_frame((replay_frame + frame_count - 1) % frame_count));
+            }
+            pnt.upload_vertex_positions(replay->get_frame(replay_frame));
+        } else if (cpu_simulation && substeps > 0 && uploads_at_rest < 2) {
+            // both states the frame interpolates between have to be on the gpu
+            if (substeps > 1) {
+                const ClothSolver::vertex_buffer &previous =
+                    batch ? batch->get_previous_positions() : solver->get_previous_positions();
+                pnt.upload_positions(previous.x.data(), previous.y.data(), previous.z.data());
+            }
+            const ClothSolver::vertex_buffer &positions =
+                batch ? batch->get_positions() : solver->get_positions();
+            pnt.upload_positions(positions.x.data(), positions.y.data(), positions.z.data());
+            if (at_rest) {
+                uploads_at_rest += substeps > 1 ? 2 : 1;
+            }
+        }
+        if (co_rotating) {
+            // the frame turns on even while the cloth rests in it
+            float previous_angle = solver->get_previous_frame_angle();
+            float turn = std::remainder(solver->get_frame_angle() - previous_angle,
+                                        2 * std::numbers::pi_v<float>);
+            pnt.set_frame_angle(previous_angle + turn * clock.get_interpolation());
+        }
+        pnt.render(current_display_type, clock.get_interpolation());
+        profiler.end_frame();
+
+        stats_seconds += elapsed_seconds;
+        if (clock_stats && stats_seconds >= 5) {
+            print_clock_stats(clock);
+            stats_seconds = 0;
+        }
 
         glfwPollEvents();
     }
 
+    if (clock_stats && !pipelined) {
+        print_clock_stats(clock);
+    }
+
+    if (!save_checkpoint_path.empty()) {
+        // in cpu simulation the solver holds the state, the gpu only has its positions
+        save_checkpoint(save_checkpoint_path,
+                        cpu_simulation ? solver->get_checkpoint() : pnt.get_checkpoint());
+    }
+
+    profiler.stop();
+    if (profiler.get_written_samples() > 0) {
+        std::cout << "profile: " << profiler.get_written_samples() << " samples written to "
+                  << profile_path << ", " << profiler.get_dropped_samples() << " dropped, "
+                  << profiler.get_late_frames() << " frames without gpu times" << std::endl;
+    }
+
     pnt.destroy();
 }
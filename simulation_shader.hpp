@@ -0,0 +1,118 @@
+#pragma once
+#include "StateFormat.hpp"
+#include "constants.hpp"
+#include "state_format_shader.hpp"
+
+#include <string>
+
+// one invocation per vertex of every cloth; ROW_LENGTH, COLUMN_LENGTH, CLOTH_COUNT and
+// GROUND_HEIGHT are defined by simulation_shader_source, and the state buffers are accessed as
+// state_format_shader.hpp declares
+constexpr static const char simulation_shader_body[] = R"(
+layout (local_size_x = 256) in;
+
+layout (std430, binding=1) readonly buffer vertex_pos_current{
+    STATE_WORD pos [];
+} pos_current;
+layout (std430, binding=2) writeonly buffer vertex_pos_next {
+    STATE_WORD pos [];
+} pos_next;
+layout (std430, binding=3) buffer vertex_velocity {
+    STATE_WORD data [];
+} velocity;
+
+// springs compiled from the start positions, see ConstraintTable.hpp
+layout (std430, binding=4) readonly buffer constraint_offsets {
+    uint offsets [];
+};
+layout (std430, binding=5) readonly buffer constraint_neighbours {
+    uint neighbours [];
+};
+layout (std430, binding=6) readonly buffer constraint_rest_lengths {
+    float rest_lengths [];
+};
+
+// the springs of cloth c point at its own vertices, [c * n, (c + 1) * n)
+struct cloth_parameters {
+    float spinning_speed;
+    float spring_strength;
+    float gravity_strength;
+    float padding;
+};
+layout (std430, binding=9) readonly buffer cloth_parameter_blocks {
+    cloth_parameters clothes [];
+};
+
+uniform float delta_time = 0.01;
+
+// the next position and velocity of a vertex of one of the cloths
+void step_vertex(uint vertex_index, out vec3 next_position, out vec3 vertex_velocity) {
+    cloth_parameters parameters = clothes[vertex_index / (ROW_LENGTH * COLUMN_LENGTH)];
+    vec3 my_position = LOAD_STATE(pos_current.pos, vertex_index);
+    vertex_velocity = LOAD_STATE(velocity.data, vertex_index);
+
+    if (vertex_index % (ROW_LENGTH * COLUMN_LENGTH) < ROW_LENGTH) {
+        float alpha = delta_time * parameters.spinning_speed;
+        float cs = cos(alpha);
+        float sn = sin(alpha);
+
+        mat3 rotation_matrix = mat3(
+                cs, 0, -sn,
+                0, 1, 0,
+                sn, 0, cs
+                );
+
+        next_position = rotation_matrix * my_position;
+        return;
+    }
+
+    vertex_velocity.y -= parameters.gravity_strength * delta_time;
+
+    for (uint constraint = offsets[vertex_index]; constraint < offsets[vertex_index + 1]; constraint++) {
+        uint other_index = neighbours[constraint];
+
+        float wanted_distance = rest_lengths[constraint];
+
+        vec3 position_diff = my_position - LOAD_STATE(pos_current.pos, other_index);
+
+        float delta_len = wanted_distance - length (position_diff);
+
+        vertex_velocity += normalize(position_diff) * delta_len * delta_time * parameters.spring_strength;
+    }
+
+    vertex_velocity.y /= 10;
+
+    next_position = my_position + vertex_velocity * delta_time;
+    // the cloth lands on the ground instead of falling through it
+    if (next_position.y < GROUND_HEIGHT) {
+        next_position.y = GROUND_HEIGHT;
+        vertex_velocity.y = max(vertex_velocity.y, 0);
+    }
+}
+
+void main () {
+    uint vertex_index = gl_GlobalInvocationID.x;
+    // the invocations past the last vertex still take part in storing the tile of their group
+    bool has_vertex = vertex_index < ROW_LENGTH * COLUMN_LENGTH * CLOTH_COUNT;
+    vec3 next_position = vec3(0);
+    vec3 vertex_velocity = vec3(0);
+    if (has_vertex) {
+        step_vertex(vertex_index, next_position, vertex_velocity);
+    }
+
+    STORE_STATE(velocity.data, vertex_index, vertex_velocity, 0, has_vertex);
+    STORE_STATE(pos_next.pos, vertex_index, next_position, 1, has_vertex);
+}
+)";
+
+// the defines have to come right after the version directive
+inline std::string simulation_shader_source(unsigned int row_length, unsigned int column_length,
+                                            unsigned int cloth_count = 1,
+                                            state_format format = state_format_float4) {
+    return "#version 430 core\n#define STATE_STORE\n" + state_format_shader_source(format)
+           + "#define ROW_LENGTH " + std::to_string(row_length)
+           + "\n#define COLUMN_LENGTH " + std::to_string(column_length)
+           + "\n#define CLOTH_COUNT " + std::to_string(cloth_count)
+           + "\n#define GROUND_HEIGHT " + std::to_string(ground_height) + "\n"
+           + simulation_shader_body;
+}
@@ -0,0 +1,59 @@
+#include "ClothSolver.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// steps the cloth without any window and reports the simulation rate
+int main(int argc, char **argv) {
+    unsigned int step_count = 10000;
+    float delta_time = 0.01f;
+    unsigned int thread_count = 1;
+    unsigned int row_length = default_row_length;
+    unsigned int column_length = default_column_length;
+    // any number of constraint iterations switches to the position based integrator
+    unsigned int iteration_count = 0;
+    unsigned int *const counts[] = {&step_count, nullptr, &thread_count, &row_length,
+                                    &column_length, &iteration_count};
+    bool valid = argc <= 7;
+    for (int i = 1; valid && i < argc; i++) {
+        valid = counts[i - 1] ? parse_count(argv[i], *counts[i - 1])
+                              : parse_number(argv[i], delta_time) && delta_time > 0;
+    }
+    if (!valid || !is_valid_grid_size(row_length, column_length)) {
+        if (valid) {
+            std::cerr << "invalid grid size " << row_length << "x" << column_length << "\n";
+        }
+        std::cerr << "usage: " << argv[0]
+                  << " [steps] [delta_time] [threads] [row_length] [column_length] [iterations]"
+                  << std::endl;
+        return 1;
+    }
+
+    ClothSolver solver(row_length, column_length);
+    solver.set_thread_count(thread_count);
+    if (iteration_count > 0) {
+        solver.set_integrator(integrator_position_based);
+        solver.set_iteration_count(iteration_count);
+    }
+
+    auto start_time_point = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < step_count; i++) {
+        solver.step(delta_time);
+    }
+    auto end_time_point = std::chrono::high_resolution_clock::now();
+    float elapsed_seconds =
+        std::chrono::duration<float>{end_time_point - start_time_point}.count();
+
+    const ClothSolver::vertex_buffer &positions = solver.get_positions();
+    unsigned int bottom_index = solver.get_vertex_count() - solver.get_row_length();
+    std::cout << "grid: " << row_length << "x" << column_length << "\n"
+              << "threads: " << solver.get_thread_count() << "\n"
+              << "integrator: "
+              << (solver.get_integrator() == integrator_explicit ? "explicit" : "position based")
+              << "\n"
+              << "steps: " << step_count << "\n"
+              << "seconds: " << elapsed_seconds << "\n"
+              << "steps/second: " << step_count / elapsed_seconds << "\n"
+              << "bottom vertex: " << positions.x[bottom_index] << " "
+              << positions.y[bottom_index] << " " << positions.z[bottom_index] << "\n";
+}
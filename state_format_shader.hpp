@@ -0,0 +1,130 @@
+#pragma once
+#include "StateFormat.hpp"
+
+#include <string>
+
+// declarations shared by every shader that reads the position or velocity buffers, see
+// StateFormat.hpp; a buffer holds STATE_WORD words, LOAD_STATE(words, i) reads vertex i of it
+// as a vec3, and in a compute shader that defines STATE_STORE before it,
+// STORE_STATE(words, i, value, w, has_vertex) writes one; every invocation of the work group has
+// to reach it, also those past the last vertex
+constexpr static const char state_format_shader_body[] = R"(
+#define STATE_FORMAT_FLOAT4 0
+#define STATE_FORMAT_FLOAT3 1
+#define STATE_FORMAT_HALF 2
+#define STATE_FORMAT_FIXED 3
+
+#if STATE_FORMAT == STATE_FORMAT_FLOAT4
+
+#define STATE_WORD vec4
+#define LOAD_STATE(words, i) (words[i].xyz)
+
+#elif STATE_FORMAT == STATE_FORMAT_FLOAT3
+
+#define STATE_WORD float
+#define LOAD_STATE(words, i) vec3(words[3 * (i)], words[3 * (i) + 1], words[3 * (i) + 2])
+
+#else
+
+#define STATE_WORD uint
+// a tile starts with its centre and scale, followed by the components two to a word
+#define STATE_TILE_BASE(i) ((i) / STATE_TILE_SIZE * STATE_TILE_WORDS)
+#define STATE_CODE_WORD(i) (STATE_TILE_BASE(i) + STATE_TILE_HEADER_WORDS + 3 * ((i) % STATE_TILE_SIZE) / 2)
+#define LOAD_STATE(words, i) decode_state(i, \
+    uvec4(words[STATE_TILE_BASE(i)], words[STATE_TILE_BASE(i) + 1], words[STATE_TILE_BASE(i) + 2], words[STATE_TILE_BASE(i) + 3]), \
+    uvec2(words[STATE_CODE_WORD(i)], words[STATE_CODE_WORD(i) + 1]))
+
+vec3 decode_state(uint vertex_index, uvec4 header, uvec2 code_words) {
+#if STATE_FORMAT == STATE_FORMAT_HALF
+    vec4 offsets = vec4(unpackHalf2x16(code_words.x), unpackHalf2x16(code_words.y));
+#else
+    vec4 offsets = vec4(unpackSnorm2x16(code_words.x), unpackSnorm2x16(code_words.y)) * uintBitsToFloat(header.w);
+#endif
+    // the components of an even vertex start at the low half of the first word
+    return uintBitsToFloat(header.xyz) + ((vertex_index & 1u) == 0u ? offsets.xyz : offsets.yzw);
+}
+
+#endif
+
+#ifdef STATE_STORE
+
+#if STATE_FORMAT == STATE_FORMAT_FLOAT4
+
+#define STORE_STATE(words, i, value, w, has_vertex) if (has_vertex) { words[i] = vec4(value, w); }
+
+#elif STATE_FORMAT == STATE_FORMAT_FLOAT3
+
+#define STORE_STATE(words, i, value, w, has_vertex) if (has_vertex) { \
+    words[3 * (i)] = value.x; words[3 * (i) + 1] = value.y; words[3 * (i) + 2] = value.z; }
+
+#else
+
+shared vec3 tile_low[STATE_TILE_SIZE];
+shared vec3 tile_high[STATE_TILE_SIZE];
+shared uint tile_codes[3 * STATE_TILE_SIZE];
+shared uvec4 tile_header;
+
+// the bounding box of the tile is reduced in shared memory, so the tile of the work group can be
+// written without a second pass
+void encode_tile(vec3 value, bool has_vertex) {
+    uint local_index = gl_LocalInvocationID.x;
+    // vertices past the last one must not widen the box
+    tile_low[local_index] = has_vertex ? value : vec3(3.0e38);
+    tile_high[local_index] = has_vertex ? value : vec3(-3.0e38);
+    barrier();
+    for (uint stride = STATE_TILE_SIZE / 2; stride > 0; stride /= 2) {
+        if (local_index < stride) {
+            tile_low[local_index] = min(tile_low[local_index], tile_low[local_index + stride]);
+            tile_high[local_index] = max(tile_high[local_index], tile_high[local_index + stride]);
+        }
+        barrier();
+    }
+
+    vec3 origin = (tile_low[0] + tile_high[0]) * 0.5;
+    vec3 half_extent = (tile_high[0] - tile_low[0]) * 0.5;
+    float scale = max(half_extent.x, max(half_extent.y, half_extent.z));
+    vec3 offset = value - origin;
+#if STATE_FORMAT == STATE_FORMAT_HALF
+    uvec3 codes = uvec3(packHalf2x16(vec2(offset.x, 0)), packHalf2x16(vec2(offset.y, 0)), packHalf2x16(vec2(offset.z, 0)));
+#else
+    vec3 normalized = scale > 0 ? offset / scale : vec3(0);
+    uvec3 codes = uvec3(packSnorm2x16(vec2(normalized.x, 0)), packSnorm2x16(vec2(normalized.y, 0)), packSnorm2x16(vec2(normalized.z, 0)));
+#endif
+    for (uint k = 0; k < 3; k++) {
+        tile_codes[3 * local_index + k] = has_vertex ? codes[k] & 0xffff : 0;
+    }
+    if (local_index == 0) {
+        tile_header = uvec4(floatBitsToUint(origin), floatBitsToUint(scale));
+    }
+    barrier();
+}
+
+uint get_tile_word(uint word) {
+    if (word < STATE_TILE_HEADER_WORDS) {
+        return tile_header[word];
+    }
+    uint code_index = 2 * (word - STATE_TILE_HEADER_WORDS);
+    return tile_codes[code_index] | (tile_codes[code_index + 1] << 16);
+}
+
+// each invocation writes at most two words of the tile of its work group; the barrier at the
+// end lets the next store reuse the shared memory
+#define STORE_STATE(words, i, value, w, has_vertex) encode_tile(value, has_vertex); \
+    for (uint word = gl_LocalInvocationID.x; word < STATE_TILE_WORDS; word += STATE_TILE_SIZE) { \
+        words[gl_WorkGroupID.x * STATE_TILE_WORDS + word] = get_tile_word(word); \
+    } \
+    barrier();
+
+#endif
+
+#endif
+)";
+
+// the defines the body above needs, followed by the body; has to come after the version
+// directive and before the buffer declarations
+inline std::string state_format_shader_source(state_format format) {
+    return "#define STATE_FORMAT " + std::to_string(format) + "\n#define STATE_TILE_SIZE "
+           + std::to_string(state_tile_size) + "\n#define STATE_TILE_HEADER_WORDS "
+           + std::to_string(state_tile_header_words) + "\n#define STATE_TILE_WORDS "
+           + std::to_string(state_tile_words) + "\n" + state_format_shader_body;
+}
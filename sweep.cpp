@@ -0,0 +1,320 @@
+#include "ClothSolver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+enum parameter_indices {
+    spinning_speed,
+    spring_strength,
+    gravity_strength,
+    upper_radius,
+    lower_radius,
+    num
+};
+
+// names as given on the command line and in set files, in the order of parameter_indices
+const char *const parameter_names[] = {"spinning-speed", "spring-strength", "gravity-strength",
+                                       "upper-radius", "lower-radius"};
+
+float &parameter(ClothParameters &parameters, unsigned int index) {
+    switch (index) {
+        case spinning_speed:
+            return parameters.spinning_speed;
+        case spring_strength:
+            return parameters.spring_strength;
+        case gravity_strength:
+            return parameters.gravity_strength;
+        case upper_radius:
+            return parameters.upper_radius;
+        default:
+            return parameters.lower_radius;
+    }
+}
+
+int parameter_index(std::string_view name) {
+    for (unsigned int index = 0; index < parameter_indices::num; index++) {
+        if (name == parameter_names[index]) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+// the whole text as one number; unlike std::stof alone, trailing characters are an error
+float parse_value(const std::string &text) {
+    float value = 0;
+    if (!parse_number(text.c_str(), value)) {
+        throw std::runtime_error("invalid value " + text);
+    }
+    return value;
+}
+
+// either a list, 0.25,0.5,1, or count evenly spaced values from first to last, 0.25:1:4
+std::vector<float> parse_values(const std::string &text) {
+    std::vector<float> values;
+    std::stringstream stream(text);
+    std::string value;
+    if (text.find(':') != std::string::npos) {
+        std::vector<std::string> fields;
+        while (std::getline(stream, value, ':')) {
+            fields.push_back(value);
+        }
+        // a trailing separator leaves no empty field behind, so it is checked on the text
+        unsigned int count = 0;
+        if (fields.size() != 3 || text.back() == ':' || !parse_count(fields[2].c_str(), count)
+            || count == 0) {
+            throw std::runtime_error("invalid range " + text + ", expected first:last:count");
+        }
+        float first = parse_value(fields[0]);
+        float last = parse_value(fields[1]);
+        for (unsigned int i = 0; i < count; i++) {
+            values.push_back(count > 1 ? first + (last - first) * i / (count - 1) : first);
+        }
+    } else {
+        while (std::getline(stream, value, ',')) {
+            values.push_back(parse_value(value));
+        }
+        if (!text.empty() && text.back() == ',') {
+            throw std::runtime_error("invalid value list " + text);
+        }
+    }
+    if (values.empty()) {
+        throw std::runtime_error("no values in " + text);
+    }
+    return values;
+}
+
+// every combination of the values, with the last parameter varying fastest
+std::vector<ClothParameters> parameter_grid(const std::vector<float> (&values)[num]) {
+    std::vector<ClothParameters> sets = {ClothParameters{}};
+    for (unsigned int index = 0; index < parameter_indices::num; index++) {
+        if (values[index].empty()) {
+            continue;
+        }
+        std::vector<ClothParameters> expanded;
+        for (const ClothParameters &set : sets) {
+            for (float value : values[index]) {
+                expanded.push_back(set);
+                parameter(expanded.back(), index) = value;
+            }
+        }
+        sets = expanded;
+    }
+    return sets;
+}
+
+// one set per line as name=value pairs, e.g. spinning-speed=0.5 lower-radius=0.3; parameters
+// that are left out keep their defaults, and lines starting with # are skipped
+std::vector<ClothParameters> load_parameter_sets(const std::string &path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error("could not open " + path);
+    }
+    std::vector<ClothParameters> sets;
+    std::string line;
+    while (std::getline(input, line)) {
+        std::stringstream stream(line);
+        std::string pair;
+        if (!(stream >> pair) || pair[0] == '#') {
+            continue;
+        }
+        ClothParameters set;
+        do {
+            std::size_t separator = pair.find('=');
+            int index = parameter_index(std::string_view(pair).substr(0, separator));
+            if (separator == std::string::npos || index < 0) {
+                throw std::runtime_error("invalid parameter " + pair + " in " + path);
+            }
+            parameter(set, index) = parse_value(pair.substr(separator + 1));
+        } while (stream >> pair);
+        sets.push_back(set);
+    }
+    return sets;
+}
+
+struct sweep_settings {
+    public:
+        unsigned int row_length = default_row_length;
+        unsigned int column_length = default_column_length;
+        float delta_time = 0.01f;
+        float simulated_seconds = 10;
+        // any number of constraint iterations switches to the position based integrator
+        unsigned int iteration_count = 0;
+        // a spring stretched beyond this many times its rest length counts as blown up; the
+        // default cloth already reaches about 2 while the top row twists it
+        float stretch_limit = 10;
+        // steps between two checks of the stretch
+        unsigned int check_interval = 10;
+};
+
+struct run_result {
+    public:
+        bool stable;
+        // simulated time reached, which falls short of the full run once it blows up
+        double simulated_seconds;
+        float flare_radius;
+        float max_stretch;
+        double wall_seconds;
+};
+
+run_result run(const sweep_settings &settings, const ClothParameters &parameters) {
+    auto start_time_point = std::chrono::steady_clock::now();
+    ClothSolver solver(settings.row_length, settings.column_length, parameters);
+    if (settings.iteration_count > 0) {
+        solver.set_integrator(integrator_position_based);
+        solver.set_iteration_count(settings.iteration_count);
+    }
+
+    unsigned int step_count = std::lround(settings.simulated_seconds / settings.delta_time);
+    run_result result = {true, 0, 0, 0, 0};
+    for (unsigned int step = 1; step <= step_count; step++) {
+        solver.step(settings.delta_time);
+        if (step % settings.check_interval != 0 && step != step_count) {
+            continue;
+        }
+        result.max_stretch = std::max(result.max_stretch, solver.get_max_stretch());
+        // a run that blew up is stopped, so the others get the cores
+        if (!(result.max_stretch <= settings.stretch_limit)) {
+            result.stable = false;
+            break;
+        }
+    }
+    result.simulated_seconds = solver.get_simulated_time();
+    result.flare_radius = solver.get_flare_radius();
+    result.wall_seconds =
+        std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+            .count();
+    return result;
+}
+} // namespace
+
+// simulates every parameter set headlessly for a fixed simulated time, one set per worker
+// thread, and writes a line of summary metrics per run as soon as it finishes
+int main(int argc, char **argv) {
+    sweep_settings settings;
+    unsigned int thread_count = 0;
+    std::vector<float> values[parameter_indices::num];
+    std::string sets_path;
+    // the results go to stdout when no file is given
+    std::string output_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        // false once the value of a numeric option does not parse
+        bool valid = true;
+        int index = argument.starts_with("--") ? parameter_index(argument.substr(2)) : -1;
+        if (index >= 0 && i + 1 < argc) {
+            try {
+                values[index] = parse_values(argv[++i]);
+            } catch (const std::runtime_error &error) {
+                std::cerr << error.what() << std::endl;
+                return 1;
+            }
+        } else if (argument == "--sets" && i + 1 < argc) {
+            sets_path = argv[++i];
+        } else if (argument == "--grid" && i + 1 < argc) {
+            if (!parse_grid_size(argv[++i], settings.row_length, settings.column_length)) {
+                std::cerr << "invalid grid size " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (argument == "--dt" && i + 1 < argc) {
+            valid = parse_number(argv[++i], settings.delta_time) && settings.delta_time > 0;
+        } else if (argument == "--seconds" && i + 1 < argc) {
+            valid = parse_number(argv[++i], settings.simulated_seconds);
+        } else if (argument == "--iterations" && i + 1 < argc) {
+            valid = parse_count(argv[++i], settings.iteration_count);
+        } else if (argument == "--stretch-limit" && i + 1 < argc) {
+            valid = parse_number(argv[++i], settings.stretch_limit);
+        } else if (argument == "--check-interval" && i + 1 < argc) {
+            valid = parse_count(argv[++i], settings.check_interval);
+            settings.check_interval = std::max(1u, settings.check_interval);
+        } else if (argument == "--threads" && i + 1 < argc) {
+            valid = parse_count(argv[++i], thread_count);
+        } else if (argument == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--spinning-speed <values>]"
+                      << " [--spring-strength <values>] [--gravity-strength <values>]"
+                      << " [--upper-radius <values>] [--lower-radius <values>]"
+                      << " [--sets <path>] [--grid <row length>x<column length>]"
+                      << " [--dt <seconds>] [--seconds <simulated seconds>]"
+                      << " [--iterations <count>] [--stretch-limit <ratio>]"
+                      << " [--check-interval <steps>] [--threads <count>] [--output <path>]\n"
+                      << "values are a list, e.g. 0.25,0.5,1, or first:last:count" << std::endl;
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "invalid value " << argv[i] << " for " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<ClothParameters> sets;
+    try {
+        sets = sets_path.empty() ? parameter_grid(values) : load_parameter_sets(sets_path);
+    } catch (const std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min<unsigned int>(thread_count, std::max<std::size_t>(1, sets.size()));
+
+    std::ofstream file;
+    if (!output_path.empty()) {
+        file.open(output_path);
+        if (!file) {
+            std::cerr << "could not write " << output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &output = output_path.empty() ? std::cout : file;
+    output << "run,spinning_speed,spring_strength,gravity_strength,upper_radius,lower_radius,"
+              "stable,simulated_seconds,flare_radius,max_stretch,wall_seconds\n";
+
+    std::cerr << sets.size() << " runs of " << settings.simulated_seconds
+              << " simulated seconds on " << thread_count << " threads" << std::endl;
+
+    // every run is single threaded, so runs of different length balance through stealing
+    std::mutex output_mutex;
+    unsigned int finished_count = 0;
+    unsigned int stable_count = 0;
+    auto start_time_point = std::chrono::steady_clock::now();
+    ThreadPool pool(thread_count);
+    pool.run(sets.size(), [&](unsigned int index) {
+        const ClothParameters &parameters = sets[index];
+        run_result result = run(settings, parameters);
+
+        std::lock_guard lock(output_mutex);
+        // flushed per line, so an interrupted sweep keeps the runs it finished
+        output << index << "," << parameters.spinning_speed << "," << parameters.spring_strength
+               << "," << parameters.gravity_strength << "," << parameters.upper_radius << ","
+               << parameters.lower_radius << "," << result.stable << ","
+               << result.simulated_seconds << "," << result.flare_radius << ","
+               << result.max_stretch << "," << result.wall_seconds << std::endl;
+        finished_count++;
+        stable_count += result.stable;
+    });
+    double wall_seconds =
+        std::chrono::duration<double>{std::chrono::steady_clock::now() - start_time_point}
+            .count();
+
+    std::cerr << finished_count << " runs, " << stable_count << " stable, in " << wall_seconds
+              << " s, " << finished_count / wall_seconds * 3600 << " runs per hour" << std::endl;
+    if (!output) {
+        std::cerr << "could not write the results" << std::endl;
+        return 1;
+    }
+}
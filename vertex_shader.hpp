@@ -1,139 +1,68 @@
 #pragma once
-#include "constants.hpp"
+#include "StateFormat.hpp"
+#include "state_format_shader.hpp"
 
-constexpr static const char vertex_shader_source[] = R"(
-#version 460 core
-#define ROW_LENGTH )" ROW_LENGTH_STR R"(
-#define COLUMN_LENGTH )" COLUMN_LENGTH_STR R"(
+#include <string>
 
-layout (std430, binding=0) buffer vertex_pos_start {
-    vec4 pos [ROW_LENGTH * COLUMN_LENGTH];
-} pos_start;
-layout (std430, binding=1) buffer vertex_pos_current{
-    vec4 pos [ROW_LENGTH * COLUMN_LENGTH];
+// ROW_LENGTH, COLUMN_LENGTH and CLOTH_COUNT are defined by vertex_shader_source; every instance
+// draws one cloth, and gl_VertexID is a render vertex from the element buffer, see ClothMesh.hpp
+constexpr static const char vertex_shader_body[] = R"(
+// positions and normals are written by the simulation and normal passes
+layout (std430, binding=1) readonly buffer vertex_pos_current{
+    STATE_WORD pos [];
 } pos_current;
-layout (std430, binding=2) buffer vertex_pos_next {
-    vec4 pos [ROW_LENGTH * COLUMN_LENGTH];
-} pos_next;
-layout (std430, binding=3) buffer vertex_velocity {
-    vec4 data [ROW_LENGTH * COLUMN_LENGTH];
-} velocity;
-
-uniform float delta_time = 0.01;
-uniform float spinning_speed = 0.5;
-uniform float spring_strength = 300;
-uniform float gravity_strength = 0.01;
-uniform float scaling = 0.01;
+layout (std430, binding=7) readonly buffer vertex_normal {
+    vec4 data [];
+} normals;
+// the state one step before the current one
+layout (std430, binding=8) readonly buffer vertex_pos_previous{
+    STATE_WORD pos [];
+} pos_previous;
+
+// how far the rendered frame lies between the previous and the current state
+uniform float interpolation = 1;
+// turns positions simulated in the co-rotating frame into the lab
+uniform mat3 frame_rotation = mat3(1);
 
 layout (std140, binding=0) uniform display_options {
     mat4 view_transform;
-    bool is_updating;
 };
 
 out vec3 vertex_normal_vec;
-out vec3 triangle_normal_vec;
 out vec2 tex_coord;
 
-void main () {
-    uint square_index = gl_VertexID / 6;
-
-    uint square_y = square_index / ROW_LENGTH;
-    uint square_x = square_index % ROW_LENGTH;
-
-    uint x_offsets [6] = {0,0,1,1,0,1}; // offsets within the square of vertices
-    uint y_offsets [6] = {0,1,0,0,1,1};
-
-    uint vertex_x = (square_x + x_offsets[gl_VertexID % 6]) % ROW_LENGTH;
-    uint vertex_y = square_y + y_offsets[gl_VertexID % 6];
-
-    tex_coord = vec2(float(square_x + x_offsets[gl_VertexID % 6]) / ROW_LENGTH,
-            float(vertex_y)/COLUMN_LENGTH);
-
-    uint vertex_index = vertex_y * ROW_LENGTH + vertex_x;
-
-    vec3 normal_vec = vec3 (0,0,0);
-    uint adjacent_triangles = 0;
-
-    vec3 my_position = pos_current.pos[vertex_index].xyz;
-
-    uint left_x = (vertex_x + ROW_LENGTH - 1) % ROW_LENGTH;
-    uint right_x = (vertex_x + 1) % ROW_LENGTH;
+// the cloths stand on a square grid scaled to the space a single cloth takes
+const uint CLOTH_COLUMNS = uint(ceil(sqrt(float(CLOTH_COUNT))));
 
-    if (vertex_y > 0) {
-        vec3 vectors_to_adjacents [] = {
-            pos_current.pos[vertex_y * ROW_LENGTH + left_x].xyz - my_position,
-            pos_current.pos[(vertex_y-1) * ROW_LENGTH + vertex_x].xyz - my_position,
-            pos_current.pos[vertex_y * ROW_LENGTH + right_x].xyz - my_position,
-        };
-        for (uint i = 0; i < 2; i++) {
-            normal_vec += normalize (cross (vectors_to_adjacents[i+1], vectors_to_adjacents[i]));
-        }
-        adjacent_triangles += 2;
-    }
-    if (vertex_y < COLUMN_LENGTH-1) {
-        vec3 vectors_to_adjacents [] = {
-            pos_current.pos[vertex_y * ROW_LENGTH + left_x].xyz - my_position,
-            pos_current.pos[(vertex_y+1) * ROW_LENGTH + vertex_x].xyz - my_position,
-            pos_current.pos[vertex_y * ROW_LENGTH + right_x].xyz - my_position,
-        };
-        for (uint i = 0; i < 2; i++) {
-            normal_vec += normalize (cross (vectors_to_adjacents[i], vectors_to_adjacents[i+1]));
-        }
-        adjacent_triangles += 2;
-    }
-
-    vertex_normal_vec = normal_vec / adjacent_triangles;
-
-    gl_Position = view_transform * vec4(pos_current.pos[vertex_index].xyz, 1);
-
-    if (!is_updating) {
-        return;
-    }
-
-    if (square_x == vertex_x && (square_y == vertex_y || vertex_y == COLUMN_LENGTH-1)) { // only one vertex processes a place
-        if (vertex_y == 0) {
-            float alpha = delta_time * spinning_speed;
-            float cs = cos(alpha);
-            float sn = sin(alpha);
-
-            mat4 rotation_matrix = mat4(
-                    cs, 0, -sn, 0,
-                    0, 1, 0, 0,
-                    sn, 0, cs, 0,
-                    0, 0, 0, 1
-                    );
-
-            pos_next.pos[vertex_index] = rotation_matrix * pos_current.pos[vertex_index];
-        } else {
-            velocity.data[vertex_index].y -= gravity_strength * delta_time;
-
-            for (int delta_y = -1; delta_y <= 1; delta_y++) {
-                if (vertex_y == COLUMN_LENGTH-1 && delta_y == 1) {
-                    break;
-                }
-                for (int delta_x = -1; delta_x <= 1; delta_x++) {
-                    if (delta_x == 0 && delta_y == 0) {
-                        continue;
-                    }
-                    uint other_x = (vertex_x + ROW_LENGTH + delta_x) % ROW_LENGTH;
-                    uint other_y = vertex_y + delta_y;
-                    uint other_index = other_y * ROW_LENGTH + other_x;
+void main () {
+    // the last render vertex of a row repeats the first grid vertex
+    uint render_x = gl_VertexID % (ROW_LENGTH + 1);
+    uint vertex_y = gl_VertexID / (ROW_LENGTH + 1);
+    uint vertex_x = render_x % ROW_LENGTH;
 
-                    float wanted_distance = length (pos_start.pos[vertex_index] - pos_start.pos[other_index]);
+    tex_coord = vec2(float(render_x) / ROW_LENGTH, float(vertex_y) / COLUMN_LENGTH);
 
-                    vec3 position_diff = pos_current.pos[vertex_index].xyz - pos_current.pos[other_index].xyz;
+    uint vertex_index = gl_InstanceID * ROW_LENGTH * COLUMN_LENGTH
+        + vertex_y * ROW_LENGTH + vertex_x;
 
-                    float delta_len = wanted_distance - length (position_diff);
-                    
-                    velocity.data[vertex_index] += vec4 (normalize(position_diff) * delta_len * delta_time * spring_strength, 0);
-                }
-            }
+    vertex_normal_vec = frame_rotation * normals.data[vertex_index].xyz;
 
-            velocity.data[vertex_index].y /= 10;
+    vec3 position = frame_rotation * mix(LOAD_STATE(pos_previous.pos, vertex_index), LOAD_STATE(pos_current.pos, vertex_index), interpolation);
 
+    vec2 cell = vec2(gl_InstanceID % CLOTH_COLUMNS, gl_InstanceID / CLOTH_COLUMNS);
+    vec2 cell_center = (cell + 0.5) * 2 / CLOTH_COLUMNS - 1;
+    position = position / CLOTH_COLUMNS + vec3(cell_center.x, 0, cell_center.y);
 
-            pos_next.pos[vertex_index] = pos_current.pos[vertex_index] + velocity.data[vertex_index] * delta_time;
-        }
-    }
+    gl_Position = view_transform * vec4(position, 1);
 }
 )";
+
+// the defines have to come right after the version directive
+inline std::string vertex_shader_source(unsigned int row_length, unsigned int column_length,
+                                        unsigned int cloth_count = 1,
+                                        state_format format = state_format_float4) {
+    return "#version 430 core\n" + state_format_shader_source(format) + "#define ROW_LENGTH "
+           + std::to_string(row_length)
+           + "\n#define COLUMN_LENGTH " + std::to_string(column_length)
+           + "\n#define CLOTH_COUNT " + std::to_string(cloth_count) + "\n" + vertex_shader_body;
+}
@@ -1,7 +1,7 @@
 #pragma once
 
 constexpr static const char vertex_ground_shader_source[] = R"(
-#version 460 core
+#version 430 core
 
 layout (location=0) in vec3 position;
 